@@ -0,0 +1,143 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "i3w-blink.h"
+#include "i3w-stats.h"
+
+typedef struct
+{
+    i3wBlinkCallback callback;
+    gpointer data;
+    gulong destroy_handler;
+} i3wBlinker;
+
+// GtkWidget * => i3wBlinker *, shared by every plugin instance of the process
+static GHashTable *blinkers = NULL;
+static guint blink_source = 0;
+static gboolean lit = TRUE;
+
+static gboolean
+on_blink(gpointer data);
+static void
+on_widget_destroyed(GtkWidget *widget, gpointer data);
+
+/* Function Implementations */
+
+/**
+ * i3_workspaces_blink_start:
+ * @widget: the widget
+ * @callback: called with the widget whenever the phase changes
+ * @data: the data to be passed to the callback function
+ *
+ * Let the widget blink, in phase with the others, until it is stopped or
+ * destroyed. Starting a blinking widget again changes nothing.
+ */
+void
+i3_workspaces_blink_start(GtkWidget *widget, i3wBlinkCallback callback, gpointer data)
+{
+    if (blinkers == NULL)
+        blinkers = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+    if (g_hash_table_contains(blinkers, widget))
+        return;
+
+    i3wBlinker *blinker = g_new(i3wBlinker, 1);
+    blinker->callback = callback;
+    blinker->data = data;
+    blinker->destroy_handler = g_signal_connect(G_OBJECT(widget), "destroy",
+            G_CALLBACK(on_widget_destroyed), NULL);
+    g_hash_table_insert(blinkers, widget, blinker);
+
+    if (blink_source == 0)
+    {
+        lit = TRUE;
+        blink_source = g_timeout_add_seconds(I3W_BLINK_INTERVAL, on_blink, NULL);
+    }
+}
+
+/**
+ * i3_workspaces_blink_stop:
+ * @widget: the widget
+ *
+ * Stop the widget blinking. The timer is stopped with the last widget.
+ */
+void
+i3_workspaces_blink_stop(GtkWidget *widget)
+{
+    i3wBlinker *blinker = blinkers ? g_hash_table_lookup(blinkers, widget) : NULL;
+    if (blinker == NULL)
+        return;
+
+    g_signal_handler_disconnect(G_OBJECT(widget), blinker->destroy_handler);
+    g_hash_table_remove(blinkers, widget);
+
+    if (g_hash_table_size(blinkers) == 0 && blink_source)
+    {
+        g_source_remove(blink_source);
+        blink_source = 0;
+    }
+}
+
+/**
+ * i3_workspaces_blink_is_lit:
+ *
+ * Returns: whether the blinking widgets are in the lit phase
+ */
+gboolean
+i3_workspaces_blink_is_lit(void)
+{
+    return lit;
+}
+
+/**
+ * on_blink:
+ * @data: unused
+ *
+ * Switch the phase and call back every blinking widget.
+ *
+ * Returns: TRUE to keep the timer
+ */
+static gboolean
+on_blink(gpointer data)
+{
+    lit = !lit;
+    i3w_stats.blink_ticks++;
+
+    // a callback may start or stop blinking
+    GList *widgets = g_hash_table_get_keys(blinkers);
+    GList *item;
+    for (item = widgets; item != NULL; item = item->next)
+    {
+        i3wBlinker *blinker = g_hash_table_lookup(blinkers, item->data);
+        if (blinker)
+            blinker->callback(GTK_WIDGET(item->data), blinker->data);
+    }
+    g_list_free(widgets);
+
+    return blink_source != 0;
+}
+
+static void
+on_widget_destroyed(GtkWidget *widget, gpointer data)
+{
+    i3_workspaces_blink_stop(widget);
+}
@@ -0,0 +1,43 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_BLINK_H__
+#define __I3W_BLINK_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * Blinking widgets, e.g. the buttons of urgent workspaces. A single timer,
+ * shared by all plugin instances of the process, switches the phase and
+ * calls back the blinking widgets only; it runs only while some widget
+ * blinks.
+ */
+
+/* seconds between two phases, whole seconds let GLib batch the wakeups */
+#define I3W_BLINK_INTERVAL 1
+
+typedef void (*i3wBlinkCallback) (GtkWidget *widget, gpointer data);
+
+void
+i3_workspaces_blink_start(GtkWidget *widget, i3wBlinkCallback callback, gpointer data);
+void
+i3_workspaces_blink_stop(GtkWidget *widget);
+gboolean
+i3_workspaces_blink_is_lit(void);
+
+#endif /* !__I3W_BLINK_H__ */
@@ -17,8 +17,11 @@
  *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <unistd.h>
 #include <gtk/gtk.h>
+#include <gio/gio.h>
 #include <glib/gprintf.h>
+#include <glib/gstdio.h>
 #include <libxfce4util/libxfce4util.h>
 #include <libxfce4ui/libxfce4ui.h>
 
@@ -27,13 +30,21 @@
 #endif
 
 #include "i3w-config.h"
+#include "i3w-stats.h"
+
+/* time to wait for further changes before the configuration is written */
+#define SAVE_DELAY_MS 500
+
+/* one write at a time, so a later one is never overwritten by an earlier one */
+G_LOCK_DEFINE_STATIC(write_config);
 
 typedef struct {
     i3WorkspacesConfig *config;
     XfcePanelPlugin *plugin;
     ConfigChangedCallback cb;
     gpointer cb_data;
-} ConfigDialogClosedParam;
+    guint save_source;
+} ConfigDialogParam;
 
 void
 normal_color_changed(GtkWidget *button, i3WorkspacesConfig *config);
@@ -46,14 +57,50 @@ visible_color_changed(GtkWidget *button, i3WorkspacesConfig *config);
 void
 mode_color_changed(GtkWidget *button, i3WorkspacesConfig *config);
 void
+show_binding_mode_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
 strip_workspace_numbers_changed(GtkWidget *button, i3WorkspacesConfig *config);
 void
 auto_detect_outputs_changed(GtkWidget *button, i3WorkspacesConfig *config);
 void
 output_changed(GtkWidget *entry, i3WorkspacesConfig *config);
+void
+max_buttons_changed(GtkWidget *spin, i3WorkspacesConfig *config);
+void
+blink_urgent_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+group_outputs_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+probe_latency_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+show_window_counts_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+show_window_title_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+show_window_icons_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+show_window_tooltips_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+dump_stats_clicked(GtkWidget *button, GtkWidget *label);
+void
+set_color(GtkWidget *button, guint32 *color, guint change, i3WorkspacesConfig *config);
 
 void
-config_dialog_closed(GtkWidget *dialog, int response, ConfigDialogClosedParam *param);
+config_dialog_changed(GtkWidget *widget, ConfigDialogParam *param);
+void
+config_dialog_closed(GtkWidget *dialog, int response, ConfigDialogParam *param);
+void
+config_dialog_destroyed(GtkWidget *dialog, ConfigDialogParam *param);
+gboolean
+config_dialog_save(ConfigDialogParam *param);
+
+gboolean
+write_config(i3WorkspacesConfig *config, const gchar *file);
+void
+save_config_thread(GTask *task, gpointer source, gpointer task_data,
+        GCancellable *cancellable);
+void
+save_config_done(GObject *source, GAsyncResult *result, gpointer data);
 
 /* Function Implementations */
 
@@ -121,11 +168,28 @@ i3_workspaces_config_load(i3WorkspacesConfig *config, XfcePanelPlugin *plugin)
     config->urgent_color = xfce_rc_read_int_entry(rc, "urgent_color", 0xff0000);
     config->mode_color = xfce_rc_read_int_entry(rc, "mode_color", 0xff0000);
     config->visible_color = xfce_rc_read_int_entry(rc, "visible_color", 0x000000);
+    config->show_binding_mode = xfce_rc_read_bool_entry(rc,
+            "show_binding_mode", TRUE);
     config->strip_workspace_numbers = xfce_rc_read_bool_entry(rc,
             "strip_workspace_numbers", FALSE);
     config->auto_detect_outputs = xfce_rc_read_bool_entry(rc,
             "auto_detect_outputs", FALSE);
     config->output = g_strdup(xfce_rc_read_entry(rc, "output", ""));
+    config->probe_latency = xfce_rc_read_bool_entry(rc,
+            "probe_latency", FALSE);
+    config->show_window_counts = xfce_rc_read_bool_entry(rc,
+            "show_window_counts", FALSE);
+    config->show_window_title = xfce_rc_read_bool_entry(rc,
+            "show_window_title", FALSE);
+    config->show_window_icons = xfce_rc_read_bool_entry(rc,
+            "show_window_icons", FALSE);
+    config->show_window_tooltips = xfce_rc_read_bool_entry(rc,
+            "show_window_tooltips", FALSE);
+    config->max_buttons = MAX(0, xfce_rc_read_int_entry(rc, "max_buttons", 0));
+    config->blink_urgent = xfce_rc_read_bool_entry(rc,
+            "blink_urgent", FALSE);
+    config->group_outputs = xfce_rc_read_bool_entry(rc,
+            "group_outputs", FALSE);
 
     xfce_rc_close(rc);
 
@@ -135,30 +199,153 @@ i3_workspaces_config_load(i3WorkspacesConfig *config, XfcePanelPlugin *plugin)
 gboolean
 i3_workspaces_config_save(i3WorkspacesConfig *config, XfcePanelPlugin *plugin)
 {
+    /* the write in flight is dropped if it did not start yet, or waited for */
+    if (config->save_cancellable)
+    {
+        g_cancellable_cancel(config->save_cancellable);
+        g_clear_object(&config->save_cancellable);
+    }
+    config->save_again = FALSE;
+
     gchar *file = xfce_panel_plugin_save_location(plugin, TRUE);
     if (G_UNLIKELY(!file))
         return FALSE;
 
-    XfceRc *rc = xfce_rc_simple_open(file, FALSE);
+    G_LOCK(write_config);
+    gboolean saved = write_config(config, file);
+    G_UNLOCK(write_config);
     g_free(file);
 
+    return saved;
+}
+
+/*
+ * Write the configuration in a thread. While a write is in flight, the
+ * configuration is only written again once it is done.
+ */
+void
+i3_workspaces_config_save_async(i3WorkspacesConfig *config, XfcePanelPlugin *plugin)
+{
+    if (config->save_cancellable)
+    {
+        config->save_again = TRUE;
+        return;
+    }
+
+    gchar *file = xfce_panel_plugin_save_location(plugin, TRUE);
+    if (G_UNLIKELY(!file))
+        return;
+
+    // the thread writes a copy, so the configuration can change meanwhile
+    i3WorkspacesConfig *copy = g_new(i3WorkspacesConfig, 1);
+    *copy = *config;
+    copy->output = g_strdup(config->output);
+    copy->dialog = NULL;
+    copy->save_cancellable = NULL;
+
+    config->save_cancellable = g_cancellable_new();
+
+    GTask *task = g_task_new(plugin, config->save_cancellable, save_config_done, config);
+    g_object_set_data_full(G_OBJECT(task), "file", file, g_free);
+    g_task_set_task_data(task, copy, (GDestroyNotify) i3_workspaces_config_free);
+    g_task_run_in_thread(task, save_config_thread);
+    g_object_unref(task);
+}
+
+void
+save_config_thread(GTask *task, gpointer source, gpointer task_data,
+        GCancellable *cancellable)
+{
+    const gchar *file = (const gchar *) g_object_get_data(G_OBJECT(task), "file");
+
+    G_LOCK(write_config);
+    gboolean saved = !g_cancellable_is_cancelled(cancellable) &&
+        write_config((i3WorkspacesConfig *) task_data, file);
+    G_UNLOCK(write_config);
+
+    g_task_return_boolean(task, saved);
+}
+
+void
+save_config_done(GObject *source, GAsyncResult *result, gpointer data)
+{
+    // cancelled by i3_workspaces_config_save, the configuration may be gone
+    if (g_cancellable_is_cancelled(g_task_get_cancellable(G_TASK(result))))
+        return;
+
+    i3WorkspacesConfig *config = (i3WorkspacesConfig *) data;
+    g_clear_object(&config->save_cancellable);
+
+    if (config->save_again)
+    {
+        config->save_again = FALSE;
+        i3_workspaces_config_save_async(config, XFCE_PANEL_PLUGIN(source));
+    }
+}
+
+/*
+ * Write the configuration to a temporary file next to the rc file and rename
+ * it over the rc file, so it is never seen half written.
+ */
+gboolean
+write_config(i3WorkspacesConfig *config, const gchar *file)
+{
+    gchar *tmp_file = g_strconcat(file, ".XXXXXX", NULL);
+    gint fd = g_mkstemp(tmp_file);
+    if (fd == -1)
+    {
+        g_free(tmp_file);
+        return FALSE;
+    }
+    close(fd);
+
+    XfceRc *rc = xfce_rc_simple_open(tmp_file, FALSE);
+    if (G_UNLIKELY(!rc))
+    {
+        g_unlink(tmp_file);
+        g_free(tmp_file);
+        return FALSE;
+    }
+
     xfce_rc_write_int_entry(rc, "normal_color", config->normal_color);
     xfce_rc_write_int_entry(rc, "focused_color", config->focused_color);
     xfce_rc_write_int_entry(rc, "urgent_color", config->urgent_color);
     xfce_rc_write_int_entry(rc, "mode_color", config->mode_color);
     xfce_rc_write_int_entry(rc, "visible_color", config->visible_color);
+    xfce_rc_write_bool_entry(rc, "show_binding_mode",
+            config->show_binding_mode);
     xfce_rc_write_bool_entry(rc, "strip_workspace_numbers",
             config->strip_workspace_numbers);
     xfce_rc_write_bool_entry(rc, "auto_detect_outputs",
                              config->auto_detect_outputs);
     xfce_rc_write_entry(rc, "output", config->output);
+    xfce_rc_write_bool_entry(rc, "probe_latency", config->probe_latency);
+    xfce_rc_write_bool_entry(rc, "show_window_counts",
+            config->show_window_counts);
+    xfce_rc_write_bool_entry(rc, "show_window_title",
+            config->show_window_title);
+    xfce_rc_write_bool_entry(rc, "show_window_icons",
+            config->show_window_icons);
+    xfce_rc_write_bool_entry(rc, "show_window_tooltips",
+            config->show_window_tooltips);
+    xfce_rc_write_int_entry(rc, "max_buttons", config->max_buttons);
+    xfce_rc_write_bool_entry(rc, "blink_urgent",
+            config->blink_urgent);
+    xfce_rc_write_bool_entry(rc, "group_outputs",
+            config->group_outputs);
 
     xfce_rc_close(rc);
 
-    return TRUE;
+    gboolean saved = g_rename(tmp_file, file) == 0;
+    if (!saved)
+        g_unlink(tmp_file);
+
+    g_free(tmp_file);
+
+    return saved;
 }
 
-void add_color_picker(i3WorkspacesConfig *config, GtkWidget *dialog_vbox, char *text, guint32 color, gpointer callback) {
+void add_color_picker(ConfigDialogParam *param, GtkWidget *dialog_vbox, char *text, guint32 color, gpointer callback) {
     GtkWidget *hbox, *button, *label;
 
     /* focused color */
@@ -172,7 +359,8 @@ void add_color_picker(i3WorkspacesConfig *config, GtkWidget *dialog_vbox, char *
     button = gtk_color_button_new_with_color(unserialize_gdkcolor(
                 color));
     gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
-    g_signal_connect(G_OBJECT(button), "color-set", G_CALLBACK(callback), config);
+    g_signal_connect(G_OBJECT(button), "color-set", G_CALLBACK(callback), param->config);
+    g_signal_connect(G_OBJECT(button), "color-set", G_CALLBACK(config_dialog_changed), param);
 }
 
 void
@@ -193,11 +381,29 @@ i3_workspaces_config_show(i3WorkspacesConfig *config, XfcePanelPlugin *plugin,
 
     dialog_vbox = GTK_DIALOG(dialog)->vbox;
 
-    add_color_picker(config, dialog_vbox, "Normal Workspace Color:", config->normal_color, normal_color_changed);
-    add_color_picker(config, dialog_vbox, "Focused Workspace Color:", config->focused_color, focused_color_changed);
-    add_color_picker(config, dialog_vbox, "Urgent Workspace Color:", config->urgent_color, urgent_color_changed);
-    add_color_picker(config, dialog_vbox, "Unfocused Visible Workspace Color:", config->visible_color, visible_color_changed);
-    add_color_picker(config, dialog_vbox, "Binding Mode Color:", config->mode_color, mode_color_changed);
+    /* changes are applied as they are made and saved once they settle */
+    ConfigDialogParam *param = g_new0(ConfigDialogParam, 1);
+    param->plugin = plugin;
+    param->config = config;
+    param->cb = cb;
+    param->cb_data = cb_data;
+
+    add_color_picker(param, dialog_vbox, "Normal Workspace Color:", config->normal_color, normal_color_changed);
+    add_color_picker(param, dialog_vbox, "Focused Workspace Color:", config->focused_color, focused_color_changed);
+    add_color_picker(param, dialog_vbox, "Urgent Workspace Color:", config->urgent_color, urgent_color_changed);
+    add_color_picker(param, dialog_vbox, "Unfocused Visible Workspace Color:", config->visible_color, visible_color_changed);
+    add_color_picker(param, dialog_vbox, "Binding Mode Color:", config->mode_color, mode_color_changed);
+
+    /* binding mode */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Show Binding Mode"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->show_binding_mode == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(show_binding_mode_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
 
     /* strip workspace numbers */
     hbox = gtk_hbox_new(FALSE, 3);
@@ -208,6 +414,62 @@ i3_workspaces_config_show(i3WorkspacesConfig *config, XfcePanelPlugin *plugin,
     gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->strip_workspace_numbers == TRUE);
     g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(strip_workspace_numbers_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
+
+    /* window counts */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Show Window Counts"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->show_window_counts == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(show_window_counts_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
+
+    /* window icons */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Show Window Icons"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->show_window_icons == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(show_window_icons_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
+
+    /* window list tooltips */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("List Windows in Tooltips"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->show_window_tooltips == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(show_window_tooltips_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
+
+    /* blink urgent */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Blink Urgent Workspaces"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->blink_urgent == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(blink_urgent_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
+
+    /* window title */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Show Window Title"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->show_window_title == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(show_window_title_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
 
     /* auto detect output */
     hbox = gtk_hbox_new(FALSE, 3);
@@ -218,6 +480,7 @@ i3_workspaces_config_show(i3WorkspacesConfig *config, XfcePanelPlugin *plugin,
     gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->auto_detect_outputs == TRUE);
     g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(auto_detect_outputs_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
 
     /* output */
     hbox = gtk_hbox_new(FALSE, 3);
@@ -231,88 +494,301 @@ i3_workspaces_config_show(i3WorkspacesConfig *config, XfcePanelPlugin *plugin,
     gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
     gtk_entry_set_text(GTK_ENTRY(button), config->output);
     g_signal_connect(G_OBJECT(button), "changed", G_CALLBACK(output_changed), config);
+    g_signal_connect(G_OBJECT(button), "changed", G_CALLBACK(config_dialog_changed), param);
+
+    /* group outputs */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Show All Outputs, Grouped"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->group_outputs == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(group_outputs_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
+
+    /* max buttons */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    label = gtk_label_new(_("Maximum Buttons (0 for all):"));
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+
+    button = gtk_spin_button_new_with_range(0, 999, 1);
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(button), config->max_buttons);
+    g_signal_connect(G_OBJECT(button), "value-changed", G_CALLBACK(max_buttons_changed), config);
+    g_signal_connect(G_OBJECT(button), "value-changed", G_CALLBACK(config_dialog_changed), param);
+
+    /* probe latency */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Slow down updates while i3 is busy"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->probe_latency == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(probe_latency_changed), config);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(config_dialog_changed), param);
+
+    /* debug: dump the performance counters */
+    hbox = gtk_hbox_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_button_new_with_mnemonic(_("_Dump Statistics"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+
+    label = gtk_label_new(NULL);
+    gtk_label_set_selectable(GTK_LABEL(label), TRUE);
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+    g_signal_connect(G_OBJECT(button), "clicked", G_CALLBACK(dump_stats_clicked), label);
 
 
     /* close event */
-    ConfigDialogClosedParam *param = g_new(ConfigDialogClosedParam, 1);
-    param->plugin = plugin;
-    param->config = config;
-    param->cb = cb;
-    param->cb_data = cb_data;
     g_signal_connect(G_OBJECT(dialog), "response", G_CALLBACK(config_dialog_closed), param);
+    g_signal_connect(G_OBJECT(dialog), "destroy", G_CALLBACK(config_dialog_destroyed), param);
+    config->dialog = dialog;
 
     gtk_widget_show_all(dialog);
 }
 
+void
+i3_workspaces_config_hide(i3WorkspacesConfig *config)
+{
+    if (config->dialog)
+        gtk_widget_destroy(config->dialog);
+}
+
 void
 strip_workspace_numbers_changed(GtkWidget *button, i3WorkspacesConfig *config)
 {
-    config->strip_workspace_numbers = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->strip_workspace_numbers == active) return;
+
+    config->strip_workspace_numbers = active;
+    config->changes |= I3W_CONFIG_CHANGED_STRIP_NUMBERS;
 }
 
 void
 auto_detect_outputs_changed(GtkWidget *button, i3WorkspacesConfig *config)
 {
-    config->auto_detect_outputs = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->auto_detect_outputs == active) return;
+
+    config->auto_detect_outputs = active;
+    config->changes |= I3W_CONFIG_CHANGED_AUTO_DETECT;
+}
+
+void
+probe_latency_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->probe_latency == active) return;
+
+    config->probe_latency = active;
+    config->changes |= I3W_CONFIG_CHANGED_PROBE_LATENCY;
+}
+
+void
+show_window_counts_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->show_window_counts == active) return;
+
+    config->show_window_counts = active;
+    config->changes |= I3W_CONFIG_CHANGED_WINDOW_COUNTS;
+}
+
+void
+show_window_title_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->show_window_title == active) return;
+
+    config->show_window_title = active;
+    config->changes |= I3W_CONFIG_CHANGED_WINDOW_TITLE;
+}
+
+void
+show_window_icons_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->show_window_icons == active) return;
+
+    config->show_window_icons = active;
+    config->changes |= I3W_CONFIG_CHANGED_WINDOW_ICONS;
+}
+
+void
+show_window_tooltips_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->show_window_tooltips == active) return;
+
+    config->show_window_tooltips = active;
+    config->changes |= I3W_CONFIG_CHANGED_WINDOW_TOOLTIPS;
 }
 
 void
 output_changed(GtkWidget *entry, i3WorkspacesConfig *config)
 {
-    config->output = g_strdup(gtk_entry_get_text(GTK_ENTRY(entry)));
+    const gchar *output = gtk_entry_get_text(GTK_ENTRY(entry));
+    if (g_strcmp0(config->output, output) == 0) return;
+
+    g_free(config->output);
+    config->output = g_strdup(output);
+    config->changes |= I3W_CONFIG_CHANGED_OUTPUT;
+}
+
+void
+max_buttons_changed(GtkWidget *spin, i3WorkspacesConfig *config)
+{
+    gint max_buttons = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(spin));
+    if (config->max_buttons == max_buttons) return;
+
+    config->max_buttons = max_buttons;
+    config->changes |= I3W_CONFIG_CHANGED_MAX_BUTTONS;
+}
+
+void
+blink_urgent_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->blink_urgent == active) return;
+
+    config->blink_urgent = active;
+    config->changes |= I3W_CONFIG_CHANGED_BLINK_URGENT;
+}
+
+void
+show_binding_mode_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->show_binding_mode == active) return;
+
+    config->show_binding_mode = active;
+    config->changes |= I3W_CONFIG_CHANGED_BINDING_MODE;
+}
+
+void
+group_outputs_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (config->group_outputs == active) return;
+
+    config->group_outputs = active;
+    config->changes |= I3W_CONFIG_CHANGED_GROUP_OUTPUTS;
+}
+
+void
+dump_stats_clicked(GtkWidget *button, GtkWidget *label)
+{
+    GError *err = NULL;
+    gchar *path = i3w_stats_dump(&err);
+
+    if (path)
+    {
+        gtk_label_set_text(GTK_LABEL(label), path);
+        g_free(path);
+    }
+    else
+    {
+        gtk_label_set_text(GTK_LABEL(label), err->message);
+        g_error_free(err);
+    }
+}
+
+void
+set_color(GtkWidget *button, guint32 *color, guint change, i3WorkspacesConfig *config)
+{
+    GdkColor gdkcolor;
+    gtk_color_button_get_color(GTK_COLOR_BUTTON(button), &gdkcolor);
+
+    guint32 serialized = serialize_gdkcolor(&gdkcolor);
+    if (*color == serialized) return;
+
+    *color = serialized;
+    config->changes |= change;
 }
 
 void
 normal_color_changed(GtkWidget *button, i3WorkspacesConfig *config)
 {
-    GdkColor color;
-    gtk_color_button_get_color(GTK_COLOR_BUTTON(button), &color);
-    config->normal_color = serialize_gdkcolor(&color);
+    set_color(button, &config->normal_color, I3W_CONFIG_CHANGED_COLORS, config);
 }
 
 void
 focused_color_changed(GtkWidget *button, i3WorkspacesConfig *config)
 {
-    GdkColor color;
-    gtk_color_button_get_color(GTK_COLOR_BUTTON(button), &color);
-    config->focused_color = serialize_gdkcolor(&color);
+    set_color(button, &config->focused_color, I3W_CONFIG_CHANGED_COLORS, config);
 }
 
 void
 urgent_color_changed(GtkWidget *button, i3WorkspacesConfig *config)
 {
-    GdkColor color;
-    gtk_color_button_get_color(GTK_COLOR_BUTTON(button), &color);
-    config->urgent_color = serialize_gdkcolor(&color);
+    set_color(button, &config->urgent_color, I3W_CONFIG_CHANGED_COLORS, config);
 }
 
 void
 visible_color_changed(GtkWidget *button, i3WorkspacesConfig *config)
 {
-    GdkColor color;
-    gtk_color_button_get_color(GTK_COLOR_BUTTON(button), &color);
-    config->visible_color = serialize_gdkcolor(&color);
+    set_color(button, &config->visible_color, I3W_CONFIG_CHANGED_COLORS, config);
 }
 
 void
-
 mode_color_changed(GtkWidget *button, i3WorkspacesConfig *config)
 {
-    GdkColor color;
-    gtk_color_button_get_color(GTK_COLOR_BUTTON(button), &color);
-    config->mode_color = serialize_gdkcolor(&color);
+    set_color(button, &config->mode_color, I3W_CONFIG_CHANGED_MODE_COLOR, config);
 }
 
 void
-config_dialog_closed(GtkWidget *dialog, int response, ConfigDialogClosedParam *param)
+config_dialog_changed(GtkWidget *widget, ConfigDialogParam *param)
 {
-    xfce_panel_plugin_unblock_menu(param->plugin);
+    guint changes = param->config->changes;
+    if (!changes) return;
+
+    param->config->changes = 0;
+
+    /* preview the change right away */
+    if (param->cb) param->cb(changes, param->cb_data);
 
+    /* but only write the file once the changes settle */
+    if (param->save_source) g_source_remove(param->save_source);
+    param->save_source = g_timeout_add(SAVE_DELAY_MS,
+            (GSourceFunc) config_dialog_save, param);
+}
+
+gboolean
+config_dialog_save(ConfigDialogParam *param)
+{
+    param->save_source = 0;
+
+    i3_workspaces_config_save_async(param->config, param->plugin);
+
+    return FALSE;
+}
+
+void
+config_dialog_closed(GtkWidget *dialog, int response, ConfigDialogParam *param)
+{
     gtk_widget_destroy(dialog);
+}
+
+void
+config_dialog_destroyed(GtkWidget *dialog, ConfigDialogParam *param)
+{
+    xfce_panel_plugin_unblock_menu(param->plugin);
 
-    i3_workspaces_config_save(param->config, param->plugin);
+    param->config->dialog = NULL;
 
-    if (param->cb) param->cb(param->cb_data);
+    /* write a pending change now */
+    if (param->save_source)
+    {
+        g_source_remove(param->save_source);
+        config_dialog_save(param);
+    }
 
     g_free(param);
 }
@@ -21,6 +21,25 @@
 
 #include <libxfce4panel/xfce-panel-plugin.h>
 
+/* the fields of the configuration which changed */
+typedef enum
+{
+    I3W_CONFIG_CHANGED_COLORS = 1 << 0,
+    I3W_CONFIG_CHANGED_MODE_COLOR = 1 << 1,
+    I3W_CONFIG_CHANGED_STRIP_NUMBERS = 1 << 2,
+    I3W_CONFIG_CHANGED_AUTO_DETECT = 1 << 3,
+    I3W_CONFIG_CHANGED_OUTPUT = 1 << 4,
+    I3W_CONFIG_CHANGED_PROBE_LATENCY = 1 << 5,
+    I3W_CONFIG_CHANGED_WINDOW_COUNTS = 1 << 6,
+    I3W_CONFIG_CHANGED_WINDOW_TITLE = 1 << 7,
+    I3W_CONFIG_CHANGED_WINDOW_ICONS = 1 << 8,
+    I3W_CONFIG_CHANGED_WINDOW_TOOLTIPS = 1 << 9,
+    I3W_CONFIG_CHANGED_MAX_BUTTONS = 1 << 10,
+    I3W_CONFIG_CHANGED_BLINK_URGENT = 1 << 11,
+    I3W_CONFIG_CHANGED_GROUP_OUTPUTS = 1 << 12,
+    I3W_CONFIG_CHANGED_BINDING_MODE = 1 << 13
+} i3WorkspacesConfigChanges;
+
 typedef struct
 {
     guint32 normal_color;
@@ -28,13 +47,32 @@ typedef struct
     guint32 visible_color;
     guint32 urgent_color;
     guint32 mode_color;
+    gboolean show_binding_mode;
     gboolean strip_workspace_numbers;
     gboolean auto_detect_outputs;
     gchar *output;
+    gboolean probe_latency;
+    gboolean show_window_counts;
+    gboolean show_window_title;
+    gboolean show_window_icons;
+    gboolean show_window_tooltips;
+    gint max_buttons; // 0 for a button per workspace
+    gboolean blink_urgent;
+    gboolean group_outputs; // every output, overrides output
+
+    /* i3WorkspacesConfigChanges not yet passed to the callback */
+    guint changes;
+
+    /* the open configuration dialog, see i3_workspaces_config_show */
+    GtkWidget *dialog;
+
+    /* the background write, see i3_workspaces_config_save_async */
+    GCancellable *save_cancellable; // set while a write is in flight
+    gboolean save_again; // changed meanwhile, saved once the write is done
 }
 i3WorkspacesConfig;
 
-typedef void (*ConfigChangedCallback) (gpointer cb_data);
+typedef void (*ConfigChangedCallback) (guint changes, gpointer cb_data);
 
 /* utility functions */
 guint32
@@ -52,7 +90,11 @@ i3_workspaces_config_load(i3WorkspacesConfig *config, XfcePanelPlugin *plugin);
 gboolean
 i3_workspaces_config_save(i3WorkspacesConfig *config, XfcePanelPlugin *plugin);
 void
+i3_workspaces_config_save_async(i3WorkspacesConfig *config, XfcePanelPlugin *plugin);
+void
 i3_workspaces_config_show(i3WorkspacesConfig *config, XfcePanelPlugin *plugin,
         ConfigChangedCallback cb, gpointer cb_data);
+void
+i3_workspaces_config_hide(i3WorkspacesConfig *config);
 
 #endif /* I3W_CONFIG_H */
@@ -0,0 +1,220 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "i3w-icons.h"
+#include "i3w-stats.h"
+
+typedef struct
+{
+    i3wIconsChangedCallback callback;
+    gpointer data;
+} IconsListener;
+
+// "size:class" => GdkPixbuf or NULL, and the keys from the least recently
+// used; shared by every plugin instance of the process
+static GHashTable *icons = NULL;
+static GQueue *lru = NULL;
+
+// an IconsListener per plugin instance, the cache lives while there is one
+static GSList *listeners = NULL;
+static gulong theme_handler = 0;
+
+static GdkPixbuf *
+load_icon(GtkIconTheme *theme, const gchar *class, gint size);
+static void
+free_icon(gpointer icon);
+static void
+clear_icons(void);
+static void
+on_icon_theme_changed(GtkIconTheme *theme, gpointer data);
+
+/* Function Implementations */
+
+/**
+ * i3_workspaces_icons_install:
+ * @callback: called when the icon theme changed and the cache was emptied
+ * @data: the callback data
+ *
+ * Register a plugin instance with the cache, which is created and follows
+ * the icon theme from the first one. Every install must be paired with an
+ * i3_workspaces_icons_remove.
+ */
+void
+i3_workspaces_icons_install(i3wIconsChangedCallback callback, gpointer data)
+{
+    IconsListener *listener = g_new0(IconsListener, 1);
+    listener->callback = callback;
+    listener->data = data;
+
+    if (listeners == NULL)
+    {
+        icons = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_icon);
+        lru = g_queue_new();
+        theme_handler = g_signal_connect(G_OBJECT(gtk_icon_theme_get_default()),
+                "changed", G_CALLBACK(on_icon_theme_changed), NULL);
+    }
+
+    listeners = g_slist_append(listeners, listener);
+}
+
+/**
+ * i3_workspaces_icons_remove:
+ * @callback: the installed callback
+ * @data: the installed callback data
+ *
+ * Unregister a plugin instance. The cache is freed and stops following the
+ * icon theme with the last one, before the module may be unloaded.
+ */
+void
+i3_workspaces_icons_remove(i3wIconsChangedCallback callback, gpointer data)
+{
+    GSList *item;
+    for (item = listeners; item != NULL; item = item->next)
+    {
+        IconsListener *listener = (IconsListener *) item->data;
+        if (listener->callback == callback && listener->data == data)
+            break;
+    }
+
+    g_return_if_fail(item != NULL);
+
+    g_free(item->data);
+    listeners = g_slist_delete_link(listeners, item);
+
+    if (listeners == NULL)
+    {
+        g_signal_handler_disconnect(G_OBJECT(gtk_icon_theme_get_default()),
+                theme_handler);
+        theme_handler = 0;
+
+        clear_icons();
+        g_hash_table_destroy(icons);
+        g_queue_free(lru);
+        icons = NULL;
+        lru = NULL;
+    }
+}
+
+/**
+ * i3_workspaces_icons_lookup:
+ * @class: the window class
+ * @size: the size in pixels
+ *
+ * Look up the icon of the window class at the size, loading it from the
+ * icon theme if it is not cached, and make it the most recently used one.
+ * A class without an icon is cached too, so it is not looked up again.
+ *
+ * Returns: the icon, owned by the cache and valid until the next lookup,
+ * or NULL
+ */
+GdkPixbuf *
+i3_workspaces_icons_lookup(const gchar *class, gint size)
+{
+    GtkIconTheme *theme = gtk_icon_theme_get_default();
+    gpointer key, icon;
+
+    g_return_val_if_fail(icons != NULL, NULL);
+
+    gchar *name = g_strdup_printf("%d:%s", size, class);
+    if (g_hash_table_lookup_extended(icons, name, &key, &icon))
+    {
+        g_free(name);
+        g_queue_remove(lru, key);
+        g_queue_push_tail(lru, key);
+        i3w_stats.icon_cache_hits++;
+        return (GdkPixbuf *) icon;
+    }
+
+    icon = load_icon(theme, class, size);
+
+    g_hash_table_insert(icons, name, icon);
+    g_queue_push_tail(lru, name);
+    i3w_stats.icon_cache_misses++;
+
+    while (g_queue_get_length(lru) > I3W_ICONS_CACHE_SIZE)
+    {
+        g_hash_table_remove(icons, g_queue_pop_head(lru));
+        i3w_stats.icon_cache_evictions++;
+    }
+
+    return (GdkPixbuf *) icon;
+}
+
+/**
+ * load_icon:
+ * @theme: the icon theme
+ * @class: the window class
+ * @size: the size in pixels
+ *
+ * Load the icon named like the class, e.g. "firefox" for "Firefox", and
+ * scale it to the size.
+ *
+ * Returns: a new icon or NULL
+ */
+static GdkPixbuf *
+load_icon(GtkIconTheme *theme, const gchar *class, gint size)
+{
+    gchar *lower = g_utf8_strdown(class, -1);
+    const gchar *names[] = { lower, class };
+    GdkPixbuf *icon = NULL;
+
+    guint i;
+    for (i = 0; i < G_N_ELEMENTS(names) && icon == NULL; i++)
+    {
+        if (gtk_icon_theme_has_icon(theme, names[i]))
+            icon = gtk_icon_theme_load_icon(theme, names[i], size,
+                    GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
+    }
+
+    g_free(lower);
+
+    return icon;
+}
+
+/* the classes without an icon are cached as NULL */
+static void
+free_icon(gpointer icon)
+{
+    if (icon)
+        g_object_unref(icon);
+}
+
+static void
+clear_icons(void)
+{
+    g_queue_clear(lru);
+    g_hash_table_remove_all(icons);
+}
+
+/* empty the cache first, then let every instance reload its icons */
+static void
+on_icon_theme_changed(GtkIconTheme *theme, gpointer data)
+{
+    clear_icons();
+
+    GSList *item;
+    for (item = listeners; item != NULL; item = item->next)
+    {
+        IconsListener *listener = (IconsListener *) item->data;
+        listener->callback(listener->data);
+    }
+}
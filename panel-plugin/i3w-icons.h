@@ -0,0 +1,45 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_ICONS_H__
+#define __I3W_ICONS_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * The icons of the window classes, looked up in the icon theme and scaled
+ * once, then shared by all buttons of all plugin instances of the process.
+ * The cache is bounded and drops the least recently used icons; it is
+ * emptied when the icon theme changes, and then the plugin instances are
+ * told to reload their icons.
+ */
+
+/* how many icons are kept, counting the classes without an icon */
+#define I3W_ICONS_CACHE_SIZE 64
+
+typedef void (*i3wIconsChangedCallback) (gpointer data);
+
+void
+i3_workspaces_icons_install(i3wIconsChangedCallback callback, gpointer data);
+void
+i3_workspaces_icons_remove(i3wIconsChangedCallback callback, gpointer data);
+
+GdkPixbuf *
+i3_workspaces_icons_lookup(const gchar *class, gint size);
+
+#endif /* !__I3W_ICONS_H__ */
@@ -0,0 +1,116 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "i3w-labels.h"
+
+/* Function Implementations */
+
+/**
+ * i3_workspaces_label_name:
+ * @workspace: the workspace
+ * @config: the configuration
+ *
+ * Compute the name displayed on the workspace button.
+ *
+ * Returns: the name, to be freed with g_free
+ */
+gchar *
+i3_workspaces_label_name(i3workspace *workspace, i3WorkspacesConfig *config)
+{
+    return config->strip_workspace_numbers ?
+        i3_workspaces_strip_number(workspace->name, workspace->num) :
+        g_strdup(workspace->name);
+}
+
+/**
+ * i3_workspaces_label_markup:
+ * @workspace: the workspace
+ * @name: the displayed name
+ * @config: the configuration
+ * @lit: FALSE to draw an urgent workspace like a calm one, while blinking
+ *
+ * Generate the label markup from the displayed name and the workspace state.
+ *
+ * Returns: the markup, to be freed with g_free
+ */
+gchar *
+i3_workspaces_label_markup(i3workspace *workspace, const gchar *name,
+        i3WorkspacesConfig *config, gboolean lit)
+{
+    static gchar *template = "<span foreground=\"#%06X\" weight=\"%s\">%s%s</span>";
+    static gchar *focused_weight = "bold";
+    static gchar *blurred_weight = "normal";
+
+    // Set label color based on workspace state
+    guint32 color;
+    if (workspace->urgent && lit) color = config->urgent_color;
+    else if (workspace->focused) color = config->focused_color;
+    else if (workspace->visible) color = config->visible_color;
+    else color = config->normal_color;
+
+    // the window count, or a hollow circle for an empty workspace
+    gchar badge[32] = "";
+    if (config->show_window_counts && workspace->windows > 0)
+        g_snprintf(badge, sizeof(badge), " <small>%d</small>", workspace->windows);
+    else if (config->show_window_counts && workspace->windows == 0)
+        g_strlcpy(badge, " <small>\u25CB</small>", sizeof(badge));
+
+    return g_strdup_printf(template,
+            color,
+            workspace->focused ? focused_weight : blurred_weight,
+            name, badge);
+}
+
+/**
+ * i3_workspaces_strip_number:
+ * @name - the name of the workspace
+ * @num - the number of the workspace
+ *
+ * Strips the workspace name of the workspace number.
+ *
+ * Returns: the stripped name, to be freed with g_free
+ */
+gchar *
+i3_workspaces_strip_number(const gchar *name, int num)
+{
+    size_t offset = 0;
+    offset += (num < 10) ? 1 : 2;
+    if (name[offset] == ':') offset++;
+
+    int len = strlen(name);
+    gchar *strippedName = NULL;
+
+    if (offset < len)
+    {
+        int strippedLen = len - offset + 1;
+        strippedName = (gchar *) g_malloc(strippedLen);
+        strippedName = memcpy(strippedName, name + offset, strippedLen);
+    }
+    else
+    {
+        strippedName = g_strdup(name);
+    }
+
+    return strippedName;
+}
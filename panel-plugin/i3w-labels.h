@@ -0,0 +1,38 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_LABELS_H__
+#define __I3W_LABELS_H__
+
+#include "i3wm-delegate.h"
+#include "i3w-config.h"
+
+/*
+ * The text of the workspace buttons, kept free of widgets so it can be
+ * measured on its own.
+ */
+
+gchar *
+i3_workspaces_label_name(i3workspace *workspace, i3WorkspacesConfig *config);
+gchar *
+i3_workspaces_label_markup(i3workspace *workspace, const gchar *name,
+        i3WorkspacesConfig *config, gboolean lit);
+gchar *
+i3_workspaces_strip_number(const gchar *name, int num);
+
+#endif /* !__I3W_LABELS_H__ */
@@ -47,15 +47,20 @@ is_connected (Connection c) {
  */
 i3_workspaces_outputs_t
 get_outputs() {
+    i3_workspaces_outputs_t outputs;
+    outputs.num_outputs = 0;
+    outputs.outputs = NULL;
+
     // Get Xlib information
     Display* dpy = XOpenDisplay (NULL); 
+    if (dpy == NULL)
+        return outputs;
 	int screen = DefaultScreen (dpy);
     Window root = RootWindow (dpy, screen);
 	XRRScreenResources* res = XRRGetScreenResourcesCurrent (dpy, root);
     int num_outputs = res->noutput;
 
     // Allocate output
-    i3_workspaces_outputs_t outputs;
     outputs.outputs = malloc(sizeof(i3_workspaces_output_t)*num_outputs);
 
     // NOTE: We will only store connected outputs, even though we allocated space
@@ -81,10 +86,15 @@ get_outputs() {
                 output->y = info->y;
 
                 num_connected_outputs++;
+                XRRFreeCrtcInfo(info);
             }
         }
+        XRRFreeOutputInfo(output_info);
     }
 
+    XRRFreeScreenResources(res);
+    XCloseDisplay(dpy);
+
     outputs.num_outputs = num_connected_outputs;
     return outputs;
 
@@ -99,6 +109,9 @@ get_outputs() {
  */
 void
 free_outputs(i3_workspaces_outputs_t outputs) {
+  int o;
+  for (o = 0; o < outputs.num_outputs; ++o)
+    free(outputs.outputs[o].name);
   free(outputs.outputs);
 }
 
@@ -24,6 +24,7 @@
 #endif
 
 #include <libxfce4panel/xfce-hvbox.h>
+#include <gdk/gdkx.h>
 #include <glib/gprintf.h>
 
 #include "i3w-plugin.h"
@@ -53,19 +54,100 @@ static void
 configure_plugin(XfcePanelPlugin *plugin, i3WorkspacesPlugin *i3_workspaces);
 
 static void
-config_changed(gpointer cb_data);
+config_changed(guint changes, gpointer cb_data);
+static void
+set_tick_probe(i3WorkspacesPlugin *i3_workspaces);
+static void
+set_title_shown(i3WorkspacesPlugin *i3_workspaces);
+static void
+set_mode_shown(i3WorkspacesPlugin *i3_workspaces);
+static void
+set_window_tracking(i3WorkspacesPlugin *i3_workspaces);
+static void
+set_tooltips_shown(i3WorkspacesPlugin *i3_workspaces);
 
 static void
 add_workspaces(i3WorkspacesPlugin *i3_workspaces);
+
+static gboolean
+is_workspace_shown(i3WorkspacesPlugin *i3_workspaces, i3workspace *workspace);
+static GHashTable *
+get_strip_workspaces(i3WorkspacesPlugin *i3_workspaces);
+static gboolean
+gets_button(i3WorkspacesPlugin *i3_workspaces, GHashTable *strip, i3workspace *workspace);
+static void
+set_overflow_count(i3WorkspacesPlugin *i3_workspaces, gint hidden);
+static void
+on_overflow_clicked(GtkWidget *button, gpointer data);
+static void
+on_overflow_item_activated(GtkWidget *item, gpointer data);
+static void
+add_workspace_button(i3WorkspacesPlugin *i3_workspaces, i3workspace *workspace);
+static void
+remove_workspace_button(i3WorkspacesPlugin *i3_workspaces, i3workspace *workspace);
+static void
+reorder_workspace_buttons(i3WorkspacesPlugin *i3_workspaces);
+static void
+reorder_output_groups(i3WorkspacesPlugin *i3_workspaces);
+static gint
+output_group_cmp(gconstpointer a, gconstpointer b, gpointer data);
+static void
+update_output_ranks(i3WorkspacesPlugin *i3_workspaces);
 static void
-remove_workspaces(i3WorkspacesPlugin *i3_workspaces);
+clear_output_separators(i3WorkspacesPlugin *i3_workspaces);
+static void
+filter_workspace_buttons(i3WorkspacesPlugin *i3_workspaces);
+static void
+restyle_workspace_buttons(i3WorkspacesPlugin *i3_workspaces, gboolean names);
+static void
+reconcile_workspaces(i3WorkspacesPlugin *i3_workspaces);
+static void
+queue_strip_update(i3WorkspacesPlugin *i3_workspaces, gboolean refilter);
+static void
+schedule_update(i3WorkspacesPlugin *i3_workspaces);
+static gboolean
+on_update_workspaces(gpointer data);
+static void
+apply_workspace_changes(i3WorkspacesPlugin *i3_workspaces,
+        i3workspace *workspace, guint types);
+static void
+clear_pending_changes(i3WorkspacesPlugin *i3_workspaces);
 
+static gboolean
+is_rendering(i3WorkspacesPlugin *i3_workspaces);
 static void
-set_button_label(GtkWidget *button, i3workspace *workspace,
+reconcile_if_outdated(i3WorkspacesPlugin *i3_workspaces);
+static void
+update_rendering(i3WorkspacesPlugin *i3_workspaces);
+static void
+on_plugin_mapped(GtkWidget *ebox, gpointer data);
+static void
+on_plugin_unmapped(GtkWidget *ebox, gpointer data);
+static gboolean
+on_plugin_visibility_changed(GtkWidget *ebox, GdkEventVisibility *ev, gpointer data);
+
+static void
+set_button_name(GtkWidget *button, i3workspace *workspace,
         i3WorkspacesConfig *config);
+static void
+set_button_label(GtkWidget *button, i3workspace *workspace,
+        i3WorkspacesPlugin *i3_workspaces);
+static void
+set_urgent_labels(i3WorkspacesPlugin *i3_workspaces);
+
+static void
+on_button_blink(GtkWidget *button, gpointer data);
+static void
+set_button_icons(GtkWidget *button, i3workspace *workspace,
+        i3WorkspacesPlugin *i3_workspaces);
+static void
+clear_button_icons(GtkWidget *button);
+static void
+on_icons_changed(gpointer data);
 
-static gchar *
-strip_workspace_numbers(const gchar *name, int num);
+static gboolean
+on_workspace_query_tooltip(GtkWidget *button, gint x, gint y, gboolean keyboard,
+        GtkTooltip *tooltip, gpointer data);
 
 static void
 on_workspace_clicked(GtkWidget *button, gpointer data);
@@ -73,23 +155,28 @@ static gboolean
 on_workspace_scrolled(GtkWidget *ebox, GdkEventScroll *ev, gpointer data);
 
 static void
-on_workspace_created(gpointer data);
+on_workspaces_changed(GArray *changes, guint64 generation, gpointer data);
+
 static void
-on_workspace_destroyed(gpointer data);
+on_mode_changed(gchar *mode, gboolean pango_markup, gpointer data);
 static void
-on_workspace_changed(gpointer data);
-
+set_mode_label(i3WorkspacesPlugin *i3_workspaces);
+static i3WorkspacesModeLabel *
+get_mode_label(i3WorkspacesPlugin *i3_workspaces);
 static void
-on_mode_changed(gchar *mode, gpointer data);
+free_mode_label(gpointer mode_label);
 
 static void
 on_output_changed(gchar *mode, gpointer data);
 
 static void
-on_ipc_shutdown(gpointer i3_w);
+on_title_changed(const gchar *title, gpointer data);
 
 static void
-recover_from_disconnect(i3WorkspacesPlugin *i3_workspaces);
+on_ipc_shutdown(gpointer i3_w);
+
+static gboolean
+connect_to_i3(gpointer data);
 
 static void
 handle_change_output(i3WorkspacesPlugin* i3_workspaces);
@@ -108,20 +195,14 @@ XFCE_PANEL_PLUGIN_REGISTER(construct);
 static void
 connect_callbacks(i3WorkspacesPlugin *i3_workspaces)
 {
-    i3wm_set_on_workspace_created(i3_workspaces->i3wm,
-            on_workspace_changed, i3_workspaces);
-    i3wm_set_on_workspace_destroyed(i3_workspaces->i3wm,
-            on_workspace_changed, i3_workspaces);
-    i3wm_set_on_workspace_blurred(i3_workspaces->i3wm,
-            on_workspace_changed, i3_workspaces);
-    i3wm_set_on_workspace_focused(i3_workspaces->i3wm,
-            on_workspace_changed, i3_workspaces);
-    i3wm_set_on_workspace_urgent(i3_workspaces->i3wm,
-            on_workspace_changed, i3_workspaces);
+    i3wm_set_on_workspaces_changed(i3_workspaces->i3wm,
+            on_workspaces_changed, i3_workspaces);
     i3wm_set_on_mode_changed(i3_workspaces->i3wm,
             on_mode_changed, i3_workspaces);
     i3wm_set_on_output_changed(i3_workspaces->i3wm,
             on_output_changed, i3_workspaces);
+    i3wm_set_on_title_changed(i3_workspaces->i3wm,
+            on_title_changed, i3_workspaces);
     i3wm_set_on_ipc_shutdown(i3_workspaces->i3wm,
             on_ipc_shutdown, i3_workspaces);
 }
@@ -144,6 +225,8 @@ construct_workspaces(XfcePanelPlugin *plugin)
 
     /* allocate memory for the plugin structure */
     i3_workspaces = panel_slice_new0(i3WorkspacesPlugin);
+    i3WorkspacesStartup *startup = &i3_workspaces->startup;
+    startup->started = g_get_monotonic_time();
 
     /* pointer to plugin */
     i3_workspaces->plugin = plugin;
@@ -151,6 +234,7 @@ construct_workspaces(XfcePanelPlugin *plugin)
     /* plugin configuration */
     i3_workspaces->config = i3_workspaces_config_new();
     i3_workspaces_config_load(i3_workspaces->config, plugin);
+    startup->config_load = g_get_monotonic_time() - startup->started;
 
     /* get the current orientation */
     orientation = xfce_panel_plugin_get_orientation (plugin);
@@ -160,31 +244,100 @@ construct_workspaces(XfcePanelPlugin *plugin)
     gtk_widget_show(i3_workspaces->ebox);
 
     /* listen for scroll events */
-    gtk_widget_add_events(i3_workspaces->ebox, GDK_SCROLL_MASK);
+    gtk_widget_add_events(i3_workspaces->ebox,
+            GDK_SCROLL_MASK | GDK_VISIBILITY_NOTIFY_MASK);
     g_signal_connect(G_OBJECT(i3_workspaces->ebox), "scroll-event",
             G_CALLBACK(on_workspace_scrolled), i3_workspaces);
 
+    /* stop updating the buttons while nobody can see them */
+    g_signal_connect(G_OBJECT(i3_workspaces->ebox), "map",
+            G_CALLBACK(on_plugin_mapped), i3_workspaces);
+    g_signal_connect(G_OBJECT(i3_workspaces->ebox), "unmap",
+            G_CALLBACK(on_plugin_unmapped), i3_workspaces);
+    g_signal_connect(G_OBJECT(i3_workspaces->ebox), "visibility-notify-event",
+            G_CALLBACK(on_plugin_visibility_changed), i3_workspaces);
+
     i3_workspaces->hvbox = xfce_hvbox_new(orientation, FALSE, 2);
     gtk_widget_show(i3_workspaces->hvbox);
     gtk_container_add(GTK_CONTAINER(i3_workspaces->ebox), i3_workspaces->hvbox);
 
     i3_workspaces->workspace_buttons = g_hash_table_new(g_direct_hash, g_direct_equal);
+    i3_workspaces->pending_changes = g_hash_table_new(g_direct_hash, g_direct_equal);
+    i3_workspaces->output_ranks = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    i3_workspaces->output_separators = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    update_output_ranks(i3_workspaces);
+
+    i3_workspaces->mode_labels = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, free_mode_label);
+
+    /* the icons are resized with the panel and reloaded with the theme */
+    i3_workspaces->icon_size = 16;
+    i3_workspaces_icons_install(on_icons_changed, i3_workspaces);
 
 	/* Add a label for the binding mode */
 	i3_workspaces->mode_label = gtk_label_new(NULL);
 	gtk_box_pack_end(GTK_BOX(i3_workspaces->hvbox), i3_workspaces->mode_label, FALSE, FALSE, 0);
 	gtk_widget_show(i3_workspaces->mode_label);
 
-    GError *err = NULL;
-    i3_workspaces->i3wm = i3wm_construct(&err);
-    if (NULL != err)
+    /* Add a box for the workspace buttons, left of the binding mode */
+    i3_workspaces->buttons_box = xfce_hvbox_new(orientation, FALSE, 2);
+    gtk_box_pack_end(GTK_BOX(i3_workspaces->hvbox), i3_workspaces->buttons_box, FALSE, FALSE, 0);
+    gtk_widget_show(i3_workspaces->buttons_box);
+
+    /* Add the menu of the workspaces left out of the strip, after the buttons */
+    i3_workspaces->overflow_button = xfce_panel_create_button();
+    gtk_button_set_relief(GTK_BUTTON(i3_workspaces->overflow_button), GTK_RELIEF_NONE);
+    gtk_widget_set_no_show_all(i3_workspaces->overflow_button, TRUE);
+    g_signal_connect(G_OBJECT(i3_workspaces->overflow_button), "clicked",
+            G_CALLBACK(on_overflow_clicked), i3_workspaces);
+    xfce_panel_plugin_add_action_widget(plugin, i3_workspaces->overflow_button);
+    gtk_box_pack_end(GTK_BOX(i3_workspaces->hvbox), i3_workspaces->overflow_button,
+            FALSE, FALSE, 0);
+    gtk_box_reorder_child(GTK_BOX(i3_workspaces->hvbox), i3_workspaces->overflow_button, 1);
+
+    /* Add the title of the focused window, between the buttons and the mode */
+    i3_workspaces->title = i3_workspaces_title_new();
+    gtk_box_pack_end(GTK_BOX(i3_workspaces->hvbox),
+            i3_workspaces_title_get_widget(i3_workspaces->title), FALSE, FALSE, 0);
+    gtk_box_reorder_child(GTK_BOX(i3_workspaces->hvbox),
+            i3_workspaces_title_get_widget(i3_workspaces->title), 1);
+
+    /* paint the last known workspaces until i3 answers */
+    i3_workspaces->i3wm = i3wm_new();
+    i3wm_set_display(i3_workspaces->i3wm, gdk_x11_get_default_xdisplay());
+    set_tick_probe(i3_workspaces);
+    set_window_tracking(i3_workspaces);
+    set_title_shown(i3_workspaces);
+    set_mode_shown(i3_workspaces);
+
+    gint64 phase = g_get_monotonic_time();
+    gchar *output = NULL;
+    GSList *snapshot = i3_workspaces_snapshot_load(plugin, &output);
+    if (snapshot)
     {
-        recover_from_disconnect(i3_workspaces);
+        i3wm_seed_workspaces(i3_workspaces->i3wm, snapshot);
+
+        if (i3_workspaces->config->auto_detect_outputs && output)
+        {
+            g_free(i3_workspaces->config->output);
+            i3_workspaces->config->output = output;
+            output = NULL;
+        }
     }
+    g_free(output);
+    startup->snapshot_load = g_get_monotonic_time() - phase;
 
     connect_callbacks(i3_workspaces);
 
     add_workspaces(i3_workspaces);
+    startup->widgets = g_get_monotonic_time() - startup->started -
+        startup->config_load - startup->snapshot_load;
+
+    /* connect once the first frame is drawn */
+    i3_workspaces->connect_source = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+            connect_to_i3, i3_workspaces, NULL);
 
     return i3_workspaces;
 }
@@ -222,8 +375,17 @@ construct(XfcePanelPlugin *plugin)
     /* show the configure menu item */
     xfce_panel_plugin_menu_show_configure(plugin);
 
+    /* dump the performance counters on SIGUSR2 */
+    i3w_stats_install_signal_handler();
+
     /* Auto-detect output configuration */
+    gint64 phase = g_get_monotonic_time();
     handle_change_output(i3_workspaces);
+
+    i3WorkspacesStartup *startup = &i3_workspaces->startup;
+    startup->output_detection = g_get_monotonic_time() - phase;
+    startup->constructed = g_get_monotonic_time() - startup->started;
+    g_object_set_data(G_OBJECT(plugin), I3W_STARTUP_KEY, startup);
 }
 
 /**
@@ -236,16 +398,42 @@ construct(XfcePanelPlugin *plugin)
 static void
 destruct(XfcePanelPlugin *plugin, i3WorkspacesPlugin *i3_workspaces)
 {
-    /* save configuration */
+    if (i3_workspaces->connect_source)
+        g_source_remove(i3_workspaces->connect_source);
+    clear_pending_changes(i3_workspaces);
+
+    g_object_set_data(G_OBJECT(plugin), I3W_STARTUP_KEY, NULL);
+
+    i3w_stats_remove_signal_handler();
+
+    /* save the workspaces for the next start */
+    i3_workspaces_snapshot_save(plugin, i3wm_get_workspaces(i3_workspaces->i3wm),
+            i3_workspaces->config->output);
+
+    /* close the dialog, which edits the configuration, and save it */
+    i3_workspaces_config_hide(i3_workspaces->config);
     i3_workspaces_config_save(i3_workspaces->config, plugin);
     i3_workspaces_config_free(i3_workspaces->config);
 
+    g_free(i3_workspaces->mode);
+    g_hash_table_destroy(i3_workspaces->mode_labels);
+
+    i3_workspaces_icons_remove(on_icons_changed, i3_workspaces);
+
+    /* the ebox is unmapped after the plugin structure is gone */
+    g_signal_handlers_disconnect_by_data(G_OBJECT(i3_workspaces->ebox), i3_workspaces);
+
     /* destroy the panel widgets */
     gtk_widget_destroy(i3_workspaces->hvbox);
+    g_hash_table_destroy(i3_workspaces->output_separators);
+    g_hash_table_destroy(i3_workspaces->pending_changes);
+    g_hash_table_destroy(i3_workspaces->output_ranks);
 
     /* destroy the i3wm delegate */
     i3wm_destruct(i3_workspaces->i3wm);
 
+    i3_workspaces_title_free(i3_workspaces->title);
+
     /* free the plugin structure */
     panel_slice_free(i3WorkspacesPlugin, i3_workspaces);
 }
@@ -274,6 +462,14 @@ size_changed(XfcePanelPlugin *plugin, gint size, i3WorkspacesPlugin *i3_workspac
     else
         gtk_widget_set_size_request(GTK_WIDGET(plugin), size, -1);
 
+    /* fit the window icons into the buttons */
+    gint icon_size = CLAMP(size - 12, 12, 24);
+    if (i3_workspaces->icon_size != icon_size)
+    {
+        i3_workspaces->icon_size = icon_size;
+        restyle_workspace_buttons(i3_workspaces, FALSE);
+    }
+
     /* we handled the orientation */
     return TRUE;
 }
@@ -290,8 +486,13 @@ static void
 orientation_changed(XfcePanelPlugin *plugin,
         GtkOrientation orientation, i3WorkspacesPlugin *i3_workspaces)
 {
-    /* change the orienation of the box */
+    /* change the orienation of the boxes */
     xfce_hvbox_set_orientation(XFCE_HVBOX(i3_workspaces->hvbox), orientation);
+    xfce_hvbox_set_orientation(XFCE_HVBOX(i3_workspaces->buttons_box), orientation);
+
+    /* the separators between the output groups run across the strip */
+    clear_output_separators(i3_workspaces);
+    reorder_workspace_buttons(i3_workspaces);
 }
 
 
@@ -312,349 +513,1600 @@ configure_plugin(XfcePanelPlugin *plugin, i3WorkspacesPlugin *i3_workspaces)
 
 /**
  * config_changed:
+ * @changes: the i3WorkspacesConfigChanges flags of the changed fields
  * @gpointer cb_data: the callback data
  *
- * Callback funtion which is called when the configuration is updated
+ * Callback funtion which is called when the configuration is updated.
+ * Only the work the changed fields require is done.
  */
 static void
-config_changed(gpointer cb_data)
+config_changed(guint changes, gpointer cb_data)
 {
     i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) cb_data;
 
-    handle_change_output(i3_workspaces);
-    remove_workspaces(i3_workspaces);
-    add_workspaces(i3_workspaces);
+    if (changes & I3W_CONFIG_CHANGED_AUTO_DETECT)
+        handle_change_output(i3_workspaces);
+
+    if (changes & I3W_CONFIG_CHANGED_GROUP_OUTPUTS)
+        update_output_ranks(i3_workspaces);
+
+    if (changes & (I3W_CONFIG_CHANGED_OUTPUT | I3W_CONFIG_CHANGED_MAX_BUTTONS |
+                I3W_CONFIG_CHANGED_GROUP_OUTPUTS))
+        queue_strip_update(i3_workspaces, TRUE);
+
+    if (changes & (I3W_CONFIG_CHANGED_WINDOW_COUNTS | I3W_CONFIG_CHANGED_WINDOW_ICONS |
+                I3W_CONFIG_CHANGED_WINDOW_TOOLTIPS))
+        set_window_tracking(i3_workspaces);
+
+    if (changes & I3W_CONFIG_CHANGED_WINDOW_TOOLTIPS)
+        set_tooltips_shown(i3_workspaces);
+
+    if (changes & (I3W_CONFIG_CHANGED_COLORS | I3W_CONFIG_CHANGED_STRIP_NUMBERS |
+                I3W_CONFIG_CHANGED_WINDOW_COUNTS | I3W_CONFIG_CHANGED_WINDOW_ICONS |
+                I3W_CONFIG_CHANGED_BLINK_URGENT))
+        restyle_workspace_buttons(i3_workspaces,
+                changes & I3W_CONFIG_CHANGED_STRIP_NUMBERS);
+
+    if (changes & I3W_CONFIG_CHANGED_MODE_COLOR)
+    {
+        g_hash_table_remove_all(i3_workspaces->mode_labels);
+        set_mode_label(i3_workspaces);
+    }
+
+    if (changes & I3W_CONFIG_CHANGED_PROBE_LATENCY)
+        set_tick_probe(i3_workspaces);
+
+    if (changes & I3W_CONFIG_CHANGED_WINDOW_TITLE)
+        set_title_shown(i3_workspaces);
+
+    if (changes & I3W_CONFIG_CHANGED_BINDING_MODE)
+        set_mode_shown(i3_workspaces);
 }
 
 /**
- * add_workspaces:
+ * set_tick_probe:
  * @i3_workspaces: the workspaces plugin
  *
- * Add the workspaces.
+ * Let the delegate measure the IPC round trip, if configured, to coalesce
+ * the updates while i3 is busy. Nothing is probed while the plugin is not
+ * rendering, so a hidden panel does not wake up for the ticks.
  */
 static void
-add_workspaces(i3WorkspacesPlugin *i3_workspaces)
+set_tick_probe(i3WorkspacesPlugin *i3_workspaces)
 {
-    GSList *wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
+    gboolean probing = i3_workspaces->config->probe_latency && is_rendering(i3_workspaces);
 
-    GSList *witem;
-    for (witem = wlist; witem != NULL; witem = witem->next)
-    {
-        i3workspace *workspace = (i3workspace *) witem->data;
-        if (workspace &&
-            (i3_workspaces->config->output[0] == 0 ||
-             g_strcmp0(i3_workspaces->config->output, workspace->output) == 0))
-        {
-            GtkWidget * button;
-            button = xfce_panel_create_button();
-            gtk_button_set_label(GTK_BUTTON(button), workspace->name);
+    i3wm_set_tick_probe(i3_workspaces->i3wm, probing ? I3WM_TICK_PROBE_INTERVAL_MS : 0);
+}
 
-            set_button_label(button, workspace, i3_workspaces->config);
+/**
+ * set_title_shown:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Show the title of the focused window, if configured, and let the delegate
+ * follow it only then.
+ */
+static void
+set_title_shown(i3WorkspacesPlugin *i3_workspaces)
+{
+    gboolean shown = i3_workspaces->config->show_window_title;
 
-            g_signal_connect(G_OBJECT(button), "clicked",
-                    G_CALLBACK(on_workspace_clicked), i3_workspaces);
+    gtk_widget_set_visible(i3_workspaces_title_get_widget(i3_workspaces->title), shown);
+    if (!shown)
+        i3_workspaces_title_set(i3_workspaces->title, NULL);
 
-            /* show the panel's right-click menu on this button */
-            xfce_panel_plugin_add_action_widget(i3_workspaces->plugin, button);
+    i3wm_set_title_tracking(i3_workspaces->i3wm, shown);
+}
 
-            /* avoid acceleration key interference */
-            gtk_button_set_use_underline(GTK_BUTTON(button), FALSE);
-            gtk_box_pack_end(GTK_BOX(i3_workspaces->hvbox), button, FALSE, FALSE, 0);
-            gtk_widget_show(button);
+/**
+ * set_mode_shown:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Show the binding mode, if configured, and let the delegate read the mode
+ * events only then. The mode is unknown until the next change once shown
+ * again, so it starts out as the default mode.
+ */
+static void
+set_mode_shown(i3WorkspacesPlugin *i3_workspaces)
+{
+    gboolean shown = i3_workspaces->config->show_binding_mode;
 
-            g_hash_table_insert(i3_workspaces->workspace_buttons, workspace, button);
-        }
+    gtk_widget_set_visible(i3_workspaces->mode_label, shown);
+    if (!shown)
+    {
+        g_free(i3_workspaces->mode);
+        i3_workspaces->mode = NULL;
+        set_mode_label(i3_workspaces);
     }
+
+    i3wm_set_mode_tracking(i3_workspaces->i3wm, shown);
 }
 
 /**
- * remove_workspaces:
+ * set_window_tracking:
  * @i3_workspaces: the workspaces plugin
  *
- * Remove all workspaces.
+ * Let the delegate keep the windows of every workspace only while their
+ * counts, icons or titles are shown.
  */
 static void
-remove_workspaces(i3WorkspacesPlugin *i3_workspaces)
+set_window_tracking(i3WorkspacesPlugin *i3_workspaces)
 {
-    GList *wlist = g_hash_table_get_values(i3_workspaces->workspace_buttons);
-    g_hash_table_remove_all(i3_workspaces->workspace_buttons);
-    g_list_free_full(wlist, (GDestroyNotify) gtk_widget_destroy);
+    i3wm_set_window_tracking(i3_workspaces->i3wm,
+            i3_workspaces->config->show_window_counts ||
+            i3_workspaces->config->show_window_icons ||
+            i3_workspaces->config->show_window_tooltips);
 }
 
 /**
- * on_workspace_changed:
- * @workspace: the workspace
- * @data: the workspaces plugin
+ * set_tooltips_shown:
+ * @i3_workspaces: the workspaces plugin
  *
- * Workspace changed event handler.
+ * Let the buttons ask for their tooltip, if configured.
  */
 static void
-on_workspace_changed(gpointer data)
+set_tooltips_shown(i3WorkspacesPlugin *i3_workspaces)
 {
-    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    GHashTableIter iter;
+    gpointer button;
 
-    remove_workspaces(i3_workspaces);
-    add_workspaces(i3_workspaces);
+    g_hash_table_iter_init(&iter, i3_workspaces->workspace_buttons);
+    while (g_hash_table_iter_next(&iter, NULL, &button))
+        gtk_widget_set_has_tooltip(GTK_WIDGET(button),
+                i3_workspaces->config->show_window_tooltips);
 }
 
 /**
- * on_mode_changed:
- * @mode: the mode
- * @data: the workspaces plugin
+ * add_workspaces:
+ * @i3_workspaces: the workspaces plugin
  *
- * Binging mode changed event handler.
+ * Add the workspaces.
  */
 static void
-on_mode_changed(gchar *mode, gpointer data)
+add_workspaces(i3WorkspacesPlugin *i3_workspaces)
 {
-    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
-	if (!strncmp(mode, "default", 7)) {
-		gtk_label_set_text((GtkLabel *) i3_workspaces->mode_label, "");
+    GSList *wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
+    GHashTable *strip = get_strip_workspaces(i3_workspaces);
+    gint hidden = 0;
+
+    GSList *witem;
+    for (witem = wlist; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        if (workspace && gets_button(i3_workspaces, strip, workspace))
+            add_workspace_button(i3_workspaces, workspace);
+        else if (workspace && is_workspace_shown(i3_workspaces, workspace))
+            hidden++;
     }
-	else {
-		// allocate space for the maximum possible size of the label
-		gulong maxlen = strlen(mode) + 37;
-		gchar *label_str = (gchar *) calloc(maxlen, sizeof(gchar));
 
-		static gchar *template = "<span foreground=\"#%06X\">%s</span>";
-		g_snprintf(label_str, maxlen, template, i3_workspaces->config->mode_color, mode);
+    if (strip)
+        g_hash_table_destroy(strip);
+    set_overflow_count(i3_workspaces, hidden);
 
-		gtk_label_set_markup((GtkLabel *) i3_workspaces->mode_label, label_str);
-	}
+    i3_workspaces->generation = i3wm_get_generation(i3_workspaces->i3wm);
 }
 
 /**
- * handle_change_output:
+ * is_workspace_shown:
  * @i3_workspaces: the workspaces plugin
+ * @workspace: the workspace
  *
- * Recomputes the panel's output based on XRandR's current data.
- * Does not run if auto_detect_outputs is set to false.
+ * Whether the workspace is on the output the plugin is configured for, or
+ * the plugin shows the workspaces of all outputs grouped.
+ *
+ * Returns: gboolean
  */
-static void
-handle_change_output (i3WorkspacesPlugin* i3_workspaces)
+static gboolean
+is_workspace_shown(i3WorkspacesPlugin *i3_workspaces, i3workspace *workspace)
 {
+    const gchar *output = i3_workspaces->config->output;
 
-    if(!i3_workspaces->config->auto_detect_outputs) return;
+    return i3_workspaces->config->group_outputs ||
+        output == NULL || output[0] == 0 ||
+        g_strcmp0(output, workspace->output) == 0;
+}
 
-    // Re-query X Server for monitor information, since it may have changed
-    i3_workspaces_outputs_t outputs = get_outputs();
+/**
+ * get_strip_workspaces:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Pick the shown workspaces which get a button when their number is
+ * limited: the focused, visible and urgent ones, then the others in order
+ * while there is room. The rest is only listed by the overflow menu.
+ *
+ * Returns: the set of the picked workspaces, or NULL if every shown
+ * workspace gets a button
+ */
+static GHashTable *
+get_strip_workspaces(i3WorkspacesPlugin *i3_workspaces)
+{
+    gint room = i3_workspaces->config->max_buttons;
+    if (room <= 0)
+        return NULL;
 
-    // Get the plugin's widget window and its location in root window (i.e: screen) coordinates
-    int x, y;
-    GdkWindow* window = gtk_widget_get_window(i3_workspaces->ebox);
-    gdk_window_get_root_origin(window, &x, &y);
+    GSList *wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
+    GHashTable *strip = g_hash_table_new(g_direct_hash, g_direct_equal);
 
-    // Get the monitor name for the window location and set the config value
-    char* output_name = get_monitor_name_at(outputs, x, y);
+    GSList *witem;
+    for (witem = wlist; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        if ((workspace->focused || workspace->visible || workspace->urgent) &&
+                is_workspace_shown(i3_workspaces, workspace))
+        {
+            g_hash_table_add(strip, workspace);
+            room--;
+        }
+    }
 
-    i3_workspaces->config->output = output_name;
-    remove_workspaces(i3_workspaces);
-    add_workspaces(i3_workspaces);
+    for (witem = wlist; witem != NULL && room > 0; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        if (!g_hash_table_contains(strip, workspace) &&
+                is_workspace_shown(i3_workspaces, workspace))
+        {
+            g_hash_table_add(strip, workspace);
+            room--;
+        }
+    }
 
-    free_outputs(outputs);
+    return strip;
 }
 
 /**
- * on_output_changed:
- * @change: the change field, always "unspecified" for now
- * @data: the workspaces plugin
+ * gets_button:
+ * @i3_workspaces: the workspaces plugin
+ * @strip: the workspaces picked by get_strip_workspaces, or NULL
+ * @workspace: the workspace
  *
- * Output changed event handler.
+ * Returns: whether the workspace has a button of its own
  */
-static void
-on_output_changed(gchar *mode, gpointer data)
+static gboolean
+gets_button(i3WorkspacesPlugin *i3_workspaces, GHashTable *strip, i3workspace *workspace)
 {
-    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
-    handle_change_output(i3_workspaces);
+    return is_workspace_shown(i3_workspaces, workspace) &&
+        (strip == NULL || g_hash_table_contains(strip, workspace));
 }
 
-
 /**
- * set_button_label:
- * @button: the button
- * @name: the workspace name
- * @focused: is the workspace focused?
- * @urgent: is the workspace urgent?
+ * set_overflow_count:
+ * @i3_workspaces: the workspaces plugin
+ * @hidden: the number of shown workspaces without a button
  *
- * Generate the label for the workspace button.
+ * Show the overflow button while some workspaces have no button.
  */
 static void
-set_button_label(GtkWidget *button, i3workspace *workspace,
-        i3WorkspacesConfig *config)
+set_overflow_count(i3WorkspacesPlugin *i3_workspaces, gint hidden)
 {
-    static gchar *template = "<span foreground=\"#%06X\" weight=\"%s\">%s</span>";
-    static gchar *focused_weight = "bold";
-    static gchar *blurred_weight = "normal";
-
-    gchar *name = config->strip_workspace_numbers ?
-        strip_workspace_numbers(workspace->name, workspace->num) :
-        workspace->name;
-
-    // allocate space for the maximum possible size of the label
-    gulong maxlen = strlen(name) + 51;
-    gchar *label_str = (gchar *) calloc(maxlen, sizeof(gchar));
+    if (hidden > 0)
+    {
+        gchar *label = g_strdup_printf("+%d", hidden);
+        gtk_button_set_label(GTK_BUTTON(i3_workspaces->overflow_button), label);
+        g_free(label);
+    }
 
-    // Set label color based on workspace state
-    guint32 color;
-    if (workspace->urgent) color = config->urgent_color;
-    else if (workspace->focused) color = config->focused_color;
-    else if (workspace->visible) color = config->visible_color;
-    else color = config->normal_color;
+    gtk_widget_set_visible(i3_workspaces->overflow_button, hidden > 0);
+}
 
-    g_snprintf(label_str, maxlen, template,
-            color,
-            workspace->focused ? focused_weight : blurred_weight,
-            name);
+/**
+ * add_workspace_button:
+ * @i3_workspaces: the workspaces plugin
+ * @workspace: the workspace
+ *
+ * Create the button of the workspace and pack it at the end of the strip.
+ */
+static void
+add_workspace_button(i3WorkspacesPlugin *i3_workspaces, i3workspace *workspace)
+{
+    GtkWidget * button;
+    button = xfce_panel_create_button();
+
+    /* the label, followed by the icons of the windows on the workspace */
+    GtkWidget *box = gtk_hbox_new(FALSE, 2);
+    GtkWidget *label = gtk_label_new(workspace->name);
+    GtkWidget *icons = gtk_hbox_new(FALSE, 1);
+    gtk_widget_set_no_show_all(icons, TRUE);
+    gtk_box_pack_start(GTK_BOX(box), label, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(box), icons, FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(button), box);
+    gtk_widget_show(label);
+    gtk_widget_show(box);
+    g_object_set_data(G_OBJECT(button), "i3w-label", label);
+    g_object_set_data(G_OBJECT(button), "i3w-icons", icons);
+    g_object_set_data(G_OBJECT(button), "i3w-workspace", workspace);
+
+    set_button_name(button, workspace, i3_workspaces->config);
+    set_button_label(button, workspace, i3_workspaces);
+    set_button_icons(button, workspace, i3_workspaces);
+
+    g_signal_connect(G_OBJECT(button), "clicked",
+            G_CALLBACK(on_workspace_clicked), i3_workspaces);
+
+    /* the window list is only put together when hovered */
+    gtk_widget_set_has_tooltip(button, i3_workspaces->config->show_window_tooltips);
+    g_signal_connect(G_OBJECT(button), "query-tooltip",
+            G_CALLBACK(on_workspace_query_tooltip), i3_workspaces);
+
+    /* show the panel's right-click menu on this button */
+    xfce_panel_plugin_add_action_widget(i3_workspaces->plugin, button);
+
+    /* avoid acceleration key interference */
+    gtk_button_set_use_underline(GTK_BUTTON(button), FALSE);
+    gtk_box_pack_end(GTK_BOX(i3_workspaces->buttons_box), button, FALSE, FALSE, 0);
+    gtk_widget_show(button);
+
+    g_hash_table_insert(i3_workspaces->workspace_buttons, workspace, button);
+    i3w_stats.buttons_created++;
+}
 
-    GtkWidget *label = gtk_bin_get_child(GTK_BIN(button));
-    gtk_label_set_markup(GTK_LABEL(label), label_str);
+/**
+ * remove_workspace_button:
+ * @i3_workspaces: the workspaces plugin
+ * @workspace: the workspace
+ *
+ * Destroy the button of the workspace, if it has one.
+ */
+static void
+remove_workspace_button(i3WorkspacesPlugin *i3_workspaces, i3workspace *workspace)
+{
+    GtkWidget *button = (GtkWidget *) g_hash_table_lookup(
+            i3_workspaces->workspace_buttons, workspace);
 
-    free(label_str);
+    if (button)
+    {
+        g_hash_table_remove(i3_workspaces->workspace_buttons, workspace);
+        gtk_widget_destroy(button);
+        i3w_stats.buttons_destroyed++;
+    }
 }
 
 /**
- * strip_workspace_numbers:
- * @workspaceName - the name of the workspace
- * @workspaceNum - the number of the workspace
+ * reorder_workspace_buttons:
+ * @i3_workspaces: the workspaces plugin
  *
- * Strips the workspace name of the workspace number.
- * Returns: an i3workspace*
+ * Move the buttons to the position of their workspace in the sorted
+ * workspace list.
  */
-static gchar *
-strip_workspace_numbers(const gchar *name, int num)
+static void
+reorder_workspace_buttons(i3WorkspacesPlugin *i3_workspaces)
 {
-    size_t offset = 0;
-    offset += (num < 10) ? 1 : 2;
-    if (name[offset] == ':') offset++;
-
-    int len = strlen(name);
-    gchar *strippedName = NULL;
+    GSList *wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
+    gint position = 0;
 
-    if (offset < len)
+    if (i3_workspaces->config->group_outputs)
     {
-        int strippedLen = len - offset + 1;
-        strippedName = (gchar *) malloc(strippedLen);
-        strippedName = memcpy(strippedName, name + offset, strippedLen);
+        reorder_output_groups(i3_workspaces);
+        return;
     }
-    else
+
+    if (g_hash_table_size(i3_workspaces->output_separators) > 0)
+        clear_output_separators(i3_workspaces);
+
+    GSList *witem;
+    for (witem = wlist; witem != NULL; witem = witem->next)
     {
-        strippedName = strdup(name);
+        GtkWidget *button = (GtkWidget *) g_hash_table_lookup(
+                i3_workspaces->workspace_buttons, witem->data);
+        if (button)
+            gtk_box_reorder_child(GTK_BOX(i3_workspaces->buttons_box), button, position++);
     }
-
-    return strippedName;
 }
 
 /**
- * on_workspace_clicked:
- * @button: the clicked button
- * @data: the workspace plugin
+ * reorder_output_groups:
+ * @i3_workspaces: the workspaces plugin
  *
- * Workspace button click event handler.
+ * Move the buttons into one group per output, the groups ordered by the
+ * position of their monitor and separated, the buttons of a group in the
+ * order of the workspace list. The separators of the groups which are
+ * gone are destroyed.
  */
 static void
-on_workspace_clicked(GtkWidget *button, gpointer data)
+reorder_output_groups(i3WorkspacesPlugin *i3_workspaces)
 {
-    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *)data;
     GSList *wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
-    i3workspace *workspace = NULL;
+    GList *grouped = NULL;
 
     GSList *witem;
     for (witem = wlist; witem != NULL; witem = witem->next)
     {
-        workspace = (i3workspace *) witem->data;
-        GtkWidget *w = (GtkWidget *) g_hash_table_lookup(i3_workspaces->workspace_buttons, workspace);
+        if (g_hash_table_contains(i3_workspaces->workspace_buttons, witem->data))
+            grouped = g_list_prepend(grouped, witem->data);
+    }
+    // the sort is stable, a group keeps the order of the workspace list
+    grouped = g_list_sort_with_data(g_list_reverse(grouped), output_group_cmp, i3_workspaces);
 
-        if (w == button)
-            break;
+    GHashTable *used = g_hash_table_new(g_str_hash, g_str_equal);
+    const gchar *output = NULL;
+    gint position = 0;
+
+    GList *item;
+    for (item = grouped; item != NULL; item = item->next)
+    {
+        i3workspace *workspace = (i3workspace *) item->data;
+
+        if (item != grouped && g_strcmp0(workspace->output, output) != 0)
+        {
+            GtkWidget *separator = (GtkWidget *) g_hash_table_lookup(
+                    i3_workspaces->output_separators, workspace->output);
+            if (separator == NULL)
+            {
+                if (xfce_panel_plugin_get_orientation(i3_workspaces->plugin) ==
+                        GTK_ORIENTATION_HORIZONTAL)
+                    separator = gtk_vseparator_new();
+                else
+                    separator = gtk_hseparator_new();
+                gtk_box_pack_end(GTK_BOX(i3_workspaces->buttons_box), separator,
+                        FALSE, FALSE, 0);
+                gtk_widget_show(separator);
+                g_hash_table_insert(i3_workspaces->output_separators,
+                        g_strdup(workspace->output), separator);
+            }
+
+            g_hash_table_add(used, workspace->output);
+            gtk_box_reorder_child(GTK_BOX(i3_workspaces->buttons_box), separator, position++);
+        }
+        output = workspace->output;
+
+        GtkWidget *button = (GtkWidget *) g_hash_table_lookup(
+                i3_workspaces->workspace_buttons, workspace);
+        gtk_box_reorder_child(GTK_BOX(i3_workspaces->buttons_box), button, position++);
     }
 
-    GError *err = NULL;
-    i3wm_goto_workspace(i3_workspaces->i3wm, workspace, &err);
-    if (err != NULL)
+    GHashTableIter iter;
+    gpointer name, separator;
+    g_hash_table_iter_init(&iter, i3_workspaces->output_separators);
+    while (g_hash_table_iter_next(&iter, &name, &separator))
     {
-        fprintf(stderr, "%s", err->message);
+        if (!g_hash_table_contains(used, name))
+        {
+            gtk_widget_destroy(GTK_WIDGET(separator));
+            g_hash_table_iter_remove(&iter);
+        }
     }
+
+    g_hash_table_destroy(used);
+    g_list_free(grouped);
 }
 
 /**
- * on_workspace_scrolled:
- * @ebox: the plugin's event box
- * @ev: the event data
- * @data: the workspace plugin
+ * output_group_cmp:
+ * @a: i3workspace *
+ * @b: i3workspace *
+ * @data: the workspaces plugin
  *
- * Workspace scroll event handler.
+ * Compare the workspaces by the position of their output; the outputs not
+ * known to XRandR come last, by name.
  *
- * Returns: TRUE to stop event propogation
+ * Returns: gint
  */
-static gboolean
-on_workspace_scrolled(GtkWidget *ebox, GdkEventScroll *ev, gpointer data)
+static gint
+output_group_cmp(gconstpointer a, gconstpointer b, gpointer data)
 {
-    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *)data;
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    const i3workspace *x = (const i3workspace *) a;
+    const i3workspace *y = (const i3workspace *) b;
 
-    GList *wlist = g_hash_table_get_keys(i3_workspaces->workspace_buttons);
-    wlist = g_list_sort(wlist, (GCompareFunc) i3wm_workspace_cmp);
+    gpointer rank;
+    gint x_rank = g_hash_table_lookup_extended(i3_workspaces->output_ranks,
+            x->output, NULL, &rank) ? GPOINTER_TO_INT(rank) : G_MAXINT;
+    gint y_rank = g_hash_table_lookup_extended(i3_workspaces->output_ranks,
+            y->output, NULL, &rank) ? GPOINTER_TO_INT(rank) : G_MAXINT;
 
-    /* Find the focused workspace */
-    i3workspace *workspace = NULL;
-    GList *witem = NULL;
-    for (witem = wlist; witem != NULL; witem = witem->next)
-    {
-        workspace = (i3workspace *) witem->data;
-        if (workspace->focused)
-            break;
+    if (x_rank != y_rank)
+        return x_rank < y_rank ? -1 : 1;
+
+    return g_strcmp0(x->output, y->output);
+}
+
+/**
+ * update_output_ranks:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Rank the outputs by the position of their monitor, left to right, then
+ * top to bottom. XRandR is only asked while the outputs are grouped.
+ */
+static void
+update_output_ranks(i3WorkspacesPlugin *i3_workspaces)
+{
+    g_hash_table_remove_all(i3_workspaces->output_ranks);
+
+    if (!i3_workspaces->config->group_outputs)
+        return;
+
+    i3_workspaces_outputs_t outputs = get_outputs();
+    i3w_stats.xrandr_queries++;
+
+    int i, j;
+    for (i = 0; i < outputs.num_outputs; i++)
+    {
+        i3_workspaces_output_t *output = &outputs.outputs[i];
+        gint rank = 0;
+
+        for (j = 0; j < outputs.num_outputs; j++)
+        {
+            i3_workspaces_output_t *other = &outputs.outputs[j];
+            if (other->x < output->x ||
+                    (other->x == output->x && other->y < output->y) ||
+                    (other->x == output->x && other->y == output->y && j < i))
+                rank++;
+        }
+
+        g_hash_table_insert(i3_workspaces->output_ranks,
+                g_strdup(output->name), GINT_TO_POINTER(rank));
+    }
+
+    free_outputs(outputs);
+}
+
+/**
+ * clear_output_separators:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Destroy the separators between the output groups.
+ */
+static void
+clear_output_separators(i3WorkspacesPlugin *i3_workspaces)
+{
+    GHashTableIter iter;
+    gpointer separator;
+
+    g_hash_table_iter_init(&iter, i3_workspaces->output_separators);
+    while (g_hash_table_iter_next(&iter, NULL, &separator))
+        gtk_widget_destroy(GTK_WIDGET(separator));
+
+    g_hash_table_remove_all(i3_workspaces->output_separators);
+}
+
+/**
+ * filter_workspace_buttons:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Create the missing buttons of the shown workspaces and destroy the buttons
+ * of the workspaces which are not shown any more, e.g. after the output
+ * changed or another workspace took their place in a limited strip. The
+ * other buttons are left alone.
+ */
+static void
+filter_workspace_buttons(i3WorkspacesPlugin *i3_workspaces)
+{
+    GSList *wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
+    GHashTable *strip = get_strip_workspaces(i3_workspaces);
+    gint hidden = 0;
+
+    GSList *witem;
+    for (witem = wlist; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        GtkWidget *button = (GtkWidget *) g_hash_table_lookup(
+                i3_workspaces->workspace_buttons, workspace);
+        gboolean shown = gets_button(i3_workspaces, strip, workspace);
+
+        if (shown && !button)
+            add_workspace_button(i3_workspaces, workspace);
+        else if (!shown && button)
+            remove_workspace_button(i3_workspaces, workspace);
+
+        if (!shown && is_workspace_shown(i3_workspaces, workspace))
+            hidden++;
+    }
+
+    if (strip)
+        g_hash_table_destroy(strip);
+    set_overflow_count(i3_workspaces, hidden);
+
+    reorder_workspace_buttons(i3_workspaces);
+}
+
+/**
+ * restyle_workspace_buttons:
+ * @i3_workspaces: the workspaces plugin
+ * @names: whether the displayed names have to be recomputed too
+ *
+ * Update the labels and the icons of all buttons, e.g. after the colors
+ * changed.
+ */
+static void
+restyle_workspace_buttons(i3WorkspacesPlugin *i3_workspaces, gboolean names)
+{
+    GHashTableIter iter;
+    gpointer workspace, button;
+
+    g_hash_table_iter_init(&iter, i3_workspaces->workspace_buttons);
+    while (g_hash_table_iter_next(&iter, &workspace, &button))
+    {
+        if (names)
+            set_button_name(GTK_WIDGET(button), workspace, i3_workspaces->config);
+        set_button_label(GTK_WIDGET(button), workspace, i3_workspaces);
+        set_button_icons(GTK_WIDGET(button), workspace, i3_workspaces);
+    }
+}
+
+/**
+ * reconcile_workspaces:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Bring the buttons in line with the current workspace model in a single
+ * pass, reusing the buttons which are still valid.
+ */
+static void
+reconcile_workspaces(i3WorkspacesPlugin *i3_workspaces)
+{
+    gint64 start = g_get_monotonic_time();
+    I3W_PROBE1(render_start, 0);
+
+    // the full pass covers whatever is pending
+    clear_pending_changes(i3_workspaces);
+    i3_workspaces->outdated = FALSE;
+
+    filter_workspace_buttons(i3_workspaces);
+    restyle_workspace_buttons(i3_workspaces, TRUE);
+
+    i3_workspaces->generation = i3wm_get_generation(i3_workspaces->i3wm);
+
+    I3W_PROBE1(render_end, 0);
+
+    i3w_stats.full_resyncs++;
+    i3w_stats_record_time(I3W_STATS_RECONCILE, start);
+}
+
+/**
+ * on_workspaces_changed:
+ * @changes: the array of i3wmChange records
+ * @generation: the generation of the workspace model
+ * @data: the workspaces plugin
+ *
+ * Workspaces changed event handler. The buttons of removed workspaces go at
+ * once, so no button outlives its workspace; the other changes are merged
+ * per workspace and applied in one update before the next frame.
+ */
+static void
+on_workspaces_changed(GArray *changes, guint64 generation, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    gboolean limited = i3_workspaces->config->max_buttons > 0;
+
+    if (generation == i3_workspaces->generation)
+        return;
+
+    guint i;
+    for (i = 0; i < changes->len; i++)
+    {
+        i3wmChange *change = &g_array_index(changes, i3wmChange, i);
+        i3workspace *workspace = change->workspace;
+
+        if (change->type == I3WM_CHANGE_REMOVED)
+        {
+            remove_workspace_button(i3_workspaces, workspace);
+            g_hash_table_remove(i3_workspaces->pending_changes, workspace);
+        }
+        else
+        {
+            guint types = GPOINTER_TO_UINT(g_hash_table_lookup(
+                        i3_workspaces->pending_changes, workspace));
+            g_hash_table_insert(i3_workspaces->pending_changes, workspace,
+                    GUINT_TO_POINTER(types | 1 << change->type));
+        }
+
+        // in a limited strip, any but a window change may change which
+        // workspaces get the buttons
+        if (limited && change->type != I3WM_CHANGE_WINDOWS)
+            i3_workspaces->pending_refilter = TRUE;
+
+        // a moved workspace changes its group
+        if (i3_workspaces->config->group_outputs && change->type == I3WM_CHANGE_MOVED)
+            i3_workspaces->pending_reorder = TRUE;
+    }
+
+    // the rest is reconciled when shown again
+    if (!is_rendering(i3_workspaces))
+    {
+        clear_pending_changes(i3_workspaces);
+        return;
+    }
+
+    if (i3_workspaces->update_source == 0)
+        schedule_update(i3_workspaces);
+    i3_workspaces->pending_generation = generation;
+}
+
+/**
+ * queue_strip_update:
+ * @i3_workspaces: the workspaces plugin
+ * @refilter: whether the buttons have to be filtered, not only reordered
+ *
+ * Let the update before the next frame filter or reorder the buttons, e.g.
+ * after the output or the configuration changed, together with the pending
+ * workspace changes. While hidden, the strip is reconciled once shown.
+ */
+static void
+queue_strip_update(i3WorkspacesPlugin *i3_workspaces, gboolean refilter)
+{
+    if (!is_rendering(i3_workspaces))
+    {
+        i3_workspaces->outdated = TRUE;
+        return;
+    }
+
+    if (refilter)
+        i3_workspaces->pending_refilter = TRUE;
+    else
+        i3_workspaces->pending_reorder = TRUE;
+
+    if (i3_workspaces->update_source == 0)
+        schedule_update(i3_workspaces);
+}
+
+/**
+ * schedule_update:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Run on_update_workspaces before the next frame. It brings the buttons to
+ * the generation they reflect until workspace changes are pending.
+ */
+static void
+schedule_update(i3WorkspacesPlugin *i3_workspaces)
+{
+    i3_workspaces->pending_generation = i3_workspaces->generation;
+    i3_workspaces->update_source = g_idle_add_full(I3W_UPDATE_PRIORITY,
+            on_update_workspaces, i3_workspaces, NULL);
+}
+
+/**
+ * on_update_workspaces:
+ * @data: the workspaces plugin
+ *
+ * Apply the pending changes to the buttons, each workspace once.
+ *
+ * Returns: FALSE to remove the source
+ */
+static gboolean
+on_update_workspaces(gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    GHashTableIter iter;
+    gpointer workspace, types;
+
+    i3_workspaces->update_source = 0;
+
+    gint64 start = g_get_monotonic_time();
+    I3W_PROBE1(render_start, g_hash_table_size(i3_workspaces->pending_changes));
+
+    g_hash_table_iter_init(&iter, i3_workspaces->pending_changes);
+    while (g_hash_table_iter_next(&iter, &workspace, &types))
+        apply_workspace_changes(i3_workspaces, (i3workspace *) workspace,
+                GPOINTER_TO_UINT(types));
+
+    if (i3_workspaces->pending_refilter)
+        filter_workspace_buttons(i3_workspaces);
+    else if (i3_workspaces->pending_reorder)
+        reorder_workspace_buttons(i3_workspaces);
+
+    I3W_PROBE1(render_end, g_hash_table_size(i3_workspaces->pending_changes));
+
+    i3_workspaces->generation = i3_workspaces->pending_generation;
+    clear_pending_changes(i3_workspaces);
+
+    i3w_stats.incremental_updates++;
+    i3w_stats_record_time(I3W_STATS_WORKSPACES_CHANGED, start);
+
+    return FALSE;
+}
+
+/**
+ * apply_workspace_changes:
+ * @i3_workspaces: the workspaces plugin
+ * @workspace: the workspace
+ * @types: the changes of the workspace, 1 << i3wmChangeType each
+ *
+ * Bring the button of a workspace in line with its changes.
+ */
+static void
+apply_workspace_changes(i3WorkspacesPlugin *i3_workspaces,
+        i3workspace *workspace, guint types)
+{
+    gboolean limited = i3_workspaces->config->max_buttons > 0;
+    GtkWidget *button = (GtkWidget *) g_hash_table_lookup(
+            i3_workspaces->workspace_buttons, workspace);
+
+    // a limited strip is filtered as a whole
+    if (!limited && types & (1 << I3WM_CHANGE_ADDED | 1 << I3WM_CHANGE_MOVED))
+    {
+        gboolean shown = is_workspace_shown(i3_workspaces, workspace);
+
+        if (shown && !button)
+        {
+            add_workspace_button(i3_workspaces, workspace);
+            button = (GtkWidget *) g_hash_table_lookup(
+                    i3_workspaces->workspace_buttons, workspace);
+            i3_workspaces->pending_reorder = TRUE;
+        }
+        else if (!shown && button)
+        {
+            remove_workspace_button(i3_workspaces, workspace);
+            return;
+        }
+    }
+
+    if (button == NULL)
+        return;
+
+    if (types & 1 << I3WM_CHANGE_RENAMED)
+    {
+        set_button_name(button, workspace, i3_workspaces->config);
+        i3_workspaces->pending_reorder = TRUE;
+    }
+    if (types & 1 << I3WM_CHANGE_WINDOWS)
+        set_button_icons(button, workspace, i3_workspaces);
+    if (types & ~(1 << I3WM_CHANGE_ADDED | 1 << I3WM_CHANGE_MOVED))
+        set_button_label(button, workspace, i3_workspaces);
+}
+
+/**
+ * clear_pending_changes:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Forget the changes waiting for the update.
+ */
+static void
+clear_pending_changes(i3WorkspacesPlugin *i3_workspaces)
+{
+    if (i3_workspaces->update_source)
+    {
+        g_source_remove(i3_workspaces->update_source);
+        i3_workspaces->update_source = 0;
+    }
+    g_hash_table_remove_all(i3_workspaces->pending_changes);
+    i3_workspaces->pending_reorder = FALSE;
+    i3_workspaces->pending_refilter = FALSE;
+}
+
+/**
+ * is_rendering:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Whether the plugin is mapped and not fully obscured, i.e. whether updating
+ * the buttons makes any difference.
+ *
+ * Returns: gboolean
+ */
+static gboolean
+is_rendering(i3WorkspacesPlugin *i3_workspaces)
+{
+    return i3_workspaces->mapped && !i3_workspaces->obscured;
+}
+
+/**
+ * reconcile_if_outdated:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Apply the changes missed while the plugin could not be seen.
+ */
+static void
+reconcile_if_outdated(i3WorkspacesPlugin *i3_workspaces)
+{
+    if (is_rendering(i3_workspaces) && i3_workspaces->i3wm &&
+        (i3_workspaces->outdated ||
+         i3_workspaces->generation != i3wm_get_generation(i3_workspaces->i3wm)))
+        reconcile_workspaces(i3_workspaces);
+}
+
+/**
+ * update_rendering:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Follow the plugin being shown or hidden: the periodic work only runs
+ * while rendering, and the changes missed meanwhile are applied once shown.
+ */
+static void
+update_rendering(i3WorkspacesPlugin *i3_workspaces)
+{
+    set_tick_probe(i3_workspaces);
+    reconcile_if_outdated(i3_workspaces);
+    set_urgent_labels(i3_workspaces);
+}
+
+/**
+ * on_plugin_mapped:
+ * @ebox: the plugin's event box
+ * @data: the workspaces plugin
+ *
+ * Map event handler.
+ */
+static void
+on_plugin_mapped(GtkWidget *ebox, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    i3_workspaces->mapped = TRUE;
+    i3_workspaces->obscured = FALSE;
+
+    update_rendering(i3_workspaces);
+}
+
+/**
+ * on_plugin_unmapped:
+ * @ebox: the plugin's event box
+ * @data: the workspaces plugin
+ *
+ * Unmap event handler, e.g. the panel was hidden.
+ */
+static void
+on_plugin_unmapped(GtkWidget *ebox, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    i3_workspaces->mapped = FALSE;
+
+    update_rendering(i3_workspaces);
+}
+
+/**
+ * on_plugin_visibility_changed:
+ * @ebox: the plugin's event box
+ * @ev: the event data
+ * @data: the workspaces plugin
+ *
+ * Visibility event handler. The plugin is fully obscured e.g. while the
+ * screen is locked or an autohide panel is moved off screen.
+ *
+ * Returns: FALSE to propagate the event
+ */
+static gboolean
+on_plugin_visibility_changed(GtkWidget *ebox, GdkEventVisibility *ev, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    i3_workspaces->obscured = ev->state == GDK_VISIBILITY_FULLY_OBSCURED;
+
+    update_rendering(i3_workspaces);
+
+    return FALSE;
+}
+
+/**
+ * on_mode_changed:
+ * @mode: the mode
+ * @pango_markup: whether the mode name is pango markup
+ * @data: the workspaces plugin
+ *
+ * Binging mode changed event handler.
+ */
+static void
+on_mode_changed(gchar *mode, gboolean pango_markup, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    g_free(i3_workspaces->mode);
+    i3_workspaces->mode = g_strdup(mode);
+    i3_workspaces->mode_markup = pango_markup;
+
+    set_mode_label(i3_workspaces);
+}
+
+/**
+ * set_mode_label:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Render the current binding mode, nothing in the default mode.
+ */
+static void
+set_mode_label(i3WorkspacesPlugin *i3_workspaces)
+{
+    GtkLabel *label = GTK_LABEL(i3_workspaces->mode_label);
+    const gchar *mode = i3_workspaces->mode;
+
+    if (mode == NULL || g_strcmp0(mode, "default") == 0)
+    {
+        gtk_label_set_attributes(label, NULL);
+        gtk_label_set_text(label, "");
+        return;
+    }
+
+    i3WorkspacesModeLabel *mode_label = get_mode_label(i3_workspaces);
+
+    gtk_label_set_text(label, mode_label->text);
+    gtk_label_set_attributes(label, mode_label->attrs);
+}
+
+/**
+ * get_mode_label:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Look up the label of the current binding mode, parsing it in the mode
+ * color the first time. A name which is not valid markup is shown as is.
+ *
+ * Returns: the label, owned by the cache
+ */
+static i3WorkspacesModeLabel *
+get_mode_label(i3WorkspacesPlugin *i3_workspaces)
+{
+    const gchar *mode = i3_workspaces->mode;
+    gboolean pango_markup = i3_workspaces->mode_markup;
+
+    i3WorkspacesModeLabel *mode_label =
+        g_hash_table_lookup(i3_workspaces->mode_labels, mode);
+    if (mode_label && mode_label->pango_markup == pango_markup)
+        return mode_label;
+
+    gchar *escaped = pango_markup ? NULL : g_markup_escape_text(mode, -1);
+    gchar *markup = g_strdup_printf("<span foreground=\"#%06X\">%s</span>",
+            i3_workspaces->config->mode_color, pango_markup ? mode : escaped);
+
+    mode_label = g_slice_new0(i3WorkspacesModeLabel);
+    mode_label->pango_markup = pango_markup;
+
+    GError *tmp_err = NULL;
+    if (!pango_parse_markup(markup, -1, 0, &mode_label->attrs, &mode_label->text,
+                NULL, &tmp_err))
+    {
+        g_printerr("Cannot parse the binding mode %s: %s\n", mode, tmp_err->message);
+        g_error_free(tmp_err);
+        mode_label->text = g_strdup(mode);
+    }
+    i3w_stats.markup_parses++;
+
+    g_free(markup);
+    g_free(escaped);
+
+    g_hash_table_replace(i3_workspaces->mode_labels, g_strdup(mode), mode_label);
+
+    return mode_label;
+}
+
+/**
+ * free_mode_label:
+ * @mode_label: the binding mode label
+ *
+ * Free a cached binding mode label.
+ */
+static void
+free_mode_label(gpointer mode_label)
+{
+    i3WorkspacesModeLabel *label = (i3WorkspacesModeLabel *) mode_label;
+
+    if (label->attrs)
+        pango_attr_list_unref(label->attrs);
+    g_free(label->text);
+    g_slice_free(i3WorkspacesModeLabel, label);
+}
+
+/**
+ * on_title_changed:
+ * @title: the title of the focused window or NULL
+ * @data: the workspaces plugin
+ *
+ * Focused window title changed event handler. Only the title is redrawn.
+ */
+static void
+on_title_changed(const gchar *title, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    i3_workspaces_title_set(i3_workspaces->title, title);
+}
+
+/**
+ * handle_change_output:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Recomputes the panel's output based on XRandR's current data.
+ * Does not run if auto_detect_outputs is set to false.
+ */
+static void
+handle_change_output (i3WorkspacesPlugin* i3_workspaces)
+{
+
+    if(!i3_workspaces->config->auto_detect_outputs) return;
+
+    // Re-query X Server for monitor information, since it may have changed
+    gint64 start = g_get_monotonic_time();
+    i3_workspaces_outputs_t outputs = get_outputs();
+    i3w_stats.xrandr_queries++;
+
+    // Get the plugin's widget window and its location in root window (i.e: screen) coordinates
+    int x, y;
+    GdkWindow* window = gtk_widget_get_window(i3_workspaces->ebox);
+    gdk_window_get_root_origin(window, &x, &y);
+
+    // Get the monitor name for the window location and set the config value,
+    // only re-filtering the workspaces if it differs
+    const char* output_name = get_monitor_name_at(outputs, x, y);
+
+    if (output_name && g_strcmp0(i3_workspaces->config->output, output_name) != 0)
+    {
+        g_free(i3_workspaces->config->output);
+        i3_workspaces->config->output = g_strdup(output_name);
+        queue_strip_update(i3_workspaces, TRUE);
+    }
+
+    free_outputs(outputs);
+
+    i3w_stats_record_time(I3W_STATS_OUTPUT_DETECTION, start);
+}
+
+/**
+ * on_output_changed:
+ * @change: the change field, always "unspecified" for now
+ * @data: the workspaces plugin
+ *
+ * Output changed event handler.
+ */
+static void
+on_output_changed(gchar *mode, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    handle_change_output(i3_workspaces);
+
+    // a monitor may have been added or moved
+    if (i3_workspaces->config->group_outputs)
+    {
+        update_output_ranks(i3_workspaces);
+        queue_strip_update(i3_workspaces, FALSE);
+    }
+}
+
+
+/**
+ * set_button_name:
+ * @button: the button
+ * @workspace: the workspace
+ * @config: the configuration
+ *
+ * Compute the name displayed on the workspace button and keep it on the
+ * button, so restyling does not have to recompute it.
+ */
+static void
+set_button_name(GtkWidget *button, i3workspace *workspace,
+        i3WorkspacesConfig *config)
+{
+    gchar *name = i3_workspaces_label_name(workspace, config);
+
+    g_object_set_data_full(G_OBJECT(button), "i3w-name", name, g_free);
+}
+
+/**
+ * set_button_label:
+ * @button: the button
+ * @workspace: the workspace
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Generate the label for the workspace button from the name set by
+ * set_button_name and the workspace state. The button of an urgent
+ * workspace blinks, if configured, while the plugin is rendering.
+ */
+static void
+set_button_label(GtkWidget *button, i3workspace *workspace,
+        i3WorkspacesPlugin *i3_workspaces)
+{
+    i3WorkspacesConfig *config = i3_workspaces->config;
+
+    gboolean blinking = workspace->urgent && config->blink_urgent &&
+        is_rendering(i3_workspaces);
+    if (blinking)
+        i3_workspaces_blink_start(button, on_button_blink, i3_workspaces);
+    else
+        i3_workspaces_blink_stop(button);
+
+    const gchar *name = (const gchar *) g_object_get_data(G_OBJECT(button), "i3w-name");
+    gchar *label_str = i3_workspaces_label_markup(workspace, name, config,
+            !blinking || i3_workspaces_blink_is_lit());
+
+    // only relayout the label if its markup really changed
+    GtkWidget *label = (GtkWidget *) g_object_get_data(G_OBJECT(button), "i3w-label");
+    if (g_strcmp0(gtk_label_get_label(GTK_LABEL(label)), label_str) != 0)
+    {
+        gtk_label_set_markup(GTK_LABEL(label), label_str);
+        i3w_stats.buttons_restyled++;
+        i3w_stats.markup_parses++;
+    }
+
+    g_free(label_str);
+}
+
+/**
+ * set_urgent_labels:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Relabel the buttons of the urgent workspaces, which stop blinking while
+ * the plugin is not rendering and blink again once it is.
+ */
+static void
+set_urgent_labels(i3WorkspacesPlugin *i3_workspaces)
+{
+    GHashTableIter iter;
+    gpointer workspace, button;
+
+    g_hash_table_iter_init(&iter, i3_workspaces->workspace_buttons);
+    while (g_hash_table_iter_next(&iter, &workspace, &button))
+    {
+        if (((i3workspace *) workspace)->urgent)
+            set_button_label(GTK_WIDGET(button), workspace, i3_workspaces);
+    }
+}
+
+/**
+ * on_button_blink:
+ * @button: the button of an urgent workspace
+ * @data: the workspaces plugin
+ *
+ * Relabel the button in the new phase; no other button is touched.
+ */
+static void
+on_button_blink(GtkWidget *button, gpointer data)
+{
+    i3workspace *workspace = (i3workspace *) g_object_get_data(G_OBJECT(button), "i3w-workspace");
+
+    set_button_label(button, workspace, (i3WorkspacesPlugin *) data);
+}
+
+/**
+ * set_button_icons:
+ * @button: the button
+ * @workspace: the workspace
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Show an icon per class of the windows on the workspace, if configured.
+ * Only the icons of the classes which came or went are touched; a button
+ * whose classes did not change, e.g. when only a window count changed, is
+ * left alone.
+ */
+static void
+set_button_icons(GtkWidget *button, i3workspace *workspace,
+        i3WorkspacesPlugin *i3_workspaces)
+{
+    GtkWidget *icons = (GtkWidget *) g_object_get_data(G_OBJECT(button), "i3w-icons");
+    gchar *classes = NULL;
+
+    if (i3_workspaces->config->show_window_icons && workspace->classes)
+        classes = g_strjoinv("\n", workspace->classes);
+
+    // an icon of another size is no use
+    if (GPOINTER_TO_INT(g_object_get_data(G_OBJECT(icons), "i3w-icon-size")) !=
+            i3_workspaces->icon_size)
+    {
+        clear_button_icons(button);
+        g_object_set_data(G_OBJECT(icons), "i3w-icon-size",
+                GINT_TO_POINTER(i3_workspaces->icon_size));
+    }
+
+    if (g_strcmp0(g_object_get_data(G_OBJECT(button), "i3w-classes"), classes) == 0)
+    {
+        g_free(classes);
+        return;
+    }
+    g_object_set_data_full(G_OBJECT(button), "i3w-classes", classes, g_free);
+
+    // class => image of the icons shown so far
+    GHashTable *images = g_hash_table_new(g_str_hash, g_str_equal);
+    GList *children = gtk_container_get_children(GTK_CONTAINER(icons));
+    GList *item;
+    for (item = children; item != NULL; item = item->next)
+        g_hash_table_insert(images, g_object_get_data(G_OBJECT(item->data), "i3w-class"),
+                item->data);
+    g_list_free(children);
+
+    gint position = 0;
+    gchar **class;
+    for (class = classes ? workspace->classes : NULL; class && *class; class++)
+    {
+        GtkWidget *image = (GtkWidget *) g_hash_table_lookup(images, *class);
+        if (image)
+        {
+            g_hash_table_remove(images, *class);
+        }
+        else
+        {
+            GdkPixbuf *icon = i3_workspaces_icons_lookup(*class, i3_workspaces->icon_size);
+            if (icon == NULL)
+                continue;
+
+            image = gtk_image_new_from_pixbuf(icon);
+            g_object_set_data_full(G_OBJECT(image), "i3w-class", g_strdup(*class), g_free);
+            gtk_box_pack_start(GTK_BOX(icons), image, FALSE, FALSE, 0);
+            gtk_widget_show(image);
+        }
+
+        gtk_box_reorder_child(GTK_BOX(icons), image, position++);
+    }
+
+    // the classes without windows left
+    GHashTableIter iter;
+    gpointer image;
+    g_hash_table_iter_init(&iter, images);
+    while (g_hash_table_iter_next(&iter, NULL, &image))
+        gtk_widget_destroy(GTK_WIDGET(image));
+    g_hash_table_destroy(images);
+
+    gtk_widget_set_visible(icons, position > 0);
+}
+
+/**
+ * clear_button_icons:
+ * @button: the button
+ *
+ * Drop the icons of the button, so the next set_button_icons loads them
+ * again.
+ */
+static void
+clear_button_icons(GtkWidget *button)
+{
+    GtkWidget *icons = (GtkWidget *) g_object_get_data(G_OBJECT(button), "i3w-icons");
+
+    gtk_container_foreach(GTK_CONTAINER(icons), (GtkCallback) gtk_widget_destroy, NULL);
+    gtk_widget_hide(icons);
+    g_object_set_data(G_OBJECT(button), "i3w-classes", NULL);
+}
+
+/**
+ * on_icons_changed:
+ * @data: the workspaces plugin
+ *
+ * Reload the icons of all buttons, after the icon theme changed and the
+ * shared icon cache emptied itself.
+ */
+static void
+on_icons_changed(gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    GHashTableIter iter;
+    gpointer workspace, button;
+
+    g_hash_table_iter_init(&iter, i3_workspaces->workspace_buttons);
+    while (g_hash_table_iter_next(&iter, &workspace, &button))
+    {
+        clear_button_icons(GTK_WIDGET(button));
+        set_button_icons(GTK_WIDGET(button), workspace, i3_workspaces);
     }
+}
+
+/**
+ * on_workspace_query_tooltip:
+ * @button: the hovered button
+ * @x: the x coordinate of the pointer
+ * @y: the y coordinate of the pointer
+ * @keyboard: whether the tooltip was asked for with the keyboard
+ * @tooltip: the tooltip
+ * @data: the workspaces plugin
+ *
+ * List the titles of the windows on the workspace. The delegate keeps the
+ * titles, so no request is sent to i3 while the pointer waits.
+ *
+ * Returns: whether to show the tooltip
+ */
+static gboolean
+on_workspace_query_tooltip(GtkWidget *button, gint x, gint y, gboolean keyboard,
+        GtkTooltip *tooltip, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    i3workspace *workspace = (i3workspace *) g_object_get_data(G_OBJECT(button), "i3w-workspace");
+
+    i3w_stats.tooltip_queries++;
 
-    if (witem == NULL)
+    gchar **titles = i3wm_get_window_titles(i3_workspaces->i3wm, workspace);
+    if (titles == NULL || titles[0] == NULL)
         return FALSE;
 
-    if (ev->direction == GDK_SCROLL_UP)
+    gchar *text = g_strjoinv("\n", titles);
+    gtk_tooltip_set_text(tooltip, text);
+    g_free(text);
+
+    return TRUE;
+}
+
+/**
+ * on_workspace_clicked:
+ * @button: the clicked button
+ * @data: the workspace plugin
+ *
+ * Workspace button click event handler.
+ */
+static void
+on_workspace_clicked(GtkWidget *button, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *)data;
+    i3workspace *workspace = (i3workspace *) g_object_get_data(G_OBJECT(button), "i3w-workspace");
+
+    GError *err = NULL;
+    i3wm_goto_workspace(i3_workspaces->i3wm, workspace, &err);
+    if (err != NULL)
+    {
+        fprintf(stderr, "%s", err->message);
+        g_error_free(err);
+    }
+}
+
+/**
+ * on_overflow_clicked:
+ * @button: the overflow button
+ * @data: the workspaces plugin
+ *
+ * Pop up a menu of the shown workspaces without a button. The menu is only
+ * built now and destroyed once closed, so the hidden workspaces cost no
+ * widgets meanwhile.
+ */
+static void
+on_overflow_clicked(GtkWidget *button, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    GSList *wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
+    GtkWidget *menu = gtk_menu_new();
+
+    GSList *witem;
+    for (witem = wlist; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        if (!is_workspace_shown(i3_workspaces, workspace) ||
+                g_hash_table_contains(i3_workspaces->workspace_buttons, workspace))
+            continue;
+
+        gchar *name = i3_workspaces_label_name(workspace, i3_workspaces->config);
+        GtkWidget *item = gtk_menu_item_new_with_label(name);
+        g_free(name);
+
+        // the workspace may be gone by the time the item is activated
+        g_object_set_data_full(G_OBJECT(item), "i3w-workspace",
+                g_strdup(workspace->name), g_free);
+        g_signal_connect(G_OBJECT(item), "activate",
+                G_CALLBACK(on_overflow_item_activated), i3_workspaces);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+        gtk_widget_show(item);
+    }
+
+    g_signal_connect(G_OBJECT(menu), "selection-done",
+            G_CALLBACK(gtk_widget_destroy), NULL);
+    xfce_panel_plugin_register_menu(i3_workspaces->plugin, GTK_MENU(menu));
+    gtk_menu_popup(GTK_MENU(menu), NULL, NULL, xfce_panel_plugin_position_menu,
+            i3_workspaces->plugin, 0, gtk_get_current_event_time());
+}
+
+/**
+ * on_overflow_item_activated:
+ * @item: the activated menu item
+ * @data: the workspaces plugin
+ *
+ * Go to the workspace of the overflow menu item.
+ */
+static void
+on_overflow_item_activated(GtkWidget *item, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    const gchar *name = (const gchar *) g_object_get_data(G_OBJECT(item), "i3w-workspace");
+    GSList *wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
+
+    GSList *witem;
+    for (witem = wlist; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        if (g_strcmp0(workspace->name, name) != 0)
+            continue;
+
+        GError *err = NULL;
+        i3wm_goto_workspace(i3_workspaces->i3wm, workspace, &err);
+        if (err != NULL)
+        {
+            fprintf(stderr, "%s", err->message);
+            g_error_free(err);
+        }
+        break;
+    }
+}
+
+/**
+ * on_workspace_scrolled:
+ * @ebox: the plugin's event box
+ * @ev: the event data
+ * @data: the workspace plugin
+ *
+ * Workspace scroll event handler.
+ *
+ * Returns: TRUE to stop event propogation
+ */
+static gboolean
+on_workspace_scrolled(GtkWidget *ebox, GdkEventScroll *ev, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *)data;
+
+    // the workspaces behind the overflow button are scrolled through too
+    GList *wlist = NULL;
+    GSList *sitem;
+    for (sitem = i3wm_get_workspaces(i3_workspaces->i3wm); sitem != NULL; sitem = sitem->next)
+    {
+        if (is_workspace_shown(i3_workspaces, (i3workspace *) sitem->data))
+            wlist = g_list_prepend(wlist, sitem->data);
+    }
+    wlist = g_list_reverse(wlist);
+
+    /* Find the focused workspace */
+    i3workspace *workspace = NULL;
+    GList *witem = NULL;
+    for (witem = wlist; witem != NULL; witem = witem->next)
+    {
+        workspace = (i3workspace *) witem->data;
+        if (workspace->focused)
+            break;
+    }
+
+    if (witem != NULL && ev->direction == GDK_SCROLL_UP)
         witem = witem->next;
-    else if (ev->direction == GDK_SCROLL_DOWN)
+    else if (witem != NULL && ev->direction == GDK_SCROLL_DOWN)
         witem = witem->prev;
     else
-        return FALSE;
+        witem = NULL;
 
-    if (witem == NULL)
-        return FALSE;
+    workspace = witem ? (i3workspace *) witem->data : NULL;
+    g_list_free(wlist);
 
-    workspace = (i3workspace *) witem->data;
+    if (workspace == NULL)
+        return FALSE;
 
     GError *err = NULL;
     i3wm_goto_workspace(i3_workspaces->i3wm, workspace, &err);
     if (err != NULL)
     {
         fprintf(stderr, "%s", err->message);
+        g_error_free(err);
     }
     return TRUE;
 }
 
+/**
+ * on_ipc_shutdown:
+ * @i3_w: the workspaces plugin
+ *
+ * IPC shutdown event handler, e.g. i3 is restarting. The buttons are kept
+ * until the reconnected delegate reports the changes.
+ */
 static void
 on_ipc_shutdown(gpointer i3_w)
 {
     i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) i3_w;
 
-    remove_workspaces(i3_workspaces);
-    i3wm_destruct(i3_workspaces->i3wm);
-    i3_workspaces->i3wm = NULL;
-
-    recover_from_disconnect(i3_workspaces);
+    i3_workspaces_snapshot_save(i3_workspaces->plugin,
+            i3wm_get_workspaces(i3_workspaces->i3wm),
+            i3_workspaces->config->output);
 
-    connect_callbacks(i3_workspaces);
-
-    add_workspaces(i3_workspaces);
+    if (!i3_workspaces->connect_source)
+        i3_workspaces->connect_source = g_timeout_add_seconds(1,
+                connect_to_i3, i3_workspaces);
 }
 
-static void
-recover_from_disconnect(i3WorkspacesPlugin *i3_workspaces)
+/**
+ * connect_to_i3:
+ * @data: the workspaces plugin
+ *
+ * Try to connect the delegate to i3, retrying every second without blocking
+ * the panel while i3 is not available.
+ *
+ * Returns: FALSE to remove the source
+ */
+static gboolean
+connect_to_i3(gpointer data)
 {
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
     GError *err = NULL;
 
-    i3_workspaces->i3wm = i3wm_construct(&err);
-    while (NULL != err)
+    i3_workspaces->connect_source = 0;
+
+    i3WorkspacesStartup *startup = &i3_workspaces->startup;
+    if (startup->ipc_attempts > 0)
+        i3w_stats.reconnect_attempts++;
+
+    gint64 phase = g_get_monotonic_time();
+    gboolean connected = i3wm_connect(i3_workspaces->i3wm, &err);
+    startup->ipc_attempts++;
+    startup->ipc_handshake = g_get_monotonic_time() - phase;
+    if (connected && !startup->connected)
+        startup->connected = g_get_monotonic_time();
+
+    if (!connected)
     {
         fprintf(stderr, "Cannot connect to the i3 window manager: %s\n", err->message);
         g_error_free(err);
-        err = NULL;
-        i3_workspaces->i3wm = i3wm_construct(&err);
+
+        i3_workspaces->connect_source = g_timeout_add_seconds(1,
+                connect_to_i3, i3_workspaces);
     }
+
+    return FALSE;
 }
@@ -22,9 +22,33 @@
 #include "i3wm-delegate.h"
 #include "i3w-multi-monitor-utils.h"
 #include "i3w-config.h"
+#include "i3w-labels.h"
+#include "i3w-snapshot.h"
+#include "i3w-startup.h"
+#include "i3w-stats.h"
+#include "i3w-title.h"
+#include "i3w-icons.h"
+#include "i3w-blink.h"
+#include "i3w-probes.h"
 
 G_BEGIN_DECLS
 
+/*
+ * The buttons are updated after the input was handled, but before GTK
+ * resizes (GTK_PRIORITY_RESIZE) and redraws (GDK_PRIORITY_REDRAW), so the
+ * latest state of an event storm is drawn in the next frame.
+ */
+#define I3W_UPDATE_PRIORITY (G_PRIORITY_HIGH_IDLE + 5)
+
+/* a binding mode label, parsed once */
+typedef struct
+{
+    gboolean        pango_markup;
+    gchar           *text;
+    PangoAttrList   *attrs;
+}
+i3WorkspacesModeLabel;
+
 /* plugin structure */
 typedef struct
 {
@@ -33,16 +57,58 @@ typedef struct
     /* panel widgets */
     GtkWidget       *ebox;
     GtkWidget       *hvbox;
+    GtkWidget       *buttons_box;
 
     // hash table of i3workspace * => GtkButton *
     GHashTable      *workspace_buttons;
 
+    // the workspaces without a button, see config->max_buttons
+    GtkWidget       *overflow_button;
+
+    // grouped outputs: output name => left to right position, and
+    // output name => GtkSeparator in front of its group
+    GHashTable      *output_ranks;
+    GHashTable      *output_separators;
+
+    // generation of the workspace model the buttons reflect
+    guint64         generation;
+
+    // changes waiting for the update: i3workspace * => mask of
+    // 1 << i3wmChangeType, applied at I3W_UPDATE_PRIORITY
+    GHashTable      *pending_changes;
+    guint64         pending_generation;
+    gboolean        pending_reorder;
+    gboolean        pending_refilter;
+    guint           update_source;
+
+    // the buttons are only updated while the plugin can be seen; a strip
+    // which had to be filtered meanwhile is outdated until shown again
+    gboolean        mapped;
+    gboolean        obscured;
+    gboolean        outdated;
+
 	// binding mode label
 	GtkWidget       *mode_label;
+    gchar           *mode;
+    gboolean        mode_markup;
+
+    // mode name => i3WorkspacesModeLabel *, rendered in the mode color
+    GHashTable      *mode_labels;
+
+    // title of the focused window, right of the workspace buttons
+    i3WorkspacesTitle *title;
+
+    // size of the window icons on the buttons, follows the panel size
+    gint            icon_size;
 
     i3WorkspacesConfig *config;
 
     i3windowManager *i3wm;
+
+    // pending (re)connection attempt
+    guint           connect_source;
+
+    i3WorkspacesStartup startup;
 }
 i3WorkspacesPlugin;
 
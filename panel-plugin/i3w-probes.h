@@ -0,0 +1,61 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_PROBES_H__
+#define __I3W_PROBES_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/*
+ * Static tracepoints (USDT) at the event, model and render boundaries, in
+ * the provider i3_workspaces. Configure with --enable-sdt-probes to compile
+ * them in; a probe is a single nop until perf or bpftrace attaches to it,
+ * e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/lib/xfce4/panel/plugins/libi3workspaces.so:i3_workspaces:render_end { ... }'
+ *
+ * Probes and their arguments:
+ *
+ *   workspace_event, mode_event, output_event   (const char *change)
+ *   window_event                                (const char *change)
+ *   model_update_start                          ()
+ *   model_update_end                            (unsigned changes)
+ *   render_start, render_end                    (unsigned changes, 0 for a
+ *                                                full reconcile)
+ *   command_send                                (const char *command)
+ *   command_reply                               (const char *reply, NULL on
+ *                                                error)
+ */
+
+#ifdef ENABLE_SDT_PROBES
+
+#include <sys/sdt.h>
+
+#define I3W_PROBE(name) DTRACE_PROBE(i3_workspaces, name)
+#define I3W_PROBE1(name, arg1) DTRACE_PROBE1(i3_workspaces, name, arg1)
+
+#else
+
+#define I3W_PROBE(name)
+#define I3W_PROBE1(name, arg1)
+
+#endif
+
+#endif /* !__I3W_PROBES_H__ */
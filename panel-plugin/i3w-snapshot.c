@@ -0,0 +1,284 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "i3w-snapshot.h"
+
+/*
+ * File layout, all integers little endian:
+ *
+ *   "I3WS" | guint32 version | guint32 count | guint32 len | output
+ *   count times: gint64 id | gint32 num | guint32 flags | guint32 len | name
+ *                | guint32 len | output
+ *
+ * Version 1 had no con id; such a snapshot is ignored.
+ */
+#define SNAPSHOT_MAGIC "I3WS"
+#define SNAPSHOT_VERSION 2
+
+#define SNAPSHOT_FOCUSED (1 << 0)
+#define SNAPSHOT_URGENT  (1 << 1)
+#define SNAPSHOT_VISIBLE (1 << 2)
+
+typedef struct
+{
+    const gchar *data;
+    gsize length;
+    gsize offset;
+} SnapshotReader;
+
+static gchar *
+snapshot_location(XfcePanelPlugin *plugin, gboolean create);
+
+static void
+write_uint32(GByteArray *buffer, guint32 value);
+static void
+write_uint64(GByteArray *buffer, guint64 value);
+static void
+write_string(GByteArray *buffer, const gchar *str);
+static gboolean
+read_uint32(SnapshotReader *reader, guint32 *value);
+static gboolean
+read_uint64(SnapshotReader *reader, guint64 *value);
+static gboolean
+read_string(SnapshotReader *reader, gchar **str);
+
+/* Function Implementations */
+
+/**
+ * i3_workspaces_snapshot_load:
+ * @plugin: the xfce plugin
+ * @output: return location for the output resolved when it was saved
+ *
+ * Load the last saved workspace model.
+ *
+ * Returns: GSList* of i3workspace* in saved order, or NULL if there is no
+ * valid snapshot
+ */
+GSList *
+i3_workspaces_snapshot_load(XfcePanelPlugin *plugin, gchar **output)
+{
+    *output = NULL;
+
+    gchar *file = snapshot_location(plugin, FALSE);
+    if (G_UNLIKELY(!file))
+        return NULL;
+
+    GMappedFile *mapped = g_mapped_file_new(file, FALSE, NULL);
+    g_free(file);
+    if (!mapped)
+        return NULL;
+
+    SnapshotReader reader;
+    reader.data = g_mapped_file_get_contents(mapped);
+    reader.length = g_mapped_file_get_length(mapped);
+    reader.offset = strlen(SNAPSHOT_MAGIC);
+
+    GSList *wlist = NULL;
+    guint32 version, count, i;
+    gboolean valid = reader.length >= reader.offset &&
+        memcmp(reader.data, SNAPSHOT_MAGIC, reader.offset) == 0 &&
+        read_uint32(&reader, &version) && version == SNAPSHOT_VERSION &&
+        read_uint32(&reader, &count) &&
+        read_string(&reader, output);
+
+    for (i = 0; valid && i < count; i++)
+    {
+        guint64 id;
+        guint32 num, flags;
+        i3workspace *workspace = g_new0(i3workspace, 1);
+
+        valid = read_uint64(&reader, &id) &&
+            read_uint32(&reader, &num) &&
+            read_uint32(&reader, &flags) &&
+            read_string(&reader, &workspace->name) &&
+            read_string(&reader, &workspace->output);
+
+        workspace->id = (gint64) id;
+        workspace->num = (gint32) num;
+        workspace->focused = (flags & SNAPSHOT_FOCUSED) != 0;
+        workspace->urgent = (flags & SNAPSHOT_URGENT) != 0;
+        workspace->visible = (flags & SNAPSHOT_VISIBLE) != 0;
+        workspace->windows = -1;
+
+        wlist = g_slist_prepend(wlist, workspace);
+    }
+
+    g_mapped_file_unref(mapped);
+
+    if (!valid)
+    {
+        GSList *witem;
+        for (witem = wlist; witem != NULL; witem = witem->next)
+        {
+            i3workspace *workspace = (i3workspace *) witem->data;
+            g_free(workspace->name);
+            g_free(workspace->output);
+            g_free(workspace);
+        }
+        g_slist_free(wlist);
+        g_free(*output);
+        *output = NULL;
+        return NULL;
+    }
+
+    return g_slist_reverse(wlist);
+}
+
+/**
+ * i3_workspaces_snapshot_save:
+ * @plugin: the xfce plugin
+ * @wlist: GSList* of i3workspace*
+ * @output: the output the plugin is showing, may be NULL
+ *
+ * Atomically replace the snapshot with the given workspace model.
+ *
+ * Returns: TRUE if the snapshot was written
+ */
+gboolean
+i3_workspaces_snapshot_save(XfcePanelPlugin *plugin, GSList *wlist,
+        const gchar *output)
+{
+    gchar *file = snapshot_location(plugin, TRUE);
+    if (G_UNLIKELY(!file))
+        return FALSE;
+
+    GByteArray *buffer = g_byte_array_new();
+    g_byte_array_append(buffer, (const guint8 *) SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC));
+    write_uint32(buffer, SNAPSHOT_VERSION);
+    write_uint32(buffer, g_slist_length(wlist));
+    write_string(buffer, output);
+
+    GSList *witem;
+    for (witem = wlist; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        guint32 flags = 0;
+
+        if (workspace->focused) flags |= SNAPSHOT_FOCUSED;
+        if (workspace->urgent) flags |= SNAPSHOT_URGENT;
+        if (workspace->visible) flags |= SNAPSHOT_VISIBLE;
+
+        write_uint64(buffer, (guint64) workspace->id);
+        write_uint32(buffer, (guint32) workspace->num);
+        write_uint32(buffer, flags);
+        write_string(buffer, workspace->name);
+        write_string(buffer, workspace->output);
+    }
+
+    gboolean saved = g_file_set_contents(file, (const gchar *) buffer->data,
+            buffer->len, NULL);
+
+    g_byte_array_free(buffer, TRUE);
+    g_free(file);
+
+    return saved;
+}
+
+/**
+ * snapshot_location:
+ * @plugin: the xfce plugin
+ * @create: whether the directory should be created
+ *
+ * The snapshot lives next to the plugin's rc file, with a .snapshot suffix.
+ *
+ * Returns: the path of the snapshot file
+ */
+static gchar *
+snapshot_location(XfcePanelPlugin *plugin, gboolean create)
+{
+    gchar *file = xfce_panel_plugin_save_location(plugin, create);
+    if (G_UNLIKELY(!file))
+        return NULL;
+
+    if (g_str_has_suffix(file, ".rc"))
+        file[strlen(file) - 3] = '\0';
+
+    gchar *path = g_strconcat(file, ".snapshot", NULL);
+    g_free(file);
+
+    return path;
+}
+
+static void
+write_uint32(GByteArray *buffer, guint32 value)
+{
+    value = GUINT32_TO_LE(value);
+    g_byte_array_append(buffer, (const guint8 *) &value, sizeof(value));
+}
+
+static void
+write_uint64(GByteArray *buffer, guint64 value)
+{
+    value = GUINT64_TO_LE(value);
+    g_byte_array_append(buffer, (const guint8 *) &value, sizeof(value));
+}
+
+static void
+write_string(GByteArray *buffer, const gchar *str)
+{
+    guint32 len = str ? strlen(str) : 0;
+
+    write_uint32(buffer, len);
+    g_byte_array_append(buffer, (const guint8 *) str, len);
+}
+
+static gboolean
+read_uint32(SnapshotReader *reader, guint32 *value)
+{
+    if (reader->length - reader->offset < sizeof(*value))
+        return FALSE;
+
+    memcpy(value, reader->data + reader->offset, sizeof(*value));
+    *value = GUINT32_FROM_LE(*value);
+    reader->offset += sizeof(*value);
+
+    return TRUE;
+}
+
+static gboolean
+read_uint64(SnapshotReader *reader, guint64 *value)
+{
+    if (reader->length - reader->offset < sizeof(*value))
+        return FALSE;
+
+    memcpy(value, reader->data + reader->offset, sizeof(*value));
+    *value = GUINT64_FROM_LE(*value);
+    reader->offset += sizeof(*value);
+
+    return TRUE;
+}
+
+static gboolean
+read_string(SnapshotReader *reader, gchar **str)
+{
+    guint32 len;
+
+    if (!read_uint32(reader, &len) || reader->length - reader->offset < len)
+        return FALSE;
+
+    *str = g_strndup(reader->data + reader->offset, len);
+    reader->offset += len;
+
+    return TRUE;
+}
@@ -0,0 +1,37 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_SNAPSHOT_H__
+#define __I3W_SNAPSHOT_H__
+
+#include <libxfce4panel/xfce-panel-plugin.h>
+
+#include "i3wm-delegate.h"
+
+/*
+ * The last known workspace model, stored next to the plugin's rc file so the
+ * workspaces can be painted before the window manager answers.
+ */
+
+GSList *
+i3_workspaces_snapshot_load(XfcePanelPlugin *plugin, gchar **output);
+gboolean
+i3_workspaces_snapshot_save(XfcePanelPlugin *plugin, GSList *wlist,
+        const gchar *output);
+
+#endif /* !__I3W_SNAPSHOT_H__ */
@@ -0,0 +1,55 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_STARTUP_H__
+#define __I3W_STARTUP_H__
+
+#include <glib.h>
+
+/*
+ * Where the plugin spends its startup. The plugin keeps the record on the
+ * XfcePanelPlugin object under I3W_STARTUP_KEY, so the startup benchmark
+ * can read it back. Durations are in microseconds, timestamps are
+ * g_get_monotonic_time values.
+ */
+
+#define I3W_STARTUP_KEY "i3w-startup"
+
+typedef struct
+{
+    // entry of construct()
+    gint64 started;
+
+    // the phases of construct()
+    gint64 config_load;
+    gint64 snapshot_load;
+    gint64 widgets;
+    gint64 output_detection;
+    gint64 constructed;
+
+    // the i3 IPC handshake: socket path, connection, first fetch and
+    // subscription, of the last attempt
+    guint  ipc_attempts;
+    gint64 ipc_handshake;
+
+    // when the first handshake succeeded, 0 until then
+    gint64 connected;
+}
+i3WorkspacesStartup;
+
+#endif /* !__I3W_STARTUP_H__ */
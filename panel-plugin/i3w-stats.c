@@ -0,0 +1,259 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+#include "i3w-stats.h"
+
+i3wStats i3w_stats;
+
+// the SIGUSR2 source and the plugin instances which installed it
+static guint signal_source = 0;
+static guint signal_installs = 0;
+
+static const gchar *event_names[I3W_STATS_EVENT_TYPES] =
+{
+    "workspace", "output", "mode", "window",
+    "barconfig_update", "binding", "shutdown", "tick"
+};
+
+static const gchar *message_names[I3W_STATS_MESSAGE_TYPES] =
+{
+    "command", "get_workspaces", "subscribe", "get_outputs",
+    "get_tree", "get_marks", "get_bar_config", "get_version",
+    "get_binding_modes", "get_config", "send_tick", "sync"
+};
+
+static const gchar *handler_names[I3W_STATS_HANDLERS] =
+{
+    "workspace event", "mode event", "output event",
+    "workspaces changed", "reconcile", "output detection",
+    "tick round trip", "window event", "window index"
+};
+
+static void
+dump_histogram(GString *out, const gchar *name, const i3wStatsHistogram *histogram);
+static gboolean
+on_dump_signal(gpointer data);
+
+/**
+ * i3w_stats_record_time:
+ * @handler: the handler
+ * @start: the g_get_monotonic_time when the handler started
+ *
+ * Add the time since start to the histogram of the handler.
+ */
+void
+i3w_stats_record_time(i3wStatsHandler handler, gint64 start)
+{
+    i3wStatsHistogram *histogram = &i3w_stats.handlers[handler];
+    guint64 us = MAX(g_get_monotonic_time() - start, 0);
+    guint bucket = 0;
+
+    while (bucket < I3W_STATS_BUCKETS - 1 && (us >> (bucket + 1)) > 0)
+        bucket++;
+
+    histogram->count++;
+    histogram->total_us += us;
+    histogram->max_us = MAX(histogram->max_us, us);
+    histogram->buckets[bucket]++;
+}
+
+/**
+ * i3w_stats_dump:
+ * @err: the error object
+ *
+ * Write the counters to xfce4-i3-workspaces-plugin-PID.stats in
+ * $XDG_RUNTIME_DIR.
+ *
+ * Returns: the path of the written file, or NULL
+ */
+gchar *
+i3w_stats_dump(GError **err)
+{
+    GString *out = g_string_new(NULL);
+    guint i;
+
+    g_string_append(out, "# events received\n");
+    for (i = 0; i < I3W_STATS_EVENT_TYPES; i++)
+        if (i3w_stats.events[i])
+            g_string_append_printf(out, "event %s %" G_GUINT64_FORMAT "\n",
+                    event_names[i], i3w_stats.events[i]);
+
+    g_string_append(out, "# replies received\n");
+    for (i = 0; i < I3W_STATS_MESSAGE_TYPES; i++)
+        if (i3w_stats.replies[i])
+            g_string_append_printf(out, "reply %s %" G_GUINT64_FORMAT "\n",
+                    message_names[i], i3w_stats.replies[i]);
+
+    g_string_append_printf(out,
+            "bytes_read %" G_GUINT64_FORMAT "\n"
+            "events_dropped %" G_GUINT64_FORMAT "\n"
+            "event_batches %" G_GUINT64_FORMAT "\n"
+            "full_resyncs %" G_GUINT64_FORMAT "\n"
+            "incremental_updates %" G_GUINT64_FORMAT "\n"
+            "buttons_created %" G_GUINT64_FORMAT "\n"
+            "buttons_destroyed %" G_GUINT64_FORMAT "\n"
+            "buttons_restyled %" G_GUINT64_FORMAT "\n"
+            "markup_parses %" G_GUINT64_FORMAT "\n"
+            "xrandr_queries %" G_GUINT64_FORMAT "\n"
+            "reconnect_attempts %" G_GUINT64_FORMAT "\n"
+            "ticks_sent %" G_GUINT64_FORMAT "\n"
+            "ticks_late %" G_GUINT64_FORMAT "\n"
+            "coalesced_syncs %" G_GUINT64_FORMAT "\n"
+            "tick_rtt_us %" G_GINT64_FORMAT "\n"
+            "coalesce_window_ms %u\n"
+            "title_changes %" G_GUINT64_FORMAT "\n"
+            "title_draws %" G_GUINT64_FORMAT "\n"
+            "title_layout_hits %" G_GUINT64_FORMAT "\n"
+            "title_layout_misses %" G_GUINT64_FORMAT "\n"
+            "icon_cache_hits %" G_GUINT64_FORMAT "\n"
+            "icon_cache_misses %" G_GUINT64_FORMAT "\n"
+            "icon_cache_evictions %" G_GUINT64_FORMAT "\n"
+            "tooltip_queries %" G_GUINT64_FORMAT "\n"
+            "window_lists_built %" G_GUINT64_FORMAT "\n"
+            "blink_ticks %" G_GUINT64_FORMAT "\n",
+            i3w_stats.bytes_read,
+            i3w_stats.events_dropped,
+            i3w_stats.event_batches,
+            i3w_stats.full_resyncs,
+            i3w_stats.incremental_updates,
+            i3w_stats.buttons_created,
+            i3w_stats.buttons_destroyed,
+            i3w_stats.buttons_restyled,
+            i3w_stats.markup_parses,
+            i3w_stats.xrandr_queries,
+            i3w_stats.reconnect_attempts,
+            i3w_stats.ticks_sent,
+            i3w_stats.ticks_late,
+            i3w_stats.coalesced_syncs,
+            i3w_stats.tick_rtt_us,
+            i3w_stats.coalesce_window_ms,
+            i3w_stats.title_changes,
+            i3w_stats.title_draws,
+            i3w_stats.title_layout_hits,
+            i3w_stats.title_layout_misses,
+            i3w_stats.icon_cache_hits,
+            i3w_stats.icon_cache_misses,
+            i3w_stats.icon_cache_evictions,
+            i3w_stats.tooltip_queries,
+            i3w_stats.window_lists_built,
+            i3w_stats.blink_ticks);
+
+    g_string_append(out, "# handler times in microseconds\n");
+    for (i = 0; i < I3W_STATS_HANDLERS; i++)
+        dump_histogram(out, handler_names[i], &i3w_stats.handlers[i]);
+
+    gchar *name = g_strdup_printf("xfce4-i3-workspaces-plugin-%d.stats", (int) getpid());
+    gchar *path = g_build_filename(g_get_user_runtime_dir(), name, NULL);
+    g_free(name);
+
+    if (!g_file_set_contents(path, out->str, out->len, err))
+    {
+        g_free(path);
+        path = NULL;
+    }
+
+    g_string_free(out, TRUE);
+
+    return path;
+}
+
+/**
+ * i3w_stats_install_signal_handler:
+ *
+ * Dump the counters whenever the process receives SIGUSR2. The handler is
+ * shared by the plugin instances of the process; every install must be
+ * paired with an i3w_stats_remove_signal_handler.
+ */
+void
+i3w_stats_install_signal_handler(void)
+{
+    if (signal_installs++ == 0)
+        signal_source = g_unix_signal_add(SIGUSR2, on_dump_signal, NULL);
+}
+
+/**
+ * i3w_stats_remove_signal_handler:
+ *
+ * Remove the SIGUSR2 handler with the last plugin instance, before the
+ * module may be unloaded.
+ */
+void
+i3w_stats_remove_signal_handler(void)
+{
+    g_return_if_fail(signal_installs > 0);
+
+    if (--signal_installs == 0)
+    {
+        g_source_remove(signal_source);
+        signal_source = 0;
+    }
+}
+
+/*
+ * One line per handler with the count, mean and max, followed by the
+ * non-empty buckets as upper bound:count.
+ */
+static void
+dump_histogram(GString *out, const gchar *name, const i3wStatsHistogram *histogram)
+{
+    guint i;
+
+    if (histogram->count == 0)
+        return;
+
+    g_string_append_printf(out, "time %s count=%" G_GUINT64_FORMAT
+            " mean=%.1f max=%" G_GUINT64_FORMAT,
+            name, histogram->count,
+            (gdouble) histogram->total_us / histogram->count, histogram->max_us);
+
+    for (i = 0; i < I3W_STATS_BUCKETS; i++)
+    {
+        if (histogram->buckets[i] == 0)
+            continue;
+        if (i == I3W_STATS_BUCKETS - 1)
+            g_string_append_printf(out, " inf:%" G_GUINT64_FORMAT, histogram->buckets[i]);
+        else
+            g_string_append_printf(out, " <%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT,
+                    (guint64) 1 << (i + 1), histogram->buckets[i]);
+    }
+
+    g_string_append_c(out, '\n');
+}
+
+static gboolean
+on_dump_signal(gpointer data)
+{
+    GError *err = NULL;
+    gchar *path = i3w_stats_dump(&err);
+
+    if (path)
+        g_printerr("Statistics written to %s\n", path);
+    else
+    {
+        g_printerr("Cannot write the statistics: %s\n", err->message);
+        g_error_free(err);
+    }
+    g_free(path);
+
+    return TRUE;
+}
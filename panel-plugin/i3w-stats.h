@@ -0,0 +1,124 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_STATS_H__
+#define __I3W_STATS_H__
+
+#include <glib.h>
+
+/*
+ * Performance counters of the delegate and the plugin, cheap enough to be
+ * always on. They are shared by all plugin instances of the process and
+ * dumped as text on SIGUSR2 or from the configuration dialog, so a sluggish
+ * panel can be diagnosed without a profiler.
+ */
+
+#define I3W_STATS_EVENT_TYPES 8
+#define I3W_STATS_MESSAGE_TYPES 12
+
+/* log2 buckets of microseconds, the last one collects everything longer */
+#define I3W_STATS_BUCKETS 24
+
+typedef enum
+{
+    I3W_STATS_WORKSPACE_EVENT,
+    I3W_STATS_MODE_EVENT,
+    I3W_STATS_OUTPUT_EVENT,
+    I3W_STATS_WORKSPACES_CHANGED,
+    I3W_STATS_RECONCILE,
+    I3W_STATS_OUTPUT_DETECTION,
+    I3W_STATS_TICK_ROUND_TRIP,
+    I3W_STATS_WINDOW_EVENT,
+    I3W_STATS_WINDOW_INDEX,
+    I3W_STATS_HANDLERS
+} i3wStatsHandler;
+
+typedef struct
+{
+    guint64 count;
+    guint64 total_us;
+    guint64 max_us;
+    guint64 buckets[I3W_STATS_BUCKETS];
+}
+i3wStatsHistogram;
+
+typedef struct
+{
+    // IPC traffic
+    guint64 events[I3W_STATS_EVENT_TYPES];
+    guint64 replies[I3W_STATS_MESSAGE_TYPES];
+    guint64 bytes_read;
+    guint64 events_dropped; // of a type no feature reads any more
+    guint64 event_batches; // socket wakeups which read events
+
+    // workspace model and buttons
+    guint64 full_resyncs;
+    guint64 incremental_updates;
+    guint64 buttons_created;
+    guint64 buttons_destroyed;
+    guint64 buttons_restyled;
+    guint64 markup_parses;
+
+    guint64 xrandr_queries;
+    guint64 reconnect_attempts;
+
+    // IPC round trip probe, the latest smoothed round trip and the
+    // coalescing window derived from it
+    guint64 ticks_sent;
+    guint64 ticks_late;
+    guint64 coalesced_syncs;
+    gint64 tick_rtt_us;
+    guint coalesce_window_ms;
+
+    // focused window title: reported changes, redraws and layout cache
+    guint64 title_changes;
+    guint64 title_draws;
+    guint64 title_layout_hits;
+    guint64 title_layout_misses;
+
+    // window icons: lookups served by the shared cache, lookups which had to
+    // load and scale an icon, and icons dropped to stay within the bound
+    guint64 icon_cache_hits;
+    guint64 icon_cache_misses;
+    guint64 icon_cache_evictions;
+
+    // window list tooltips: queries and title lists built for them
+    guint64 tooltip_queries;
+    guint64 window_lists_built;
+
+    // urgent workspace blinking: phase changes of the shared timer
+    guint64 blink_ticks;
+
+    i3wStatsHistogram handlers[I3W_STATS_HANDLERS];
+}
+i3wStats;
+
+extern i3wStats i3w_stats;
+
+void
+i3w_stats_record_time(i3wStatsHandler handler, gint64 start);
+
+gchar *
+i3w_stats_dump(GError **err);
+
+void
+i3w_stats_install_signal_handler(void);
+void
+i3w_stats_remove_signal_handler(void);
+
+#endif /* !__I3W_STATS_H__ */
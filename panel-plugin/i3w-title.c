@@ -0,0 +1,293 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "i3w-title.h"
+#include "i3w-stats.h"
+
+struct _i3WorkspacesTitle
+{
+    GtkWidget *area;
+
+    gchar *text;
+    guint draw_source;
+    gint64 last_draw;
+
+    // title => PangoLayout, and the titles from the least recently drawn
+    GHashTable *layouts;
+    GQueue *lru;
+    gint layout_width;
+};
+
+static PangoLayout *
+get_layout(i3WorkspacesTitle *title, const gchar *text);
+static void
+clear_layouts(i3WorkspacesTitle *title);
+static void
+queue_draw(i3WorkspacesTitle *title);
+static gboolean
+on_draw_timeout(gpointer data);
+
+static gboolean
+on_title_expose(GtkWidget *area, GdkEventExpose *event, gpointer data);
+static void
+on_title_style_set(GtkWidget *area, GtkStyle *previous, gpointer data);
+static void
+on_title_size_allocate(GtkWidget *area, GtkAllocation *allocation, gpointer data);
+
+/* Function Implementations */
+
+/**
+ * i3_workspaces_title_new:
+ *
+ * Create the title, initially empty and hidden.
+ *
+ * Returns: the title, to be freed with i3_workspaces_title_free
+ */
+i3WorkspacesTitle *
+i3_workspaces_title_new(void)
+{
+    i3WorkspacesTitle *title = g_new0(i3WorkspacesTitle, 1);
+
+    title->area = gtk_drawing_area_new();
+    g_object_ref_sink(title->area);
+    gtk_widget_set_no_show_all(title->area, TRUE);
+
+    title->layouts = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, g_object_unref);
+    title->lru = g_queue_new();
+
+    g_signal_connect(G_OBJECT(title->area), "expose-event",
+            G_CALLBACK(on_title_expose), title);
+    g_signal_connect(G_OBJECT(title->area), "style-set",
+            G_CALLBACK(on_title_style_set), title);
+    g_signal_connect(G_OBJECT(title->area), "size-allocate",
+            G_CALLBACK(on_title_size_allocate), title);
+
+    return title;
+}
+
+/**
+ * i3_workspaces_title_free:
+ * @title: the title
+ *
+ * Free the title. The widget may have been destroyed already.
+ */
+void
+i3_workspaces_title_free(i3WorkspacesTitle *title)
+{
+    if (title->draw_source)
+        g_source_remove(title->draw_source);
+
+    g_signal_handlers_disconnect_matched(title->area, G_SIGNAL_MATCH_DATA,
+            0, 0, NULL, NULL, title);
+    g_object_unref(title->area);
+
+    clear_layouts(title);
+    g_hash_table_destroy(title->layouts);
+    g_queue_free(title->lru);
+
+    g_free(title->text);
+    g_free(title);
+}
+
+/**
+ * i3_workspaces_title_get_widget:
+ * @title: the title
+ *
+ * Returns: the widget showing the title
+ */
+GtkWidget *
+i3_workspaces_title_get_widget(i3WorkspacesTitle *title)
+{
+    return title->area;
+}
+
+/**
+ * i3_workspaces_title_set:
+ * @title: the title
+ * @text: the new title or NULL
+ *
+ * Show a new title. It is drawn right away if the last one was drawn at
+ * least a frame ago, else at the next frame; titles set meanwhile are never
+ * drawn.
+ */
+void
+i3_workspaces_title_set(i3WorkspacesTitle *title, const gchar *text)
+{
+    if (g_strcmp0(title->text, text) == 0)
+        return;
+
+    g_free(title->text);
+    title->text = g_strdup(text);
+
+    if (title->draw_source)
+        return;
+
+    gint64 wait = title->last_draw + G_USEC_PER_SEC / I3W_TITLE_FRAME_RATE -
+        g_get_monotonic_time();
+    if (wait <= 0)
+        queue_draw(title);
+    else
+        title->draw_source = g_timeout_add(wait / 1000 + 1, on_draw_timeout, title);
+}
+
+/**
+ * get_layout:
+ * @title: the title
+ * @text: the text
+ *
+ * Look up the layout of the text, creating it if it is not cached, and
+ * make it the most recently used one.
+ *
+ * Returns: the layout, owned by the cache
+ */
+static PangoLayout *
+get_layout(i3WorkspacesTitle *title, const gchar *text)
+{
+    gpointer key, layout;
+
+    if (g_hash_table_lookup_extended(title->layouts, text, &key, &layout))
+    {
+        g_queue_remove(title->lru, key);
+        g_queue_push_tail(title->lru, key);
+        i3w_stats.title_layout_hits++;
+        return PANGO_LAYOUT(layout);
+    }
+
+    layout = gtk_widget_create_pango_layout(title->area, text);
+    pango_layout_set_width(PANGO_LAYOUT(layout), title->layout_width * PANGO_SCALE);
+    pango_layout_set_ellipsize(PANGO_LAYOUT(layout), PANGO_ELLIPSIZE_END);
+    pango_layout_set_single_paragraph_mode(PANGO_LAYOUT(layout), TRUE);
+
+    key = g_strdup(text);
+    g_hash_table_insert(title->layouts, key, layout);
+    g_queue_push_tail(title->lru, key);
+    i3w_stats.title_layout_misses++;
+
+    while (g_queue_get_length(title->lru) > I3W_TITLE_CACHE_SIZE)
+        g_hash_table_remove(title->layouts, g_queue_pop_head(title->lru));
+
+    return PANGO_LAYOUT(layout);
+}
+
+/**
+ * clear_layouts:
+ * @title: the title
+ *
+ * Drop the cached layouts, e.g. because the font or the width changed.
+ */
+static void
+clear_layouts(i3WorkspacesTitle *title)
+{
+    g_queue_clear(title->lru);
+    g_hash_table_remove_all(title->layouts);
+}
+
+static void
+queue_draw(i3WorkspacesTitle *title)
+{
+    title->last_draw = g_get_monotonic_time();
+    gtk_widget_queue_draw(title->area);
+}
+
+static gboolean
+on_draw_timeout(gpointer data)
+{
+    i3WorkspacesTitle *title = (i3WorkspacesTitle *) data;
+
+    title->draw_source = 0;
+    queue_draw(title);
+
+    return FALSE;
+}
+
+/**
+ * on_title_expose:
+ * @area: the drawing area
+ * @event: the event data
+ * @data: the title
+ *
+ * Draw the title, vertically centered, in the theme's label color.
+ *
+ * Returns: FALSE to propagate the event
+ */
+static gboolean
+on_title_expose(GtkWidget *area, GdkEventExpose *event, gpointer data)
+{
+    i3WorkspacesTitle *title = (i3WorkspacesTitle *) data;
+    gint width, height;
+
+    if (title->text == NULL || title->text[0] == '\0')
+        return FALSE;
+
+    GtkAllocation allocation;
+    gtk_widget_get_allocation(area, &allocation);
+
+    PangoLayout *layout = get_layout(title, title->text);
+    pango_layout_get_pixel_size(layout, &width, &height);
+
+    gtk_paint_layout(gtk_widget_get_style(area), gtk_widget_get_window(area),
+            gtk_widget_get_state(area), TRUE, &event->area, area, "label",
+            0, (allocation.height - height) / 2, layout);
+    i3w_stats.title_draws++;
+
+    return FALSE;
+}
+
+/**
+ * on_title_style_set:
+ * @area: the drawing area
+ * @previous: the previous style
+ * @data: the title
+ *
+ * Size the title for I3W_TITLE_WIDTH_CHARS characters of the new font.
+ */
+static void
+on_title_style_set(GtkWidget *area, GtkStyle *previous, gpointer data)
+{
+    i3WorkspacesTitle *title = (i3WorkspacesTitle *) data;
+
+    PangoFontMetrics *metrics = pango_context_get_metrics(
+            gtk_widget_get_pango_context(area),
+            gtk_widget_get_style(area)->font_desc, NULL);
+
+    gtk_widget_set_size_request(area,
+            PANGO_PIXELS(pango_font_metrics_get_approximate_char_width(metrics) *
+                I3W_TITLE_WIDTH_CHARS),
+            PANGO_PIXELS(pango_font_metrics_get_ascent(metrics) +
+                pango_font_metrics_get_descent(metrics)));
+    pango_font_metrics_unref(metrics);
+
+    clear_layouts(title);
+}
+
+static void
+on_title_size_allocate(GtkWidget *area, GtkAllocation *allocation, gpointer data)
+{
+    i3WorkspacesTitle *title = (i3WorkspacesTitle *) data;
+
+    if (title->layout_width != allocation->width)
+    {
+        title->layout_width = allocation->width;
+        clear_layouts(title);
+    }
+}
@@ -0,0 +1,51 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_TITLE_H__
+#define __I3W_TITLE_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * The title of the focused window. It has a fixed size, so a new title only
+ * redraws the widget and never relayouts the panel; titles are drawn at most
+ * once per frame and the layouts of recent titles are kept.
+ */
+
+/* how many characters wide the title is */
+#define I3W_TITLE_WIDTH_CHARS 40
+
+/* the most titles drawn per second */
+#define I3W_TITLE_FRAME_RATE 60
+
+/* how many layouts of recent titles are kept */
+#define I3W_TITLE_CACHE_SIZE 16
+
+typedef struct _i3WorkspacesTitle i3WorkspacesTitle;
+
+i3WorkspacesTitle *
+i3_workspaces_title_new(void);
+void
+i3_workspaces_title_free(i3WorkspacesTitle *title);
+
+GtkWidget *
+i3_workspaces_title_get_widget(i3WorkspacesTitle *title);
+void
+i3_workspaces_title_set(i3WorkspacesTitle *title, const gchar *text);
+
+#endif /* !__I3W_TITLE_H__ */
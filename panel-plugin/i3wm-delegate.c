@@ -18,10 +18,29 @@
 
 #include <glib/gprintf.h>
 #include <i3ipc-glib/i3ipc-glib.h>
+#include <json-glib/json-glib.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "i3wm-delegate.h"
+#include "i3w-stats.h"
+#include "i3w-probes.h"
+
+#define TICK_PAYLOAD_PREFIX "i3w-rtt:"
+
+/* i3 counts as busy above and as recovered below these round trips */
+#define BUSY_RTT_US (20 * 1000)
+#define IDLE_RTT_US (10 * 1000)
+#define MAX_COALESCE_MS 1000
+
+/* an entry of the window index */
+typedef struct
+{
+    gint64 id;
+    gint64 workspace;
+    gchar *class; // WM_CLASS class, NULL if the window has none
+    gchar *title;
+} i3wmWindow;
 
 /*
  * Prototypes
@@ -34,52 +53,134 @@ ws_name_to_number(const char *name);
 static gint
 workspace_name_cmp(const gchar *a, const gchar *b);
 static gint
-workspace_reply_cmp(const i3ipcWorkspaceReply *a, const i3ipcWorkspaceReply *b);
-static gint
-workspace_reply_str_cmp(const i3ipcWorkspaceReply *w, const gchar *s);
-static gint
 workspace_str_cmp(const i3workspace *w, const gchar *s);
 
+static GSList *
+parse_workspaces(const gchar *json, gsize length, GError **err);
+static void
+sync_workspaces(i3windowManager *i3wm, gboolean renames, GError **err);
+static void
+subscribe_to_events(i3windowManager *i3wm, const gchar *socket_path, GError **err);
+static guint
+get_wanted_events(i3windowManager *i3wm);
+static gchar *
+format_events(guint events);
+static void
+update_subscriptions(i3windowManager *i3wm);
+static void
+request_sync(i3windowManager *i3wm, gboolean renames);
+static void
+run_pending_sync(i3windowManager *i3wm);
+static gboolean
+on_sync_timeout(gpointer i3w);
+
+static i3wmChange *
+append_change(GArray *changes, i3wmChangeType type, i3workspace *workspace);
 static void
-init_workspaces(i3windowManager *i3wm, GError **err);
+update_workspace(i3workspace *workspace, i3workspace *current, GArray *changes);
+static i3workspace *
+take_renamed_workspace(GHashTable *stale, GSList *wlist, i3workspace *current);
 static void
-subscribe_to_events(i3windowManager *i3w, GError **err);
+notify_changes(i3windowManager *i3wm, GArray *changes);
 
+/*
+ * Event dispatcher
+ */
 static void
-invoke_callback(const i3wmCallback callback);
+on_ipc_event(guint32 type, const gchar *payload, gsize length, gpointer i3w);
+static void
+on_ipc_batch(guint events, gpointer i3w);
 
 /*
- * Workspace event handlers
+ * Workspace event handler
  */
 static void
-on_workspace_event(i3ipcConnection *conn, i3ipcWorkspaceEvent *e, gpointer i3w);
+on_workspace_event(i3windowManager *i3wm, const gchar *change);
+
+/*
+ * Mode event handler
+ */
 static void
-on_focus_workspace(i3windowManager *i3w, i3ipcCon *current, i3ipcCon *old);
+on_mode_event(i3windowManager *i3wm, const gchar *change, JsonObject *event);
+
+/*
+ * Output event handler
+ */
 static void
-on_init_workspace(i3windowManager *i3w);
+on_output_event(i3windowManager *i3wm, const gchar *change);
+
+/*
+ * IPC round trip probe
+ */
 static void
-on_empty_workspace(i3windowManager *i3w);
+on_tick_event(i3windowManager *i3wm, JsonObject *event);
 static void
-on_urgent_workspace(i3windowManager *i3w);
+start_tick_probe(i3windowManager *i3wm);
 static void
-on_rename_workspace(i3windowManager *i3w);
+stop_tick_probe(i3windowManager *i3wm);
+static gboolean
+send_tick(gpointer i3w);
 static void
-on_move_workspace(i3windowManager *i3w);
+update_rtt(i3windowManager *i3wm, gint64 sample);
 
 /*
- * Mode event handler
+ * Window index
  */
 static void
-on_mode_event(i3ipcConnection *conn, i3ipcGenericEvent *e, gpointer i3w);
+on_window_event(i3windowManager *i3wm, const gchar *change, JsonObject *event);
+static void
+start_window_tracking(i3windowManager *i3wm);
+static void
+fetch_tree(i3windowManager *i3wm, GError **err);
+static void
+index_windows(i3windowManager *i3wm, JsonObject *node, gint64 workspace);
+static JsonObject *
+find_focused_window(JsonObject *node);
+static void
+schedule_index_rebuild(i3windowManager *i3wm);
+static gboolean
+on_index_rebuild(gpointer i3w);
+static const gchar *
+get_window_class(JsonObject *container);
+static void
+add_window(i3windowManager *i3wm, JsonObject *container, gint64 workspace);
+static gboolean
+remove_window(i3windowManager *i3wm, gint64 id);
+static void
+retitle_window(i3windowManager *i3wm, gint64 id, const gchar *title);
+static void
+free_window(i3wmWindow *window);
+static gint
+get_window_count(i3windowManager *i3wm, gint64 workspace);
+static gchar **
+get_window_classes(i3windowManager *i3wm, gint64 workspace);
+static gint
+class_cmp(gconstpointer a, gconstpointer b);
+static gboolean
+classes_equal(gchar **a, gchar **b);
+static gint
+window_id_cmp(gconstpointer a, gconstpointer b);
+static void
+update_window_counts(i3windowManager *i3wm);
+static void
+request_window_counts(i3windowManager *i3wm);
+static void
+append_window_changes(i3windowManager *i3wm, GArray *changes);
 
 /*
- * Output event handler
+ * Focused window title
  */
 static void
-on_output_event(i3ipcConnection *conn, i3ipcGenericEvent *e, gpointer i3w);
+update_title(i3windowManager *i3wm, const gchar *change, JsonObject *container);
+static void
+clear_title_if_empty(i3windowManager *i3wm, const gchar *change, JsonObject *event);
+static void
+set_title(i3windowManager *i3wm, gint64 window, const gchar *title);
 
 static void
-on_ipc_shutdown_proxy(i3ipcConnection *connection, gpointer i3w);
+disconnect(i3windowManager *i3wm);
+static void
+on_ipc_closed(gpointer i3w);
 
 /*
  * Implementations of public functions
@@ -89,50 +190,148 @@ on_ipc_shutdown_proxy(i3ipcConnection *connection, gpointer i3w);
  * i3wm_construct:
  * @err: The error object
  *
- * Construct the i3 windowmanager delegate struct.
+ * Construct the i3 windowmanager delegate struct and connect it.
  */
 i3windowManager *
 i3wm_construct(GError **err)
 {
-    i3windowManager *i3wm = g_new0(i3windowManager, 1);
+    i3windowManager *i3wm = i3wm_new();
     GError *tmp_err = NULL;
 
-    i3wm->connection = i3ipc_connection_new(NULL, &tmp_err);
-    if (tmp_err != NULL)
+    if (!i3wm_connect(i3wm, &tmp_err))
     {
         g_propagate_error(err, tmp_err);
-        g_free(i3wm);
+        i3wm_destruct(i3wm);
         return NULL;
     }
 
-    g_signal_connect(i3wm->connection, "ipc-shutdown", G_CALLBACK(on_ipc_shutdown_proxy), i3wm);
+    return i3wm;
+}
+
+/**
+ * i3wm_new:
+ *
+ * Create a disconnected i3 windowmanager delegate struct with an empty
+ * workspace model.
+ */
+i3windowManager *
+i3wm_new(void)
+{
+    i3windowManager *i3wm = g_new0(i3windowManager, 1);
 
+    i3wm->connection = NULL;
+    i3wm->events = NULL;
+    i3wm->trace = NULL;
     i3wm->wlist = NULL;
+    i3wm->generation = 0;
 
-    i3wm->on_workspace_created.function = NULL;
-    i3wm->on_workspace_destroyed.function = NULL;
-    i3wm->on_workspace_blurred.function = NULL;
-    i3wm->on_workspace_focused.function = NULL;
-    i3wm->on_workspace_urgent.function = NULL;
+    i3wm->on_workspaces_changed.function = NULL;
     i3wm->on_ipc_shutdown = NULL;
 
-    init_workspaces(i3wm, &tmp_err);
-    if(tmp_err != NULL)
+    // the mode events are read once there is a callback for them
+    i3wm->track_mode = TRUE;
+
+    i3wm->window_index = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, (GDestroyNotify) free_window);
+    i3wm->window_counts = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            g_free, NULL);
+    i3wm->window_classes = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            g_free, (GDestroyNotify) g_hash_table_destroy);
+    i3wm->window_titles = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            g_free, (GDestroyNotify) g_strfreev);
+
+    return i3wm;
+}
+
+/**
+ * i3wm_seed_workspaces:
+ * @i3wm: the window manager delegate struct
+ * @wlist: GSList* of i3workspace*, sorted
+ *
+ * Replace the workspace model of a disconnected delegate, e.g. with the last
+ * known workspaces. The delegate takes ownership of the list. Once connected,
+ * the live state is reported as changes relative to this model.
+ */
+void
+i3wm_seed_workspaces(i3windowManager *i3wm, GSList *wlist)
+{
+    g_return_if_fail(i3wm->connection == NULL);
+
+    g_slist_free_full(i3wm->wlist, (GDestroyNotify) destroy_workspace);
+    i3wm->wlist = wlist;
+    i3wm->generation++;
+}
+
+/**
+ * i3wm_connect:
+ * @i3wm: the window manager delegate struct
+ * @err: The error object
+ *
+ * Connect to the window manager, fetch the workspaces and subscribe to the
+ * events. The differences to the current model are passed to the workspaces
+ * changed callback.
+ *
+ * If windows or the title are tracked, the tree is fetched as well.
+ *
+ * If the I3_WORKSPACES_TRACE environment variable names a file, the received
+ * messages are recorded there for the replay tool.
+ *
+ * Returns: TRUE if connected
+ */
+gboolean
+i3wm_connect(i3windowManager *i3wm, GError **err)
+{
+    GError *tmp_err = NULL;
+
+    if (i3wm->connection)
+        return TRUE;
+
+    const gchar *trace_file = g_getenv("I3_WORKSPACES_TRACE");
+    if (trace_file && i3wm->trace == NULL)
     {
-        g_propagate_error(err, tmp_err);
-        i3wm_destruct(i3wm);
-        return NULL;
+        i3wm->trace = i3wm_trace_new(trace_file, &tmp_err);
+        if (tmp_err != NULL)
+        {
+            g_printerr("Cannot record a trace: %s\n", tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
     }
 
-    subscribe_to_events(i3wm, &tmp_err);
+    // I3SOCK points to another server, like i3 itself honors it
+    gchar *socket_path = i3wm_ipc_get_socket_path(i3wm->display, &tmp_err);
+    if (tmp_err == NULL)
+        i3wm->connection = i3ipc_connection_new(socket_path, &tmp_err);
+
+    if (tmp_err == NULL)
+        sync_workspaces(i3wm, FALSE, &tmp_err);
+    if (tmp_err == NULL)
+        subscribe_to_events(i3wm, socket_path, &tmp_err);
+
+    g_free(socket_path);
+
     if (tmp_err != NULL)
     {
         g_propagate_error(err, tmp_err);
-        i3wm_destruct(i3wm);
-        return NULL;
+        disconnect(i3wm);
+        return FALSE;
     }
 
-    return i3wm;
+    start_tick_probe(i3wm);
+    start_window_tracking(i3wm);
+
+    return TRUE;
+}
+
+/**
+ * i3wm_is_connected:
+ * @i3wm: the window manager delegate struct
+ *
+ * Returns: whether the delegate is connected to the window manager
+ */
+gboolean
+i3wm_is_connected(i3windowManager *i3wm)
+{
+    return i3wm->connection != NULL;
 }
 
 /**
@@ -143,9 +342,16 @@ i3wm_construct(GError **err)
 void
 i3wm_destruct(i3windowManager *i3wm)
 {
-    g_object_unref(i3wm->connection);
+    disconnect(i3wm);
+
+    if (i3wm->trace)
+        i3wm_trace_free(i3wm->trace);
 
     g_slist_free_full(i3wm->wlist, (GDestroyNotify) destroy_workspace);
+    g_hash_table_destroy(i3wm->window_index);
+    g_hash_table_destroy(i3wm->window_counts);
+    g_hash_table_destroy(i3wm->window_classes);
+    g_hash_table_destroy(i3wm->window_titles);
 
     g_free(i3wm);
 }
@@ -163,6 +369,21 @@ i3wm_get_workspaces(i3windowManager *i3wm)
     return i3wm->wlist;
 }
 
+/**
+ * i3wm_get_generation:
+ * @i3wm: the window manager delegate struct
+ *
+ * The generation is incremented every time the workspace model changes, so
+ * consumers can tell whether their view is up to date.
+ *
+ * Returns: guint64
+ */
+guint64
+i3wm_get_generation(i3windowManager *i3wm)
+{
+    return i3wm->generation;
+}
+
 /*
  * i3wm_workspace_cmp:
  * @a - i3workspace *
@@ -178,201 +399,294 @@ i3wm_workspace_cmp(const i3workspace *a, const i3workspace *b)
 }
 
 /**
- * i3wm_set_on_workspace_created:
+ * i3wm_set_on_workspaces_changed:
  * @i3wm: the window manager delegate struct
  * @callback: the callback
  * @data: the data to be passed to the callback function
  *
- * Set the workspace created callback.
+ * Set the workspaces changed callback. It receives the array of i3wmChange
+ * records describing the difference to the previous model.
  */
 void
-i3wm_set_on_workspace_created(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data)
+i3wm_set_on_workspaces_changed(i3windowManager *i3wm, i3wmWorkspacesCallback_fun callback, gpointer data)
 {
-    i3wm->on_workspace_created.function = callback;
-    i3wm->on_workspace_created.data = data;
+    i3wm->on_workspaces_changed.function = callback;
+    i3wm->on_workspaces_changed.data = data;
 }
 
 /**
- * i3wm_set_on_workspace_destroyed:
+ * i3wm_set_on_mode_changed:
  * @i3wm: the window manager delegate struct
  * @callback: the callback
  * @data: the data to be passed to the callback function
  *
- * Set the workspace destroyed callback.
+ * Set the binding mode changed callback.
  */
 void
-i3wm_set_on_workspace_destroyed(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data)
+i3wm_set_on_mode_changed(i3windowManager *i3wm, i3wmModeCallback_fun callback, gpointer data)
 {
-    i3wm->on_workspace_destroyed.function = callback;
-    i3wm->on_workspace_destroyed.data = data;
+    i3wm->on_mode_changed.function = callback;
+    i3wm->on_mode_changed.data = data;
+
+    update_subscriptions(i3wm);
 }
 
 /**
- * i3wm_set_on_workspace_blurred:
+ * i3wm_set_on_output_changed
  * @i3wm: the window manager delegate struct
  * @callback: the callback
  * @data: the data to be passed to the callback function
  *
- * Set the workspace blurred callback.
+ * Set the binding output changed callback.
  */
 void
-i3wm_set_on_workspace_blurred(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data)
+i3wm_set_on_output_changed(i3windowManager *i3wm, i3wmOutputCallback_fun callback, gpointer data)
 {
-    i3wm->on_workspace_blurred.function = callback;
-    i3wm->on_workspace_focused.data = data;
+    i3wm->on_output_changed.function = callback;
+    i3wm->on_output_changed.data = data;
 }
 
 /**
- * i3wm_set_on_workspace_focused:
+ * i3wm_set_on_title_changed:
  * @i3wm: the window manager delegate struct
  * @callback: the callback
  * @data: the data to be passed to the callback function
  *
- * Set the workspace focused callback.
+ * Set the callback receiving the title of the focused window, NULL if no
+ * window is focused.
  */
 void
-i3wm_set_on_workspace_focused(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data)
+i3wm_set_on_title_changed(i3windowManager *i3wm, i3wmTitleCallback_fun callback, gpointer data)
 {
-    i3wm->on_workspace_focused.function = callback;
-    i3wm->on_workspace_blurred.data = data;
+    i3wm->on_title_changed.function = callback;
+    i3wm->on_title_changed.data = data;
 }
 
 /**
- * i3wm_set_on_workspace_urgent:
+ * i3wm_set_ipc_shutdown:
  * @i3wm: the window manager delegate struct
  * @callback: the callback
  * @data: the data to be passed to the callback function
  *
- * Set the workspace urgent callback.
+ * Set the ipc shutdown event callback.
  */
 void
-i3wm_set_on_workspace_urgent(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data)
+i3wm_set_on_ipc_shutdown(i3windowManager *i3wm,
+        i3wmIpcShutdownCallback callback, gpointer data)
 {
-    i3wm->on_workspace_urgent.function = callback;
-    i3wm->on_workspace_urgent.data = data;
+    i3wm->on_ipc_shutdown = callback;
+    i3wm->on_ipc_shutdown_data = data;
 }
 
 /**
- * i3wm_set_on_workspace_renamed:
+ * i3wm_set_display:
  * @i3wm: the window manager delegate struct
- * @callback: the callback
- * @data: the data to be passed to the callback function
+ * @display: the X display, owned by the caller
  *
- * Set the workspace renamed callback.
+ * Find the socket of i3 on the display when connecting, unless I3SOCK is
+ * set. Without a display, only I3SOCK is honored.
  */
 void
-i3wm_set_on_workspace_renamed(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data)
+i3wm_set_display(i3windowManager *i3wm, Display *display)
 {
-    i3wm->on_workspace_renamed.function = callback;
-    i3wm->on_workspace_renamed.data = data;
+    i3wm->display = display;
 }
 
 /**
- * i3wm_set_on_mode_changed:
+ * i3wm_goto_workspace:
  * @i3wm: the window manager delegate struct
- * @callback: the callback
- * @data: the data to be passed to the callback function
+ * @workspace: the workspace to jump to
  *
- * Set the binding mode changed callback.
+ * Instruct the window manager to jump to the specified workspace.
  */
 void
-i3wm_set_on_mode_changed(i3windowManager *i3wm, i3wmModeCallback_fun callback, gpointer data)
+i3wm_goto_workspace(i3windowManager *i3wm, i3workspace *workspace, GError **err)
 {
-    i3wm->on_mode_changed.function = callback;
-    i3wm->on_mode_changed.data = data;
+    if (i3wm->connection == NULL)
+        return;
+
+    gchar *command_str = g_strdup_printf("workspace %s", workspace->name);
+
+    GError *ipc_err = NULL;
+
+    I3W_PROBE1(command_send, command_str);
+
+    gchar *reply = i3ipc_connection_message(
+            i3wm->connection,
+            I3IPC_MESSAGE_TYPE_COMMAND,
+            command_str,
+            &ipc_err);
+    g_free(command_str);
+
+    I3W_PROBE1(command_reply, reply);
+
+    if (ipc_err != NULL)
+    {
+        g_propagate_error(err, ipc_err);
+    }
+    else
+    {
+        i3w_stats.replies[I3IPC_MESSAGE_TYPE_COMMAND]++;
+        i3w_stats.bytes_read += I3WM_IPC_HEADER_SIZE + strlen(reply);
+        g_free(reply);
+    }
 }
 
 /**
- * i3wm_set_on_output_changed
+ * i3wm_set_tick_probe:
  * @i3wm: the window manager delegate struct
- * @callback: the callback
- * @data: the data to be passed to the callback function
+ * @interval_ms: the probe interval, 0 to stop probing
  *
- * Set the binding output changed callback.
+ * Periodically send a tick and measure the time until its event arrives,
+ * i.e. the IPC round trip as seen from this process. While the round trip
+ * shows i3 is busy, the workspace fetches caused by events are coalesced
+ * over a window growing with the round trip, instead of piling requests on
+ * i3.
  */
 void
-i3wm_set_on_output_changed(i3windowManager *i3wm, i3wmOutputCallback_fun callback, gpointer data)
+i3wm_set_tick_probe(i3windowManager *i3wm, guint interval_ms)
 {
-    i3wm->on_output_changed.function = callback;
-    i3wm->on_output_changed.data = data;
+    if (i3wm->tick_interval == interval_ms)
+        return;
+
+    stop_tick_probe(i3wm);
+    i3wm->tick_interval = interval_ms;
+    start_tick_probe(i3wm);
 }
 
 /**
- * i3wm_set_ipc_shutdown:
+ * i3wm_set_window_tracking:
  * @i3wm: the window manager delegate struct
- * @callback: the callback
- * @data: the data to be passed to the callback function
+ * @enabled: whether to count the windows of the workspaces
  *
- * Set the ipc shutdown event callback.
+ * Keep the window count and the window classes of every workspace. The tree
+ * is fetched once to index the workspace of every window; afterwards the
+ * window events update the index and the counts one window at a time. The
+ * counts and classes are reported as WINDOWS changes; while not tracking,
+ * the count of every workspace is -1 and its classes are NULL.
  */
 void
-i3wm_set_on_ipc_shutdown(i3windowManager *i3wm,
-        i3wmIpcShutdownCallback callback, gpointer data)
+i3wm_set_window_tracking(i3windowManager *i3wm, gboolean enabled)
 {
-    i3wm->on_ipc_shutdown = callback;
-    i3wm->on_ipc_shutdown_data = data;
+    if (i3wm->track_windows == enabled)
+        return;
+
+    i3wm->track_windows = enabled;
+
+    if (enabled)
+    {
+        start_window_tracking(i3wm);
+    }
+    else
+    {
+        if (i3wm->index_source)
+        {
+            g_source_remove(i3wm->index_source);
+            i3wm->index_source = 0;
+        }
+        g_hash_table_remove_all(i3wm->window_index);
+        g_hash_table_remove_all(i3wm->window_counts);
+        g_hash_table_remove_all(i3wm->window_classes);
+        g_hash_table_remove_all(i3wm->window_titles);
+        update_window_counts(i3wm);
+    }
 }
 
 /**
- * i3wm_goto_workspace:
+ * i3wm_set_title_tracking:
  * @i3wm: the window manager delegate struct
- * @workspace: the workspace to jump to
+ * @enabled: whether to follow the title of the focused window
  *
- * Instruct the window manager to jump to the specified workspace.
+ * Report the title of the focused window to the title changed callback.
+ * The tree is fetched once for the initial title; afterwards only the
+ * window events are read, and no workspace is touched by a title change.
  */
 void
-i3wm_goto_workspace(i3windowManager *i3wm, i3workspace *workspace, GError **err)
+i3wm_set_title_tracking(i3windowManager *i3wm, gboolean enabled)
 {
-    size_t cmd_size = (13 + strlen(workspace->name)) * sizeof(gchar);
-    gchar *command_str = (gchar *) malloc(cmd_size);
-    memset(command_str, 0, cmd_size);
-    sprintf(command_str, "workspace %s", workspace->name);
-
-    GError *ipc_err = NULL;
+    if (i3wm->track_title == enabled)
+        return;
 
-    gchar *reply = i3ipc_connection_message(
-            i3wm->connection,
-            I3IPC_MESSAGE_TYPE_COMMAND,
-            command_str,
-            &ipc_err);
+    i3wm->track_title = enabled;
+    i3wm->focused_window = 0;
 
-    if (ipc_err != NULL)
-    {
-        g_propagate_error(err, ipc_err);
-    }
-    else
-    {
-        g_free(reply);
-    }
+    if (enabled)
+        start_window_tracking(i3wm);
 }
 
-/*
- * Implementations of private functions
+/**
+ * i3wm_set_mode_tracking:
+ * @i3wm: the window manager delegate struct
+ * @enabled: whether to report the binding mode
+ *
+ * Subscribe to the mode events, if there is a mode changed callback. Once
+ * disabled, the mode events still sent by i3 are dropped without parsing.
  */
+void
+i3wm_set_mode_tracking(i3windowManager *i3wm, gboolean enabled)
+{
+    if (i3wm->track_mode == enabled)
+        return;
+
+    i3wm->track_mode = enabled;
+    update_subscriptions(i3wm);
+}
 
 /**
- * create_workspace:
- * @workspaceReply: the i3ipcWorkspaceReply struct
+ * i3wm_get_window_titles:
+ * @i3wm: the window manager delegate struct
+ * @workspace: the workspace
  *
- * Create a i3workspace struct from the i3ipcWorkspaceReply struct
+ * The titles of the windows on the workspace, oldest window first. The
+ * list is built from the window index the first time it is asked for and
+ * kept until a window event touches the workspace, so asking costs no
+ * request to i3.
  *
- * Returns: the created workspace
+ * Returns: the titles, owned by the delegate and valid until the next
+ * event, or NULL while the windows are not tracked
  */
-i3workspace *
-create_workspace(i3ipcWorkspaceReply * wreply)
+gchar **
+i3wm_get_window_titles(i3windowManager *i3wm, i3workspace *workspace)
 {
-    i3workspace *workspace = (i3workspace *) g_malloc(sizeof(i3workspace));
+    if (!i3wm->track_windows)
+        return NULL;
+
+    gchar **titles = g_hash_table_lookup(i3wm->window_titles, &workspace->id);
+    if (titles)
+        return titles;
+
+    GPtrArray *windows = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer window;
+    g_hash_table_iter_init(&iter, i3wm->window_index);
+    while (g_hash_table_iter_next(&iter, NULL, &window))
+    {
+        if (((i3wmWindow *) window)->workspace == workspace->id)
+            g_ptr_array_add(windows, window);
+    }
+    g_ptr_array_sort(windows, window_id_cmp);
+
+    titles = g_new0(gchar *, windows->len + 1);
+    guint i;
+    for (i = 0; i < windows->len; i++)
+    {
+        const gchar *title = ((i3wmWindow *) g_ptr_array_index(windows, i))->title;
+        titles[i] = g_strdup(title ? title : "");
+    }
+    g_ptr_array_free(windows, TRUE);
 
-    workspace->num = wreply->num;
-    workspace->name = g_strdup(wreply->name);
-    workspace->focused = wreply->focused;
-    workspace->visible = wreply->visible;
-    workspace->urgent = wreply->urgent;
-    workspace->output = g_strdup(wreply->output);
+    gint64 *key = g_new(gint64, 1);
+    *key = workspace->id;
+    g_hash_table_insert(i3wm->window_titles, key, titles);
+    i3w_stats.window_lists_built++;
 
-    return workspace;
+    return titles;
 }
 
+/*
+ * Implementations of private functions
+ */
+
 /**
  * destroy_workspace:
  * @workspace: the workspace to destroy
@@ -384,6 +698,7 @@ destroy_workspace(i3workspace *workspace)
 {
     g_free(workspace->name);
     g_free(workspace->output);
+    g_strfreev(workspace->classes);
     g_free(workspace);
 }
 
@@ -446,34 +761,6 @@ workspace_name_cmp(const gchar *a, const gchar *b)
     return result;
 }
 
-/*
- * workspace_reply_cmp:
- * @a - i3ipcWorkspaceReply *
- * @b - i3ipcWorkspaceReply *
- *
- * Compare the two workspaces replies by name
- * Returns: gint
- */
-static gint
-workspace_reply_cmp(const i3ipcWorkspaceReply *a, const i3ipcWorkspaceReply *b)
-{
-    return workspace_name_cmp(a->name, b->name);
-}
-
-/*
- * workspace_reply_str_cmp:
- * @w - i3ipcWorkspaceReply *
- * @s - gchar *
- *
- * Compare workspace reply's name with the string
- * Returns: gint
- */
-static gint
-workspace_reply_str_cmp(const i3ipcWorkspaceReply *w, const gchar *s)
-{
-    return workspace_name_cmp(w->name, s);
-}
-
 /*
  * workspace_str_cmp:
  * @w - i3workspace *
@@ -489,256 +776,1452 @@ workspace_str_cmp(const i3workspace *w, const gchar *s)
 }
 
 /**
- * init_workspaces:
- * @i3wm: the window manager delegate struct
- * @err: the error object
+ * append_change:
+ * @changes: the change set
+ * @type: the type of the change
+ * @workspace: the affected workspace
  *
- * Initialize the workspace list.
+ * Append a new, zeroed change record to the change set.
+ *
+ * Returns: the appended change record
  */
-void
-init_workspaces(i3windowManager *i3wm, GError **err)
+static i3wmChange *
+append_change(GArray *changes, i3wmChangeType type, i3workspace *workspace)
 {
-    if (i3wm->wlist) {
-        g_slist_free_full(i3wm->wlist, (GDestroyNotify) destroy_workspace);
-    }
+    g_array_set_size(changes, changes->len + 1);
 
-    i3wm->wlist = NULL;
+    i3wmChange *change = &g_array_index(changes, i3wmChange, changes->len - 1);
+    change->type = type;
+    change->workspace = workspace;
 
-    GError *get_err = NULL;
-    GSList *wlist = i3ipc_connection_get_workspaces(i3wm->connection, &get_err);
+    return change;
+}
 
-    if (get_err != NULL)
+/**
+ * update_workspace:
+ * @workspace: the workspace to update
+ * @current: the workspace as the window manager reported it
+ * @changes: the change set
+ *
+ * Update the workspace from the reply, recording every field that changed.
+ */
+static void
+update_workspace(i3workspace *workspace, i3workspace *current, GArray *changes)
+{
+    i3wmChange *change;
+
+    workspace->id = current->id;
+    workspace->num = current->num;
+
+    if (g_strcmp0(workspace->output, current->output) != 0)
     {
-        g_propagate_error(err, get_err);
-        return;
+        change = append_change(changes, I3WM_CHANGE_MOVED, workspace);
+        change->old_value = workspace->output;
+        workspace->output = g_strdup(current->output);
+        change->new_value = workspace->output;
+    }
+
+    if (workspace->focused != current->focused)
+    {
+        change = append_change(changes, I3WM_CHANGE_FOCUSED, workspace);
+        change->old_state = workspace->focused;
+        change->new_state = workspace->focused = current->focused;
+    }
+
+    if (workspace->urgent != current->urgent)
+    {
+        change = append_change(changes, I3WM_CHANGE_URGENT, workspace);
+        change->old_state = workspace->urgent;
+        change->new_state = workspace->urgent = current->urgent;
     }
 
+    if (workspace->visible != current->visible)
+    {
+        change = append_change(changes, I3WM_CHANGE_VISIBLE, workspace);
+        change->old_state = workspace->visible;
+        change->new_state = workspace->visible = current->visible;
+    }
+}
+
+/**
+ * take_renamed_workspace:
+ * @stale: the workspaces not present in the reply, by name
+ * @wlist: the known workspaces, in order
+ * @current: an unknown workspace of the reply
+ *
+ * Find the workspace which was renamed to the reply's name, i.e. the stale
+ * workspace with the same con id. Where an id is not known, a rename is
+ * assumed to keep the output and the first stale workspace of @wlist on the
+ * same output is taken.
+ *
+ * Returns: the renamed workspace, removed from @stale, or NULL
+ */
+static i3workspace *
+take_renamed_workspace(GHashTable *stale, GSList *wlist, i3workspace *current)
+{
+    i3workspace *renamed = NULL;
+
     GSList *witem;
     for (witem = wlist; witem != NULL; witem = witem->next)
     {
-        i3workspace *workspace = create_workspace((i3ipcWorkspaceReply *) witem->data);
-        i3wm->wlist = g_slist_prepend(i3wm->wlist, workspace);
+        i3workspace *workspace = (i3workspace *) witem->data;
+        if (g_hash_table_lookup(stale, workspace->name) != workspace)
+            continue;
+
+        if (current->id != 0 && workspace->id == current->id)
+        {
+            renamed = workspace;
+            break;
+        }
+
+        if (renamed == NULL && (current->id == 0 || workspace->id == 0) &&
+                g_strcmp0(workspace->output, current->output) == 0)
+            renamed = workspace;
     }
 
-    i3wm->wlist = g_slist_reverse(i3wm->wlist);
-    i3wm->wlist = g_slist_sort(i3wm->wlist, (GCompareFunc) i3wm_workspace_cmp);
+    if (renamed)
+        g_hash_table_remove(stale, renamed->name);
 
-    g_slist_free_full(wlist, (GDestroyNotify) i3ipc_workspace_reply_free);
+    return renamed;
 }
 
 /**
- * subscribe_to_events:
+ * notify_changes:
  * @i3wm: the window manager delegate struct
+ * @changes: the change set, freed
+ *
+ * Pass the changes to the workspaces changed callback, if there are any,
+ * and free them.
+ */
+static void
+notify_changes(i3windowManager *i3wm, GArray *changes)
+{
+    if (changes->len > 0)
+    {
+        i3wm->generation++;
+
+        if (i3wm->on_workspaces_changed.function)
+        {
+            i3wm->on_workspaces_changed.function(changes, i3wm->generation,
+                    i3wm->on_workspaces_changed.data);
+        }
+    }
+
+    guint i;
+    for (i = 0; i < changes->len; i++)
+    {
+        g_free(g_array_index(changes, i3wmChange, i).old_value);
+    }
+
+    g_array_free(changes, TRUE);
+}
+
+/**
+ * parse_workspaces:
+ * @json: the GET_WORKSPACES reply
+ * @length: the length of the reply
  * @err: the error object
  *
- * Subscribe to the workspace events.
+ * Parse the workspaces of the reply.
+ *
+ * Returns: GSList* of i3workspace*, sorted
  */
-void
-subscribe_to_events(i3windowManager *i3wm, GError **err)
+static GSList *
+parse_workspaces(const gchar *json, gsize length, GError **err)
 {
-    GError *ipc_err = NULL;
-    i3ipcCommandReply *reply = NULL;
+    JsonParser *parser = json_parser_new();
+    GSList *wlist = NULL;
 
-	// subscribe to workspace changes
-    reply = i3ipc_connection_subscribe(i3wm->connection, I3IPC_EVENT_WORKSPACE, &ipc_err);
-    if (ipc_err != NULL)
+    if (json_parser_load_from_data(parser, json, length, err))
     {
-        g_propagate_error(err, ipc_err);
-        return;
+        JsonNode *root = json_parser_get_root(parser);
+        JsonArray *array = JSON_NODE_HOLDS_ARRAY(root) ? json_node_get_array(root) : NULL;
+        guint i;
+
+        for (i = 0; array && i < json_array_get_length(array); i++)
+        {
+            JsonObject *object = json_array_get_object_element(array, i);
+            i3workspace *workspace = g_new0(i3workspace, 1);
+
+            workspace->num = json_object_get_int_member(object, "num");
+            workspace->name = g_strdup(json_object_get_string_member(object, "name"));
+            workspace->focused = json_object_get_boolean_member(object, "focused");
+            workspace->urgent = json_object_get_boolean_member(object, "urgent");
+            workspace->visible = json_object_get_boolean_member(object, "visible");
+            workspace->output = g_strdup(json_object_get_string_member(object, "output"));
+            workspace->id = json_object_has_member(object, "id") ?
+                json_object_get_int_member(object, "id") : 0;
+            workspace->windows = -1;
+
+            wlist = g_slist_prepend(wlist, workspace);
+        }
+
+        if (array == NULL)
+            g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "Unexpected workspaces reply");
     }
 
-	// subscribe to mode changes
-    reply = i3ipc_connection_subscribe(i3wm->connection, I3IPC_EVENT_MODE, &ipc_err);
-    if (ipc_err != NULL)
+    g_object_unref(parser);
+
+    return g_slist_sort(wlist, (GCompareFunc) i3wm_workspace_cmp);
+}
+
+/**
+ * sync_workspaces:
+ * @i3wm: the window manager delegate struct
+ * @renames: whether the workspaces may have been renamed since the last sync
+ * @err: the error object
+ *
+ * Fetch the workspace list and reconcile it with the current model. Known
+ * workspaces keep their i3workspace handle; every difference is recorded and
+ * passed to the workspaces changed callback.
+ */
+static void
+sync_workspaces(i3windowManager *i3wm, gboolean renames, GError **err)
+{
+    GError *get_err = NULL;
+    gchar *reply = i3ipc_connection_message(i3wm->connection,
+            I3IPC_MESSAGE_TYPE_GET_WORKSPACES, "", &get_err);
+
+    if (get_err != NULL)
     {
-        g_propagate_error(err, ipc_err);
+        g_propagate_error(err, get_err);
         return;
     }
 
-	// subscribe to output changes
-    reply = i3ipc_connection_subscribe(i3wm->connection, I3IPC_EVENT_OUTPUT, &ipc_err);
-    if (ipc_err != NULL)
+    i3w_stats.replies[I3WM_IPC_GET_WORKSPACES]++;
+    i3w_stats.bytes_read += I3WM_IPC_HEADER_SIZE + strlen(reply);
+
+    if (i3wm->trace)
+        i3wm_trace_record(i3wm->trace, I3WM_IPC_GET_WORKSPACES, reply, strlen(reply));
+
+    GSList *rlist = parse_workspaces(reply, strlen(reply), &get_err);
+    g_free(reply);
+
+    if (get_err != NULL)
     {
-        g_propagate_error(err, ipc_err);
+        g_propagate_error(err, get_err);
+        g_slist_free_full(rlist, (GDestroyNotify) destroy_workspace);
         return;
     }
 
-    g_signal_connect_after(i3wm->connection, "workspace", G_CALLBACK(on_workspace_event), i3wm);
-    g_signal_connect_after(i3wm->connection, "mode", G_CALLBACK(on_mode_event), i3wm);
-    g_signal_connect_after(i3wm->connection, "output", G_CALLBACK(on_output_event), i3wm);
+    I3W_PROBE(model_update_start);
+
+    GArray *changes = g_array_new(FALSE, TRUE, sizeof(i3wmChange));
+    GHashTable *stale = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray *handles = g_ptr_array_new();
+
+    GSList *witem;
+    for (witem = i3wm->wlist; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        g_hash_table_insert(stale, workspace->name, workspace);
+    }
+
+    // match the known workspaces by name first, so renames can only pair
+    // workspaces which really disappeared
+    GSList *ritem;
+    for (ritem = rlist; ritem != NULL; ritem = ritem->next)
+    {
+        i3workspace *current = (i3workspace *) ritem->data;
+        i3workspace *workspace = g_hash_table_lookup(stale, current->name);
+        if (workspace)
+            g_hash_table_remove(stale, current->name);
+        g_ptr_array_add(handles, workspace);
+    }
+
+    guint i;
+    for (ritem = rlist, i = 0; ritem != NULL; ritem = ritem->next, i++)
+    {
+        i3workspace *current = (i3workspace *) ritem->data;
+        i3workspace *workspace = g_ptr_array_index(handles, i);
+
+        if (workspace == NULL && renames)
+        {
+            workspace = take_renamed_workspace(stale, i3wm->wlist, current);
+            if (workspace)
+            {
+                i3wmChange *change = append_change(changes, I3WM_CHANGE_RENAMED, workspace);
+                change->old_value = workspace->name;
+                workspace->name = g_strdup(current->name);
+                change->new_value = workspace->name;
+            }
+        }
+
+        if (workspace)
+        {
+            update_workspace(workspace, current, changes);
+        }
+        else
+        {
+            // a new workspace, the parsed one becomes the handle; its
+            // windows may have been indexed before it was fetched
+            workspace = current;
+            ritem->data = NULL;
+            if (i3wm->track_windows)
+            {
+                workspace->windows = get_window_count(i3wm, workspace->id);
+                workspace->classes = get_window_classes(i3wm, workspace->id);
+            }
+            append_change(changes, I3WM_CHANGE_ADDED, workspace);
+        }
+
+        g_ptr_array_index(handles, i) = workspace;
+    }
+
+    GList *removed = g_hash_table_get_values(stale);
+    GList *item;
+    for (item = removed; item != NULL; item = item->next)
+    {
+        append_change(changes, I3WM_CHANGE_REMOVED, (i3workspace *) item->data);
+    }
+
+    g_slist_free(i3wm->wlist);
+    i3wm->wlist = NULL;
+    for (i = handles->len; i > 0; i--)
+    {
+        i3wm->wlist = g_slist_prepend(i3wm->wlist, g_ptr_array_index(handles, i - 1));
+    }
+
+    // the window changes of the batch go with the workspace changes
+    if (i3wm->batch_counts)
+        append_window_changes(i3wm, changes);
+
+    I3W_PROBE1(model_update_end, changes->len);
+
+    notify_changes(i3wm, changes);
 
-    i3ipc_command_reply_free(reply);
+    g_list_free_full(removed, (GDestroyNotify) destroy_workspace);
+    g_ptr_array_free(handles, TRUE);
+    g_hash_table_destroy(stale);
+    for (ritem = rlist; ritem != NULL; ritem = ritem->next)
+    {
+        if (ritem->data)
+            destroy_workspace((i3workspace *) ritem->data);
+    }
+    g_slist_free(rlist);
 }
 
 /**
- * invoke_callback
- * @callback: the i3wmCallback structure
- * @workspace: the workspace
+ * subscribe_to_events:
+ * @i3wm: the window manager delegate struct
+ * @socket_path: the socket of the window manager
+ * @err: the error object
  *
- * Invokes the specified callback with the workspace as parameter.
+ * Open the event connection, subscribed to the events wanted right now.
  */
 static void
-invoke_callback(const i3wmCallback callback)
+subscribe_to_events(i3windowManager *i3wm, const gchar *socket_path, GError **err)
+{
+    guint wanted = get_wanted_events(i3wm);
+    gchar *events = format_events(wanted);
+
+    i3wm->events = i3wm_ipc_new(socket_path, events, err);
+    g_free(events);
+    if (i3wm->events == NULL)
+        return;
+
+    i3wm->subscribed = wanted;
+
+    i3wm_ipc_set_event_callback(i3wm->events, on_ipc_event, i3wm);
+    i3wm_ipc_set_batch_callback(i3wm->events, on_ipc_batch, i3wm);
+    i3wm_ipc_set_closed_callback(i3wm->events, on_ipc_closed, i3wm);
+}
+
+/**
+ * get_wanted_events:
+ * @i3wm: the window manager delegate struct
+ *
+ * The events the enabled features need: the workspace and output events
+ * always, the mode events while reported, the window events while tracking
+ * windows or the title and the tick events while probing.
+ *
+ * Returns: the event types, 1 << type each
+ */
+static guint
+get_wanted_events(i3windowManager *i3wm)
+{
+    guint events = 1 << I3WM_IPC_EVENT_WORKSPACE | 1 << I3WM_IPC_EVENT_OUTPUT;
+
+    if (i3wm->track_mode && i3wm->on_mode_changed.function)
+        events |= 1 << I3WM_IPC_EVENT_MODE;
+    if (i3wm->track_windows || i3wm->track_title)
+        events |= 1 << I3WM_IPC_EVENT_WINDOW;
+    if (i3wm->tick_interval)
+        events |= 1 << I3WM_IPC_EVENT_TICK;
+
+    return events;
+}
+
+/**
+ * format_events:
+ * @events: the event types, 1 << type each
+ *
+ * Returns: the JSON array of the event names to subscribe with
+ */
+static gchar *
+format_events(guint events)
 {
-    if (callback.function)
+    static const struct
     {
-        callback.function(callback.data);
+        guint32 type;
+        const gchar *name;
+    } names[] = {
+        { I3WM_IPC_EVENT_WORKSPACE, "workspace" },
+        { I3WM_IPC_EVENT_OUTPUT, "output" },
+        { I3WM_IPC_EVENT_MODE, "mode" },
+        { I3WM_IPC_EVENT_WINDOW, "window" },
+        { I3WM_IPC_EVENT_TICK, "tick" }
+    };
+    GString *json = g_string_new("[");
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(names); i++)
+    {
+        if (!(events & 1 << names[i].type))
+            continue;
+        if (json->len > 1)
+            g_string_append_c(json, ',');
+        g_string_append_printf(json, "\"%s\"", names[i].name);
     }
+    g_string_append_c(json, ']');
+
+    return g_string_free(json, FALSE);
 }
 
 /**
- * on_workspace_event:
- * @conn: the connection with the window manager
- * @e: event data
+ * update_subscriptions:
  * @i3wm: the window manager delegate struct
  *
- * The workspace event callback.
+ * Subscribe to the wanted events not subscribed to yet, if connected. The
+ * reply is dropped by the event connection.
  */
-void
-on_workspace_event(i3ipcConnection *conn, i3ipcWorkspaceEvent *e, gpointer i3wm)
+static void
+update_subscriptions(i3windowManager *i3wm)
+{
+    if (i3wm->events == NULL)
+        return;
+
+    guint missing = get_wanted_events(i3wm) & ~i3wm->subscribed;
+    if (missing == 0)
+        return;
+
+    gchar *events = format_events(missing);
+    if (i3wm_ipc_send(i3wm->events, I3WM_IPC_SUBSCRIBE, events, NULL))
+        i3wm->subscribed |= missing;
+    g_free(events);
+}
+
+/**
+ * request_sync:
+ * @i3wm: the window manager delegate struct
+ * @renames: whether the workspaces may have been renamed
+ *
+ * Fetch the workspaces because of an event: once the events read with it
+ * are handled, or while i3 is busy once the coalescing window passed,
+ * together with the fetches requested by the events arriving meanwhile.
+ */
+static void
+request_sync(i3windowManager *i3wm, gboolean renames)
 {
-    if (strncmp(e->change, "focus", 5) == 0) on_focus_workspace((i3windowManager *) i3wm, e->current, e->old);
-    else if (strncmp(e->change, "init", 5) == 0) on_init_workspace((i3windowManager *) i3wm);
-    else if (strncmp(e->change, "empty", 5) == 0) on_empty_workspace((i3windowManager *) i3wm);
-    else if (strncmp(e->change, "urgent", 6) == 0) on_urgent_workspace((i3windowManager *) i3wm);
-    else if (strncmp(e->change, "rename", 6) == 0) on_rename_workspace((i3windowManager *) i3wm);
-    else if (strncmp(e->change, "move", 4) == 0) on_move_workspace((i3windowManager *) i3wm);
-    else g_printf("Unknown event: %s\n", e->change);
+    i3wm->sync_renames |= renames;
+
+    if (i3wm->sync_source || i3wm->batch_sync)
+    {
+        i3w_stats.coalesced_syncs++;
+        return;
+    }
+
+    if (i3wm->coalesce_ms == 0 && i3wm->in_batch)
+        i3wm->batch_sync = TRUE;
+    else if (i3wm->coalesce_ms == 0)
+        run_pending_sync(i3wm);
+    else
+        i3wm->sync_source = g_timeout_add(i3wm->coalesce_ms, on_sync_timeout, i3wm);
 }
 
 /**
- * on_focus_workspace:
+ * run_pending_sync:
  * @i3wm: the window manager delegate struct
- * @current: the currently focused workspace
- * @old: the previously focused workspace
  *
- * Focus workspace event handler.
+ * Fetch the workspaces as requested.
  */
-void
-on_focus_workspace(i3windowManager *i3wm, i3ipcCon *current, i3ipcCon *old)
+static void
+run_pending_sync(i3windowManager *i3wm)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  invoke_callback(i3wm->on_workspace_focused);
+    GError *tmp_err = NULL;
+    gboolean renames = i3wm->sync_renames;
+
+    i3wm->sync_renames = FALSE;
+    i3wm->batch_sync = FALSE;
+    sync_workspaces(i3wm, renames, &tmp_err);
+
+    if (tmp_err != NULL)
+    {
+        g_printerr("Cannot update the workspaces: %s\n", tmp_err->message);
+        g_error_free(tmp_err);
+    }
+}
+
+static gboolean
+on_sync_timeout(gpointer i3w)
+{
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+
+    i3wm->sync_source = 0;
+    run_pending_sync(i3wm);
+
+    return FALSE;
 }
 
 /**
- * on_init_workspace:
- * @i3wm - the window manager delegate struct
+ * on_ipc_event:
+ * @type: the event type
+ * @payload: the event payload
+ * @length: the length of the payload
+ * @i3w: the window manager delegate struct
  *
- * Init workspace event handler
+ * Record the event if tracing, parse it and pass it to its handler.
  */
-void
-on_init_workspace(i3windowManager *i3wm)
+static void
+on_ipc_event(guint32 type, const gchar *payload, gsize length, gpointer i3w)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  invoke_callback(i3wm->on_workspace_created);
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+    JsonParser *parser = json_parser_new();
+    GError *tmp_err = NULL;
+
+    gint64 start = g_get_monotonic_time();
+    i3wm->in_batch = TRUE;
+
+    if (type < I3W_STATS_EVENT_TYPES)
+        i3w_stats.events[type]++;
+    i3w_stats.bytes_read += I3WM_IPC_HEADER_SIZE + length;
+
+    if (i3wm->trace)
+        i3wm_trace_record(i3wm->trace, I3WM_IPC_EVENT_BIT | type, payload, length);
+
+    // subscribed to while a feature was enabled, nobody reads them now
+    if (type < 32 && !(get_wanted_events(i3wm) & 1 << type))
+    {
+        i3w_stats.events_dropped++;
+        g_object_unref(parser);
+        return;
+    }
+
+    if (!json_parser_load_from_data(parser, payload, length, &tmp_err) ||
+            !JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser)))
+    {
+        g_printerr("Cannot parse the event: %s\n",
+                tmp_err ? tmp_err->message : "not an object");
+        g_clear_error(&tmp_err);
+        g_object_unref(parser);
+        return;
+    }
+
+    JsonObject *event = json_node_get_object(json_parser_get_root(parser));
+    const gchar *change = json_object_has_member(event, "change") ?
+        json_object_get_string_member(event, "change") : "";
+
+    switch (type)
+    {
+        case I3WM_IPC_EVENT_WORKSPACE:
+            clear_title_if_empty(i3wm, change, event);
+            on_workspace_event(i3wm, change);
+            i3w_stats_record_time(I3W_STATS_WORKSPACE_EVENT, start);
+            break;
+        case I3WM_IPC_EVENT_MODE:
+            on_mode_event(i3wm, change, event);
+            i3w_stats_record_time(I3W_STATS_MODE_EVENT, start);
+            break;
+        case I3WM_IPC_EVENT_OUTPUT:
+            on_output_event(i3wm, change);
+            i3w_stats_record_time(I3W_STATS_OUTPUT_EVENT, start);
+            break;
+        case I3WM_IPC_EVENT_WINDOW:
+            on_window_event(i3wm, change, event);
+            i3w_stats_record_time(I3W_STATS_WINDOW_EVENT, start);
+            break;
+        case I3WM_IPC_EVENT_TICK:
+            on_tick_event(i3wm, event);
+            break;
+    }
+
+    g_object_unref(parser);
 }
 
 /**
- * on_empty_workspace:
- * @i3wm - the window manager delegate struct
+ * on_ipc_batch:
+ * @events: the number of events read
+ * @i3w: the window manager delegate struct
  *
- * Empty workspace event handler
+ * The events read in a wakeup were handled: fetch the workspaces and report
+ * the window counts, as far as any of them asked for it. The workspace
+ * changes and the window changes are reported together.
  */
-void
-on_empty_workspace(i3windowManager *i3wm)
+static void
+on_ipc_batch(guint events, gpointer i3w)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  invoke_callback(i3wm->on_workspace_destroyed);
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+
+    i3wm->in_batch = FALSE;
+    i3w_stats.event_batches++;
+
+    if (i3wm->batch_sync)
+        run_pending_sync(i3wm);
+    if (i3wm->batch_counts)
+        update_window_counts(i3wm);
 }
 
 /**
- * on_urgent_workspace:
+ * on_workspace_event:
  * @i3wm: the window manager delegate struct
+ * @change: the kind of change
  *
- * Urgent workspace event handler.
- * This can mean two thigs: either a workspace became urgent or it was urgent and
- * now it isn't.
+ * The workspace event callback.
  */
-void
-on_urgent_workspace(i3windowManager *i3wm)
+static void
+on_workspace_event(i3windowManager *i3wm, const gchar *change)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  invoke_callback(i3wm->on_workspace_urgent);
+    I3W_PROBE1(workspace_event, change);
+
+    if (strncmp(change, "rename", 6) == 0)
+    {
+        request_sync(i3wm, TRUE);
+    }
+    else if (strncmp(change, "focus", 5) == 0 ||
+             strncmp(change, "init", 5) == 0 ||
+             strncmp(change, "empty", 5) == 0 ||
+             strncmp(change, "urgent", 6) == 0 ||
+             strncmp(change, "move", 4) == 0)
+    {
+        request_sync(i3wm, FALSE);
+    }
+    else
+    {
+        g_printf("Unknown event: %s\n", change);
+    }
 }
 
 /**
- * on_rename_workspace:
+ * on_mode_event:
  * @i3wm: the window manager delegate struct
+ * @change: the new binding mode
+ * @event: the mode event
  *
- * Renamed workspace event handler.
+ * The binding mode event callback. Modes defined with pango_markup in the i3
+ * configuration carry markup in their name.
  */
-void
-on_rename_workspace(i3windowManager *i3wm)
+static void
+on_mode_event(i3windowManager *i3wm, const gchar *change, JsonObject *event) {
+    I3W_PROBE1(mode_event, change);
+
+    if (i3wm->on_mode_changed.function == NULL)
+        return;
+
+    gboolean pango_markup = json_object_has_member(event, "pango_markup") &&
+        json_object_get_boolean_member(event, "pango_markup");
+
+    i3wm->on_mode_changed.function((gchar *) change, pango_markup,
+            i3wm->on_mode_changed.data);
+}
+
+/**
+ * on_output_event:
+ * @i3wm: the window manager delegate struct
+ * @change: the kind of change
+ *
+ * The output callback.
+ */
+static void
+on_output_event(i3windowManager *i3wm, const gchar *change) {
+    I3W_PROBE1(output_event, change);
+
+    request_sync(i3wm, FALSE);
+
+    if (i3wm->on_output_changed.function)
+        i3wm->on_output_changed.function((gchar *) change, i3wm->on_output_changed.data);
+}
+
+/**
+ * on_tick_event:
+ * @i3wm: the window manager delegate struct
+ * @event: the tick event
+ *
+ * The tick event callback. Only the answer to the outstanding probe is
+ * measured; the tick of the subscription and ticks of other clients are
+ * ignored.
+ */
+static void
+on_tick_event(i3windowManager *i3wm, JsonObject *event)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  // Since created already removes/adds all the worskpaces,
-  // we don't need to also call the "destroyed" callback
-  invoke_callback(i3wm->on_workspace_created);
+    const gchar *payload = json_object_has_member(event, "payload") ?
+        json_object_get_string_member(event, "payload") : NULL;
+
+    if (payload == NULL || i3wm->tick_sent == 0 ||
+            !g_str_has_prefix(payload, TICK_PAYLOAD_PREFIX) ||
+            strtoul(payload + strlen(TICK_PAYLOAD_PREFIX), NULL, 10) != i3wm->tick_sequence)
+        return;
+
+    i3w_stats_record_time(I3W_STATS_TICK_ROUND_TRIP, i3wm->tick_sent);
+    update_rtt(i3wm, g_get_monotonic_time() - i3wm->tick_sent);
+    i3wm->tick_sent = 0;
 }
 
 /**
- * on_move_workspace:
+ * start_tick_probe:
  * @i3wm: the window manager delegate struct
  *
- * Moved workspace event handler.
+ * Start probing if enabled and connected, subscribing to the tick events
+ * first if the connection is not yet.
  */
-void
-on_move_workspace(i3windowManager *i3wm)
+static void
+start_tick_probe(i3windowManager *i3wm)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  // Since created already removes/adds all the worskpaces,
-  // we don't need to also call the "destroyed" callback
-  invoke_callback(i3wm->on_workspace_created);
+    if (i3wm->tick_interval == 0 || i3wm->events == NULL || i3wm->tick_source)
+        return;
+
+    update_subscriptions(i3wm);
+
+    i3wm->tick_source = g_timeout_add(i3wm->tick_interval, send_tick, i3wm);
 }
 
 /**
- * on_mode_event:
- * @conn: the connection with the window manager
- * @e: event data
- * @i3w: the window manager delegate struct
+ * stop_tick_probe:
+ * @i3wm: the window manager delegate struct
  *
- * The binding mode event callback.
+ * Stop probing and forget the measured round trip, so the fetches are not
+ * coalesced any more.
  */
-void
-on_mode_event(i3ipcConnection *conn, i3ipcGenericEvent *e, gpointer i3w) {
-    i3windowManager *i3wm = (i3windowManager *) i3w;
-    i3wm->on_mode_changed.function(e->change, i3wm->on_mode_changed.data);
+static void
+stop_tick_probe(i3windowManager *i3wm)
+{
+    if (i3wm->tick_source)
+    {
+        g_source_remove(i3wm->tick_source);
+        i3wm->tick_source = 0;
+    }
+
+    i3wm->tick_sent = 0;
+    i3wm->rtt = 0;
+    i3wm->coalesce_ms = 0;
 }
 
 /**
- * on_output_event:
- * @conn: the connection with the window manager
- * @e: event data
+ * send_tick:
  * @i3w: the window manager delegate struct
  *
- * The output callback.
+ * Send the next probe. While the last one is still unanswered, no new one
+ * is sent; the time it is outstanding already counts as a round trip.
+ *
+ * Returns: TRUE to keep probing
  */
-void 
-on_output_event(i3ipcConnection *conn, i3ipcGenericEvent *e, gpointer i3w) {
+static gboolean
+send_tick(gpointer i3w)
+{
     i3windowManager *i3wm = (i3windowManager *) i3w;
-    GError *tmp_err = NULL;
-    init_workspaces(i3wm, &tmp_err);
-    invoke_callback(i3wm->on_workspace_created);
+    gint64 now = g_get_monotonic_time();
+
+    if (i3wm->tick_sent)
+    {
+        i3w_stats.ticks_late++;
+        update_rtt(i3wm, now - i3wm->tick_sent);
+        return TRUE;
+    }
+
+    gchar *payload = g_strdup_printf(TICK_PAYLOAD_PREFIX "%u", ++i3wm->tick_sequence);
+    if (i3wm_ipc_send(i3wm->events, I3WM_IPC_SEND_TICK, payload, NULL))
+    {
+        i3wm->tick_sent = now;
+        i3w_stats.ticks_sent++;
+    }
+    g_free(payload);
+
+    return TRUE;
 }
 
 /**
- * on_ipc_shutdown_proxy:
- * @connection: the ipc connection object
- * @i3wm - pointer to the window manager delegate struct
+ * update_rtt:
+ * @i3wm: the window manager delegate struct
+ * @sample: a round trip in microseconds
  *
- * Passes the ipc-shutdown signal to the callback
+ * Smooth the round trip and size the coalescing window from it: twice the
+ * round trip while i3 is busy, nothing once it recovered.
  */
 static void
-on_ipc_shutdown_proxy(i3ipcConnection *connection, gpointer i3w)
+update_rtt(i3windowManager *i3wm, gint64 sample)
 {
-    i3windowManager *i3wm = (i3windowManager *) i3w;
+    i3wm->rtt = i3wm->rtt ? (3 * i3wm->rtt + sample) / 4 : sample;
+
+    if (i3wm->rtt > BUSY_RTT_US)
+        i3wm->coalesce_ms = MIN(2 * i3wm->rtt / 1000, MAX_COALESCE_MS);
+    else if (i3wm->rtt < IDLE_RTT_US)
+        i3wm->coalesce_ms = 0;
+
+    i3w_stats.tick_rtt_us = i3wm->rtt;
+    i3w_stats.coalesce_window_ms = i3wm->coalesce_ms;
+}
+
+/**
+ * on_window_event:
+ * @i3wm: the window manager delegate struct
+ * @change: the kind of change
+ * @event: the window event
+ *
+ * The window event callback. The title is followed first; then a closed
+ * window is looked up in the index. The events of a new or a moved window
+ * do not tell its workspace, which an assignment may choose for a new one,
+ * so the index is rebuilt from the tree once the pending events are
+ * handled. A new title only replaces the title in the index.
+ */
+static void
+on_window_event(i3windowManager *i3wm, const gchar *change, JsonObject *event)
+{
+    I3W_PROBE1(window_event, change);
+
+    if (!json_object_has_member(event, "container"))
+        return;
+
+    JsonObject *container = json_object_get_object_member(event, "container");
+    gint64 id = json_object_get_int_member(container, "id");
+
+    if (i3wm->track_title)
+        update_title(i3wm, change, container);
+
+    // a pending rebuild sees the outcome of this event anyway
+    if (!i3wm->track_windows || i3wm->index_source)
+        return;
+
+    if (strcmp(change, "close") == 0)
+    {
+        if (remove_window(i3wm, id))
+            request_window_counts(i3wm);
+    }
+    else if (strcmp(change, "new") == 0 || strcmp(change, "move") == 0)
+    {
+        schedule_index_rebuild(i3wm);
+    }
+    else if (strcmp(change, "title") == 0)
+    {
+        retitle_window(i3wm, id, json_object_has_member(container, "name") ?
+                json_object_get_string_member(container, "name") : NULL);
+    }
+}
+
+/**
+ * start_window_tracking:
+ * @i3wm: the window manager delegate struct
+ *
+ * Build the window index and find the focused window, as far as tracked,
+ * if connected; subscribing to the window events first if the connection
+ * is not yet.
+ */
+static void
+start_window_tracking(i3windowManager *i3wm)
+{
+    GError *tmp_err = NULL;
+
+    if ((!i3wm->track_windows && !i3wm->track_title) || i3wm->events == NULL)
+        return;
+
+    update_subscriptions(i3wm);
+
+    fetch_tree(i3wm, &tmp_err);
+    if (tmp_err != NULL)
+    {
+        g_printerr("Cannot fetch the windows: %s\n", tmp_err->message);
+        g_error_free(tmp_err);
+    }
+}
+
+/**
+ * fetch_tree:
+ * @i3wm: the window manager delegate struct
+ * @err: the error object
+ *
+ * Fetch the tree; index the workspace of every window in it and report the
+ * title of the focused window, as far as tracked.
+ */
+static void
+fetch_tree(i3windowManager *i3wm, GError **err)
+{
+    gint64 start = g_get_monotonic_time();
+    GError *get_err = NULL;
+    gchar *reply = i3ipc_connection_message(i3wm->connection,
+            I3IPC_MESSAGE_TYPE_GET_TREE, "", &get_err);
+
+    if (get_err != NULL)
+    {
+        g_propagate_error(err, get_err);
+        return;
+    }
+
+    i3w_stats.replies[I3WM_IPC_GET_TREE]++;
+    i3w_stats.bytes_read += I3WM_IPC_HEADER_SIZE + strlen(reply);
+
+    if (i3wm->trace)
+        i3wm_trace_record(i3wm->trace, I3WM_IPC_GET_TREE, reply, strlen(reply));
+
+    JsonParser *parser = json_parser_new();
+    if (json_parser_load_from_data(parser, reply, strlen(reply), &get_err) &&
+            JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser)))
+    {
+        JsonObject *root = json_node_get_object(json_parser_get_root(parser));
+
+        if (i3wm->track_windows)
+        {
+            g_hash_table_remove_all(i3wm->window_index);
+            g_hash_table_remove_all(i3wm->window_counts);
+            g_hash_table_remove_all(i3wm->window_classes);
+            g_hash_table_remove_all(i3wm->window_titles);
+            index_windows(i3wm, root, 0);
+            update_window_counts(i3wm);
+        }
+
+        if (i3wm->track_title)
+        {
+            JsonObject *focused = find_focused_window(root);
+            if (focused)
+                set_title(i3wm, json_object_get_int_member(focused, "id"),
+                        json_object_get_string_member(focused, "name"));
+            else
+                set_title(i3wm, 0, NULL);
+        }
+    }
+    else if (get_err == NULL)
+    {
+        g_set_error(&get_err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                "Unexpected tree reply");
+    }
+
+    if (get_err != NULL)
+        g_propagate_error(err, get_err);
+
+    g_object_unref(parser);
+    g_free(reply);
+
+    i3w_stats_record_time(I3W_STATS_WINDOW_INDEX, start);
+}
+
+/**
+ * index_windows:
+ * @i3wm: the window manager delegate struct
+ * @node: a container of the tree
+ * @workspace: the id of the workspace the container is on, 0 above the
+ * workspaces
+ *
+ * Index the windows in the container and its children.
+ */
+static void
+index_windows(i3windowManager *i3wm, JsonObject *node, gint64 workspace)
+{
+    static const gchar *children[] = { "nodes", "floating_nodes" };
+
+    if (json_object_has_member(node, "type") &&
+            g_strcmp0(json_object_get_string_member(node, "type"), "workspace") == 0)
+    {
+        workspace = json_object_get_int_member(node, "id");
+    }
+    else if (workspace && json_object_has_member(node, "window") &&
+            !json_object_get_null_member(node, "window"))
+    {
+        add_window(i3wm, node, workspace);
+    }
+
+    guint c, i;
+    for (c = 0; c < G_N_ELEMENTS(children); c++)
+    {
+        if (!json_object_has_member(node, children[c]))
+            continue;
+
+        JsonArray *nodes = json_object_get_array_member(node, children[c]);
+        for (i = 0; nodes && i < json_array_get_length(nodes); i++)
+        {
+            index_windows(i3wm, json_array_get_object_element(nodes, i), workspace);
+        }
+    }
+}
+
+/**
+ * find_focused_window:
+ * @node: a container of the tree
+ *
+ * Returns: the focused window in the container or its children, or NULL
+ */
+static JsonObject *
+find_focused_window(JsonObject *node)
+{
+    static const gchar *children[] = { "nodes", "floating_nodes" };
+
+    if (json_object_has_member(node, "focused") &&
+            json_object_get_boolean_member(node, "focused") &&
+            json_object_has_member(node, "window") &&
+            !json_object_get_null_member(node, "window"))
+        return node;
+
+    guint c, i;
+    for (c = 0; c < G_N_ELEMENTS(children); c++)
+    {
+        if (!json_object_has_member(node, children[c]))
+            continue;
+
+        JsonArray *nodes = json_object_get_array_member(node, children[c]);
+        for (i = 0; nodes && i < json_array_get_length(nodes); i++)
+        {
+            JsonObject *focused = find_focused_window(
+                    json_array_get_object_element(nodes, i));
+            if (focused)
+                return focused;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * schedule_index_rebuild:
+ * @i3wm: the window manager delegate struct
+ *
+ * Rebuild the window index once the pending events are handled, so a burst
+ * of moves costs a single fetch of the tree.
+ */
+static void
+schedule_index_rebuild(i3windowManager *i3wm)
+{
+    if (i3wm->index_source == 0)
+        i3wm->index_source = g_idle_add(on_index_rebuild, i3wm);
+}
+
+static gboolean
+on_index_rebuild(gpointer i3w)
+{
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+
+    i3wm->index_source = 0;
+    start_window_tracking(i3wm);
+
+    return FALSE;
+}
+
+/**
+ * get_window_class:
+ * @container: a window container of the tree or of a window event
+ *
+ * Returns: the class of the window's WM_CLASS, or NULL
+ */
+static const gchar *
+get_window_class(JsonObject *container)
+{
+    if (!json_object_has_member(container, "window_properties"))
+        return NULL;
+
+    JsonObject *properties = json_object_get_object_member(container, "window_properties");
+    if (properties == NULL || !json_object_has_member(properties, "class"))
+        return NULL;
+
+    return json_object_get_string_member(properties, "class");
+}
+
+/**
+ * add_window:
+ * @i3wm: the window manager delegate struct
+ * @container: the window container, of the tree or of a window event
+ * @workspace: the container id of its workspace
+ *
+ * Index the window and count it and its class on its workspace.
+ */
+static void
+add_window(i3windowManager *i3wm, JsonObject *container, gint64 workspace)
+{
+    i3wmWindow *window = g_new(i3wmWindow, 1);
+    window->id = json_object_get_int_member(container, "id");
+    window->workspace = workspace;
+    window->class = g_strdup(get_window_class(container));
+    window->title = json_object_has_member(container, "name") ?
+        g_strdup(json_object_get_string_member(container, "name")) : NULL;
+    g_hash_table_replace(i3wm->window_index, &window->id, window);
+    g_hash_table_remove(i3wm->window_titles, &workspace);
+
+    gint count = get_window_count(i3wm, workspace);
+    gint64 *key = g_new(gint64, 1);
+    *key = workspace;
+    g_hash_table_replace(i3wm->window_counts, key, GINT_TO_POINTER(count + 1));
+
+    if (window->class == NULL)
+        return;
+
+    GHashTable *classes = g_hash_table_lookup(i3wm->window_classes, &workspace);
+    if (classes == NULL)
+    {
+        classes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        key = g_new(gint64, 1);
+        *key = workspace;
+        g_hash_table_insert(i3wm->window_classes, key, classes);
+    }
+
+    gint windows = GPOINTER_TO_INT(g_hash_table_lookup(classes, window->class));
+    g_hash_table_replace(classes, g_strdup(window->class), GINT_TO_POINTER(windows + 1));
+}
+
+/**
+ * remove_window:
+ * @i3wm: the window manager delegate struct
+ * @id: the container id of the window
+ *
+ * Drop the window from the index and from the count and the classes of its
+ * workspace.
+ *
+ * Returns: FALSE if the window was not indexed
+ */
+static gboolean
+remove_window(i3windowManager *i3wm, gint64 id)
+{
+    i3wmWindow *window = g_hash_table_lookup(i3wm->window_index, &id);
+    if (window == NULL)
+        return FALSE;
+
+    gint count = get_window_count(i3wm, window->workspace);
+    if (count > 1)
+    {
+        gint64 *key = g_new(gint64, 1);
+        *key = window->workspace;
+        g_hash_table_replace(i3wm->window_counts, key, GINT_TO_POINTER(count - 1));
+    }
+    else
+    {
+        g_hash_table_remove(i3wm->window_counts, &window->workspace);
+    }
+
+    GHashTable *classes = window->class ?
+        g_hash_table_lookup(i3wm->window_classes, &window->workspace) : NULL;
+    if (classes)
+    {
+        gint windows = GPOINTER_TO_INT(g_hash_table_lookup(classes, window->class));
+        if (windows > 1)
+            g_hash_table_replace(classes, g_strdup(window->class), GINT_TO_POINTER(windows - 1));
+        else
+            g_hash_table_remove(classes, window->class);
+
+        if (g_hash_table_size(classes) == 0)
+            g_hash_table_remove(i3wm->window_classes, &window->workspace);
+    }
+
+    g_hash_table_remove(i3wm->window_titles, &window->workspace);
+    g_hash_table_remove(i3wm->window_index, &id);
+
+    return TRUE;
+}
+
+/**
+ * retitle_window:
+ * @i3wm: the window manager delegate struct
+ * @id: the container id of the window
+ * @title: the new title
+ *
+ * Keep the new title of the window and drop the title list of its
+ * workspace, to be built again when asked for.
+ */
+static void
+retitle_window(i3windowManager *i3wm, gint64 id, const gchar *title)
+{
+    i3wmWindow *window = g_hash_table_lookup(i3wm->window_index, &id);
+    if (window == NULL || g_strcmp0(window->title, title) == 0)
+        return;
+
+    g_free(window->title);
+    window->title = g_strdup(title);
+    g_hash_table_remove(i3wm->window_titles, &window->workspace);
+}
+
+static void
+free_window(i3wmWindow *window)
+{
+    g_free(window->class);
+    g_free(window->title);
+    g_free(window);
+}
+
+static gint
+window_id_cmp(gconstpointer a, gconstpointer b)
+{
+    gint64 x = (*(i3wmWindow **) a)->id;
+    gint64 y = (*(i3wmWindow **) b)->id;
+
+    return x < y ? -1 : x > y;
+}
+
+static gint
+get_window_count(i3windowManager *i3wm, gint64 workspace)
+{
+    return GPOINTER_TO_INT(g_hash_table_lookup(i3wm->window_counts, &workspace));
+}
+
+/**
+ * get_window_classes:
+ * @i3wm: the window manager delegate struct
+ * @workspace: the container id of the workspace
+ *
+ * Returns: the sorted, distinct classes of the windows on the workspace, to
+ * be freed with g_strfreev
+ */
+static gchar **
+get_window_classes(i3windowManager *i3wm, gint64 workspace)
+{
+    GHashTable *classes = g_hash_table_lookup(i3wm->window_classes, &workspace);
+    GPtrArray *sorted = g_ptr_array_new();
+
+    if (classes)
+    {
+        GList *keys = g_hash_table_get_keys(classes);
+        GList *item;
+        for (item = keys; item != NULL; item = item->next)
+            g_ptr_array_add(sorted, g_strdup((const gchar *) item->data));
+        g_list_free(keys);
+
+        g_ptr_array_sort(sorted, class_cmp);
+    }
+
+    g_ptr_array_add(sorted, NULL);
+
+    return (gchar **) g_ptr_array_free(sorted, FALSE);
+}
+
+static gint
+class_cmp(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+static gboolean
+classes_equal(gchar **a, gchar **b)
+{
+    if (a == NULL || b == NULL)
+        return a == b;
+
+    while (*a && *b && strcmp(*a, *b) == 0)
+    {
+        a++;
+        b++;
+    }
+
+    return *a == NULL && *b == NULL;
+}
+
+/**
+ * update_window_counts:
+ * @i3wm: the window manager delegate struct
+ *
+ * Bring the window count and the classes of every workspace in line with the
+ * index and report the workspaces which changed. Costs a lookup per
+ * workspace, not per window.
+ */
+static void
+update_window_counts(i3windowManager *i3wm)
+{
+    GArray *changes = g_array_new(FALSE, TRUE, sizeof(i3wmChange));
+
+    append_window_changes(i3wm, changes);
+    notify_changes(i3wm, changes);
+}
+
+/**
+ * request_window_counts:
+ * @i3wm: the window manager delegate struct
+ *
+ * Update the window counts because of an event: once the events read with
+ * it are handled.
+ */
+static void
+request_window_counts(i3windowManager *i3wm)
+{
+    if (i3wm->in_batch)
+        i3wm->batch_counts = TRUE;
+    else
+        update_window_counts(i3wm);
+}
+
+/**
+ * append_window_changes:
+ * @i3wm: the window manager delegate struct
+ * @changes: the change set
+ *
+ * Bring the window count and the classes of every workspace in line with the
+ * index and record a WINDOWS change for every workspace which changed.
+ */
+static void
+append_window_changes(i3windowManager *i3wm, GArray *changes)
+{
+    i3wm->batch_counts = FALSE;
+
+    GSList *witem;
+    for (witem = i3wm->wlist; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        gint count = -1;
+        gchar **classes = NULL;
+
+        if (i3wm->track_windows)
+        {
+            count = get_window_count(i3wm, workspace->id);
+            classes = get_window_classes(i3wm, workspace->id);
+        }
+
+        if (workspace->windows != count || !classes_equal(workspace->classes, classes))
+        {
+            i3wmChange *change = append_change(changes, I3WM_CHANGE_WINDOWS, workspace);
+            change->old_count = workspace->windows;
+            change->new_count = workspace->windows = count;
+
+            g_strfreev(workspace->classes);
+            workspace->classes = classes;
+        }
+        else
+        {
+            g_strfreev(classes);
+        }
+    }
+}
+
+/**
+ * update_title:
+ * @i3wm: the window manager delegate struct
+ * @change: the kind of window change
+ * @container: the window of the event
+ *
+ * Follow the focus and the title of the focused window.
+ */
+static void
+update_title(i3windowManager *i3wm, const gchar *change, JsonObject *container)
+{
+    gint64 id = json_object_get_int_member(container, "id");
+    const gchar *name = json_object_has_member(container, "name") ?
+        json_object_get_string_member(container, "name") : NULL;
+
+    if (strcmp(change, "focus") == 0)
+    {
+        set_title(i3wm, id, name);
+    }
+    else if (strcmp(change, "title") == 0)
+    {
+        if (id == i3wm->focused_window)
+            set_title(i3wm, id, name);
+    }
+    else if (strcmp(change, "close") == 0)
+    {
+        if (id == i3wm->focused_window)
+            set_title(i3wm, 0, NULL);
+    }
+}
+
+/**
+ * clear_title_if_empty:
+ * @i3wm: the window manager delegate struct
+ * @change: the kind of workspace change
+ * @event: the workspace event
+ *
+ * Focusing an empty workspace focuses no window, so no window event tells
+ * that the focused window lost the focus.
+ */
+static void
+clear_title_if_empty(i3windowManager *i3wm, const gchar *change, JsonObject *event)
+{
+    if (!i3wm->track_title || strcmp(change, "focus") != 0 ||
+            !json_object_has_member(event, "current"))
+        return;
+
+    JsonObject *current = json_object_get_object_member(event, "current");
+    if (current == NULL)
+        return;
+
+    JsonArray *nodes = json_object_has_member(current, "nodes") ?
+        json_object_get_array_member(current, "nodes") : NULL;
+    JsonArray *floating = json_object_has_member(current, "floating_nodes") ?
+        json_object_get_array_member(current, "floating_nodes") : NULL;
+
+    if ((nodes == NULL || json_array_get_length(nodes) == 0) &&
+            (floating == NULL || json_array_get_length(floating) == 0))
+        set_title(i3wm, 0, NULL);
+}
+
+/**
+ * set_title:
+ * @i3wm: the window manager delegate struct
+ * @window: the container id of the focused window, 0 for none
+ * @title: its title or NULL
+ *
+ * Remember the focused window and report its title.
+ */
+static void
+set_title(i3windowManager *i3wm, gint64 window, const gchar *title)
+{
+    i3wm->focused_window = window;
+    i3w_stats.title_changes++;
+
+    if (i3wm->on_title_changed.function)
+        i3wm->on_title_changed.function(title, i3wm->on_title_changed.data);
+}
+
+/**
+ * disconnect:
+ * @i3wm: the window manager delegate struct
+ *
+ * Close both connections, keeping the workspace model.
+ */
+static void
+disconnect(i3windowManager *i3wm)
+{
+    stop_tick_probe(i3wm);
+    i3wm->subscribed = 0;
+
+    // the index is rebuilt once connected again
+    i3wm->focused_window = 0;
+    if (i3wm->index_source)
+    {
+        g_source_remove(i3wm->index_source);
+        i3wm->index_source = 0;
+    }
+    g_hash_table_remove_all(i3wm->window_index);
+    g_hash_table_remove_all(i3wm->window_counts);
+    g_hash_table_remove_all(i3wm->window_classes);
+    g_hash_table_remove_all(i3wm->window_titles);
+
+    if (i3wm->sync_source)
+    {
+        g_source_remove(i3wm->sync_source);
+        i3wm->sync_source = 0;
+        i3wm->sync_renames = FALSE;
+    }
+    i3wm->in_batch = FALSE;
+    i3wm->batch_sync = FALSE;
+    i3wm->batch_counts = FALSE;
+
+    if (i3wm->events)
+    {
+        i3wm_ipc_free(i3wm->events);
+        i3wm->events = NULL;
+    }
+
+    if (i3wm->connection)
+    {
+        g_object_unref(i3wm->connection);
+        i3wm->connection = NULL;
+    }
+}
+
+/**
+ * on_ipc_closed:
+ * @i3w: the window manager delegate struct
+ *
+ * The window manager closed the event connection: drop the connections,
+ * keeping the workspace model until the delegate is connected again, and
+ * pass it on to the ipc shutdown callback.
+ */
+static void
+on_ipc_closed(gpointer i3w)
+{
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+
+    disconnect(i3wm);
+
     if (i3wm->on_ipc_shutdown)
         i3wm->on_ipc_shutdown(i3wm->on_ipc_shutdown_data);
 }
@@ -21,26 +21,68 @@
 
 #include <i3ipc-glib/i3ipc-glib.h>
 
+#include "i3wm-ipc.h"
+#include "i3wm-trace.h"
+
+/* how often the IPC round trip is probed with a tick, when enabled */
+#define I3WM_TICK_PROBE_INTERVAL_MS 2000
+
 typedef struct _i3workspace
 {
+    gint64 id;
     gint num;
     gchar *name;
     gboolean focused;
     gboolean urgent;
     gboolean visible;
     gchar *output;
+    gint windows; // -1 while the windows are not tracked
+    gchar **classes; // sorted window classes, NULL while not tracked
 } i3workspace;
 
-typedef void (*i3wmWorkspaceCallback) (gpointer data);
-typedef void (*i3wmModeCallback_fun) (gchar *mode, gpointer data);
+typedef enum
+{
+    I3WM_CHANGE_ADDED,
+    I3WM_CHANGE_REMOVED,
+    I3WM_CHANGE_RENAMED,
+    I3WM_CHANGE_MOVED,
+    I3WM_CHANGE_FOCUSED,
+    I3WM_CHANGE_URGENT,
+    I3WM_CHANGE_VISIBLE,
+    I3WM_CHANGE_WINDOWS
+} i3wmChangeType;
+
+/*
+ * A single change of the workspace model.
+ * RENAMED carries the old and new name, MOVED the old and new output in
+ * old_value/new_value; FOCUSED, URGENT and VISIBLE carry the old and new flag
+ * in old_state/new_state; WINDOWS carries the old and new window count in
+ * old_count/new_count, the new classes are in the workspace. A REMOVED
+ * workspace and the values are only valid for the duration of the callback.
+ */
+typedef struct _i3wm_change
+{
+    i3wmChangeType type;
+    i3workspace *workspace;
+    gchar *old_value;
+    const gchar *new_value;
+    gboolean old_state;
+    gboolean new_state;
+    gint old_count;
+    gint new_count;
+} i3wmChange;
+
+typedef void (*i3wmWorkspacesCallback_fun) (GArray *changes, guint64 generation, gpointer data);
+typedef void (*i3wmModeCallback_fun) (gchar *mode, gboolean pango_markup, gpointer data);
 typedef void (*i3wmOutputCallback_fun) (gchar *mode, gpointer data);
+typedef void (*i3wmTitleCallback_fun) (const gchar *title, gpointer data);
 typedef void (*i3wmIpcShutdownCallback) (gpointer data);
 
-typedef struct _i3wm_callback
+typedef struct _i3wm_workspaces_callback
 {
-    i3wmWorkspaceCallback function;
+    i3wmWorkspacesCallback_fun function;
     gpointer data;
-} i3wmCallback;
+} i3wmWorkspacesCallback;
 
 typedef struct _i3wm_mode_callback
 {
@@ -54,21 +96,64 @@ typedef struct _i3wm_output_callback
     gpointer data;
 } i3wmOutputCallback;
 
+typedef struct _i3wm_title_callback
+{
+    i3wmTitleCallback_fun function;
+    gpointer data;
+} i3wmTitleCallback;
+
 typedef struct _i3windowManager
 {
     i3ipcConnection *connection;
+    i3wmIpc *events;
+    i3wmTrace *trace;
+    Display *display; // to find the socket on, see i3wm_set_display
     GSList *wlist;
+    guint64 generation;
 
-    i3wmCallback on_workspace_created;
-    i3wmCallback on_workspace_destroyed;
-    i3wmCallback on_workspace_blurred;
-    i3wmCallback on_workspace_focused;
-    i3wmCallback on_workspace_urgent;
-    i3wmCallback on_workspace_renamed;
+    i3wmWorkspacesCallback on_workspaces_changed;
     i3wmModeCallback on_mode_changed;
     i3wmOutputCallback on_output_changed;
+    i3wmTitleCallback on_title_changed;
     i3wmIpcShutdownCallback on_ipc_shutdown;
     gpointer on_ipc_shutdown_data;
+
+    // event types subscribed to on the event connection, 1 << type each;
+    // i3 cannot unsubscribe, so the events no longer wanted are dropped
+    guint subscribed;
+
+    // binding mode, see i3wm_set_mode_tracking
+    gboolean track_mode;
+
+    // IPC round trip probe, see i3wm_set_tick_probe
+    guint tick_interval;
+    guint tick_source;
+    guint32 tick_sequence;
+    gint64 tick_sent;
+    gint64 rtt;
+
+    // workspace fetches are coalesced over this window while i3 is slow
+    guint coalesce_ms;
+    guint sync_source;
+    gboolean sync_renames;
+
+    // the events read in one wakeup are applied together: a single fetch
+    // and a single report of the window counts once the last one is read
+    gboolean in_batch;
+    gboolean batch_sync;
+    gboolean batch_counts;
+
+    // window index, see i3wm_set_window_tracking
+    gboolean track_windows;
+    GHashTable *window_index;
+    GHashTable *window_counts;
+    GHashTable *window_classes;
+    GHashTable *window_titles;
+    guint index_source;
+
+    // focused window, see i3wm_set_title_tracking
+    gboolean track_title;
+    gint64 focused_window;
 }
 i3windowManager;
 
@@ -76,43 +161,64 @@ i3windowManager;
 i3windowManager *
 i3wm_construct(GError **err);
 
+i3windowManager *
+i3wm_new(void);
+
+void
+i3wm_seed_workspaces(i3windowManager *i3wm, GSList *wlist);
+
+gboolean
+i3wm_connect(i3windowManager *i3wm, GError **err);
+
+gboolean
+i3wm_is_connected(i3windowManager *i3wm);
+
 void
 i3wm_destruct(i3windowManager *i3wm);
 
 GSList *
 i3wm_get_workspaces(i3windowManager *i3wm);
 
+guint64
+i3wm_get_generation(i3windowManager *i3wm);
+
 gint
 i3wm_workspace_cmp(const i3workspace *a, const i3workspace *b);
 
 void
-i3wm_set_on_workspace_created(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data);
+i3wm_set_on_workspaces_changed(i3windowManager *i3wm, i3wmWorkspacesCallback_fun callback, gpointer data);
 
 void
-i3wm_set_on_workspace_destroyed(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data);
+i3wm_set_on_mode_changed(i3windowManager *i3wm, i3wmModeCallback_fun callback, gpointer data);
 
 void
-i3wm_set_on_workspace_blurred(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data);
+i3wm_set_on_output_changed(i3windowManager *i3wm, i3wmOutputCallback_fun callback, gpointer data);
 
 void
-i3wm_set_on_workspace_focused(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data);
+i3wm_set_on_title_changed(i3windowManager *i3wm, i3wmTitleCallback_fun callback, gpointer data);
 
 void
-i3wm_set_on_workspace_urgent(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data);
+i3wm_set_on_ipc_shutdown(i3windowManager *i3wm, i3wmIpcShutdownCallback callback, gpointer data);
 
 void
-i3wm_set_on_workspace_renamed(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data);
+i3wm_set_display(i3windowManager *i3wm, Display *display);
 
 void
-i3wm_set_on_mode_changed(i3windowManager *i3wm, i3wmModeCallback_fun callback, gpointer data);
+i3wm_goto_workspace(i3windowManager *i3wm, i3workspace *workspace, GError **err);
 
 void
-i3wm_set_on_output_changed(i3windowManager *i3wm, i3wmOutputCallback_fun callback, gpointer data);
+i3wm_set_tick_probe(i3windowManager *i3wm, guint interval_ms);
 
 void
-i3wm_set_on_ipc_shutdown(i3windowManager *i3wm, i3wmIpcShutdownCallback callback, gpointer data);
+i3wm_set_window_tracking(i3windowManager *i3wm, gboolean enabled);
 
 void
-i3wm_goto_workspace(i3windowManager *i3wm, i3workspace *workspace, GError **err);
+i3wm_set_title_tracking(i3windowManager *i3wm, gboolean enabled);
+
+void
+i3wm_set_mode_tracking(i3windowManager *i3wm, gboolean enabled);
+
+gchar **
+i3wm_get_window_titles(i3windowManager *i3wm, i3workspace *workspace);
 
 #endif /* !__I3W_DELEGATE_H__ */
@@ -0,0 +1,448 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "i3wm-ipc.h"
+
+#define I3_IPC_MAGIC "i3-ipc"
+
+struct _i3wmIpc
+{
+    GSocket *socket;
+    GSource *source;
+    GByteArray *buffer; // kept across wakeups, only its length is reset
+
+    i3wmIpcEventCallback on_event;
+    gpointer on_event_data;
+    i3wmIpcBatchCallback on_batch;
+    gpointer on_batch_data;
+    i3wmIpcClosedCallback on_closed;
+    gpointer on_closed_data;
+};
+
+/*
+ * Prototypes
+ */
+static gboolean
+send_message(GSocket *socket, guint32 type, const gchar *payload, GError **err);
+static gchar *
+receive_reply(GSocket *socket, guint32 type, GError **err);
+static gboolean
+on_socket_data(GSocket *socket, GIOCondition condition, gpointer data);
+static gboolean
+drain_socket(i3wmIpc *ipc);
+static guint
+dispatch_events(i3wmIpc *ipc);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3wm_ipc_get_socket_path:
+ * @display: the X display i3 runs on, or NULL to only honor I3SOCK
+ * @err: the error object
+ *
+ * Find the socket of the running window manager: I3SOCK if it is set, else
+ * the I3_SOCKET_PATH property i3 sets on the X root window. Nothing is
+ * spawned and no connection is opened, so it is cheap enough to retry
+ * while i3 is not running.
+ *
+ * Returns: the socket path or NULL
+ */
+gchar *
+i3wm_ipc_get_socket_path(Display *display, GError **err)
+{
+    const gchar *env = g_getenv("I3SOCK");
+    if (env && *env)
+        return g_strdup(env);
+
+    // the atom only exists once i3 ran on the display
+    Atom atom = display ? XInternAtom(display, "I3_SOCKET_PATH", True) : None;
+    gchar *path = NULL;
+
+    Atom type;
+    int format;
+    unsigned long items, remaining;
+    unsigned char *value = NULL;
+    if (atom != None &&
+            XGetWindowProperty(display, DefaultRootWindow(display), atom, 0, PATH_MAX,
+                False, AnyPropertyType, &type, &format, &items, &remaining,
+                &value) == Success && value && format == 8 && items > 0)
+        path = g_strndup((const gchar *) value, items);
+
+    if (value)
+        XFree(value);
+
+    if (path == NULL)
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                "Cannot find the i3 socket");
+
+    return path;
+}
+
+/**
+ * i3wm_ipc_new:
+ * @socket_path: the socket of the window manager
+ * @events: the JSON array of event names to subscribe to
+ * @err: the error object
+ *
+ * Connect to the window manager and subscribe to the events. The events are
+ * dispatched from the default main context at I3WM_IPC_PRIORITY.
+ *
+ * Returns: the event connection or NULL
+ */
+i3wmIpc *
+i3wm_ipc_new(const gchar *socket_path, const gchar *events, GError **err)
+{
+    GError *tmp_err = NULL;
+
+    GSocket *socket = g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM,
+            G_SOCKET_PROTOCOL_DEFAULT, &tmp_err);
+    if (tmp_err == NULL)
+    {
+        GSocketAddress *address = g_unix_socket_address_new(socket_path);
+        g_socket_connect(socket, address, NULL, &tmp_err);
+        g_object_unref(address);
+    }
+
+    gchar *reply = NULL;
+    if (tmp_err == NULL && send_message(socket, I3WM_IPC_SUBSCRIBE, events, &tmp_err))
+        reply = receive_reply(socket, I3WM_IPC_SUBSCRIBE, &tmp_err);
+
+    if (reply && strstr(reply, "\"success\":true") == NULL)
+    {
+        g_set_error(&tmp_err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "Cannot subscribe to %s: %s", events, reply);
+    }
+    g_free(reply);
+
+    if (tmp_err != NULL)
+    {
+        g_propagate_error(err, tmp_err);
+        if (socket)
+            g_object_unref(socket);
+        return NULL;
+    }
+
+    i3wmIpc *ipc = g_new0(i3wmIpc, 1);
+    ipc->socket = socket;
+    ipc->buffer = g_byte_array_sized_new(I3WM_IPC_READ_SIZE);
+
+    ipc->source = g_socket_create_source(socket, G_IO_IN | G_IO_HUP | G_IO_ERR, NULL);
+    g_source_set_callback(ipc->source, (GSourceFunc) on_socket_data, ipc, NULL);
+    g_source_set_priority(ipc->source, I3WM_IPC_PRIORITY);
+    g_source_attach(ipc->source, NULL);
+
+    return ipc;
+}
+
+/**
+ * i3wm_ipc_free:
+ * @ipc: the event connection
+ *
+ * Close the connection. It is safe to call from the closed callback.
+ */
+void
+i3wm_ipc_free(i3wmIpc *ipc)
+{
+    g_source_destroy(ipc->source);
+    g_source_unref(ipc->source);
+    g_socket_close(ipc->socket, NULL);
+    g_object_unref(ipc->socket);
+    g_byte_array_free(ipc->buffer, TRUE);
+    g_free(ipc);
+}
+
+/**
+ * i3wm_ipc_set_event_callback:
+ * @ipc: the event connection
+ * @callback: the callback
+ * @data: the data to be passed to the callback function
+ *
+ * Set the callback receiving every event.
+ */
+void
+i3wm_ipc_set_event_callback(i3wmIpc *ipc, i3wmIpcEventCallback callback, gpointer data)
+{
+    ipc->on_event = callback;
+    ipc->on_event_data = data;
+}
+
+/**
+ * i3wm_ipc_set_batch_callback:
+ * @ipc: the event connection
+ * @callback: the callback
+ * @data: the data to be passed to the callback function
+ *
+ * Set the callback invoked once the events read in a wakeup were passed to
+ * the event callback, with their number.
+ */
+void
+i3wm_ipc_set_batch_callback(i3wmIpc *ipc, i3wmIpcBatchCallback callback, gpointer data)
+{
+    ipc->on_batch = callback;
+    ipc->on_batch_data = data;
+}
+
+/**
+ * i3wm_ipc_set_closed_callback:
+ * @ipc: the event connection
+ * @callback: the callback
+ * @data: the data to be passed to the callback function
+ *
+ * Set the callback invoked when the window manager closes the connection.
+ */
+void
+i3wm_ipc_set_closed_callback(i3wmIpc *ipc, i3wmIpcClosedCallback callback, gpointer data)
+{
+    ipc->on_closed = callback;
+    ipc->on_closed_data = data;
+}
+
+/**
+ * i3wm_ipc_send:
+ * @ipc: the event connection
+ * @type: the message type
+ * @payload: the payload
+ * @err: the error object
+ *
+ * Send a message without waiting for the reply. Replies arriving on the
+ * event connection are dropped, so this is only useful for messages whose
+ * effect is an event, like SEND_TICK, or an additional SUBSCRIBE.
+ *
+ * Returns: TRUE if sent
+ */
+gboolean
+i3wm_ipc_send(i3wmIpc *ipc, guint32 type, const gchar *payload, GError **err)
+{
+    return send_message(ipc->socket, type, payload, err);
+}
+
+/*
+ * Implementations of private functions
+ */
+
+static gboolean
+send_message(GSocket *socket, guint32 type, const gchar *payload, GError **err)
+{
+    guint32 length = strlen(payload);
+    GByteArray *frame = g_byte_array_sized_new(I3WM_IPC_HEADER_SIZE + length);
+
+    g_byte_array_append(frame, (const guint8 *) I3_IPC_MAGIC, strlen(I3_IPC_MAGIC));
+    g_byte_array_append(frame, (const guint8 *) &length, sizeof(length));
+    g_byte_array_append(frame, (const guint8 *) &type, sizeof(type));
+    g_byte_array_append(frame, (const guint8 *) payload, length);
+
+    gsize sent = 0;
+    while (sent < frame->len)
+    {
+        gssize n = g_socket_send(socket, (const gchar *) frame->data + sent,
+                frame->len - sent, NULL, err);
+        if (n < 0)
+            break;
+        sent += n;
+    }
+
+    gboolean complete = sent == frame->len;
+    g_byte_array_free(frame, TRUE);
+
+    return complete;
+}
+
+/**
+ * receive_reply:
+ * @socket: a blocking socket
+ * @type: the expected message type
+ * @err: the error object
+ *
+ * Read the reply to a message. Only used before the subscription is active,
+ * so no event can come first.
+ *
+ * Returns: the payload or NULL
+ */
+static gchar *
+receive_reply(GSocket *socket, guint32 type, GError **err)
+{
+    gchar header[I3WM_IPC_HEADER_SIZE];
+    guint32 length, reply_type;
+    gsize received = 0;
+
+    while (received < sizeof(header))
+    {
+        gssize n = g_socket_receive(socket, header + received,
+                sizeof(header) - received, NULL, err);
+        if (n <= 0)
+        {
+            if (n == 0)
+                g_set_error(err, G_IO_ERROR, G_IO_ERROR_CLOSED, "Connection closed");
+            return NULL;
+        }
+        received += n;
+    }
+
+    memcpy(&length, header + 6, sizeof(length));
+    memcpy(&reply_type, header + 6 + sizeof(length), sizeof(reply_type));
+    if (memcmp(header, I3_IPC_MAGIC, strlen(I3_IPC_MAGIC)) != 0 || reply_type != type)
+    {
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Unexpected reply");
+        return NULL;
+    }
+
+    gchar *payload = g_malloc(length + 1);
+    received = 0;
+    while (received < length)
+    {
+        gssize n = g_socket_receive(socket, payload + received,
+                length - received, NULL, err);
+        if (n <= 0)
+        {
+            if (n == 0)
+                g_set_error(err, G_IO_ERROR, G_IO_ERROR_CLOSED, "Connection closed");
+            g_free(payload);
+            return NULL;
+        }
+        received += n;
+    }
+    payload[length] = '\0';
+
+    return payload;
+}
+
+/**
+ * on_socket_data:
+ * @socket: the event socket
+ * @condition: the condition
+ * @data: the event connection
+ *
+ * Read everything pending, dispatch every complete event frame and then
+ * close the batch. Events which arrived before the connection was closed
+ * are still dispatched.
+ *
+ * Returns: FALSE once the connection is closed
+ */
+static gboolean
+on_socket_data(GSocket *socket, GIOCondition condition, gpointer data)
+{
+    i3wmIpc *ipc = (i3wmIpc *) data;
+
+    gboolean open = drain_socket(ipc);
+
+    guint events = dispatch_events(ipc);
+    if (events > 0 && ipc->on_batch)
+        ipc->on_batch(events, ipc->on_batch_data);
+
+    if (!open)
+    {
+        // the callback may free the connection, don't touch it afterwards
+        if (ipc->on_closed)
+            ipc->on_closed(ipc->on_closed_data);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * drain_socket:
+ * @ipc: the event connection
+ *
+ * Append everything pending on the socket to the buffer, without blocking,
+ * reading straight into the buffer. A wakeup reads at most
+ * I3WM_IPC_MAX_BATCH_SIZE, the rest is left for the next one.
+ *
+ * Returns: FALSE if the connection was closed
+ */
+static gboolean
+drain_socket(i3wmIpc *ipc)
+{
+    GError *tmp_err = NULL;
+    gsize total = 0;
+
+    while (total < I3WM_IPC_MAX_BATCH_SIZE)
+    {
+        guint len = ipc->buffer->len;
+        g_byte_array_set_size(ipc->buffer, len + I3WM_IPC_READ_SIZE);
+
+        gssize n = g_socket_receive_with_blocking(ipc->socket,
+                (gchar *) ipc->buffer->data + len, I3WM_IPC_READ_SIZE,
+                FALSE, NULL, &tmp_err);
+        g_byte_array_set_size(ipc->buffer, len + MAX(n, 0));
+
+        if (n == 0)
+            return FALSE;
+        if (n < 0)
+        {
+            gboolean open = g_error_matches(tmp_err, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK);
+            g_error_free(tmp_err);
+            return open;
+        }
+
+        total += n;
+
+        // a short read emptied the socket, spare the call failing with EAGAIN
+        if (n < I3WM_IPC_READ_SIZE)
+            break;
+    }
+
+    return TRUE;
+}
+
+/**
+ * dispatch_events:
+ * @ipc: the event connection
+ *
+ * Pass every complete event frame in the buffer to the event callback and
+ * keep the incomplete rest. Replies are dropped.
+ *
+ * Returns: the number of events passed
+ */
+static guint
+dispatch_events(i3wmIpc *ipc)
+{
+    guint events = 0;
+    gsize offset = 0;
+    while (ipc->buffer->len - offset >= I3WM_IPC_HEADER_SIZE)
+    {
+        const guint8 *frame = ipc->buffer->data + offset;
+        guint32 length, type;
+
+        memcpy(&length, frame + 6, sizeof(length));
+        memcpy(&type, frame + 6 + sizeof(length), sizeof(type));
+        if (ipc->buffer->len - offset - I3WM_IPC_HEADER_SIZE < length)
+            break;
+
+        if ((type & I3WM_IPC_EVENT_BIT) && ipc->on_event)
+        {
+            ipc->on_event(type & ~I3WM_IPC_EVENT_BIT,
+                    (const gchar *) frame + I3WM_IPC_HEADER_SIZE, length,
+                    ipc->on_event_data);
+            events++;
+        }
+
+        offset += I3WM_IPC_HEADER_SIZE + length;
+    }
+
+    g_byte_array_remove_range(ipc->buffer, 0, offset);
+
+    return events;
+}
@@ -0,0 +1,84 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3WM_IPC_H__
+#define __I3WM_IPC_H__
+
+#include <glib.h>
+#include <X11/Xlib.h>
+
+/*
+ * The event side of the i3 IPC protocol: a connection of its own which
+ * subscribes to events and hands every event frame to a callback as it
+ * arrives, without parsing it. Everything pending on the socket is read in
+ * one wakeup; the batch callback follows the last event of the wakeup.
+ */
+
+/* magic, payload length and message type */
+#define I3WM_IPC_HEADER_SIZE (6 + 2 * sizeof(guint32))
+
+#define I3WM_IPC_EVENT_BIT 0x80000000
+
+#define I3WM_IPC_EVENT_WORKSPACE 0
+#define I3WM_IPC_EVENT_OUTPUT 1
+#define I3WM_IPC_EVENT_MODE 2
+#define I3WM_IPC_EVENT_WINDOW 3
+#define I3WM_IPC_EVENT_SHUTDOWN 6
+#define I3WM_IPC_EVENT_TICK 7
+
+#define I3WM_IPC_GET_WORKSPACES 1
+#define I3WM_IPC_SUBSCRIBE 2
+#define I3WM_IPC_GET_TREE 4
+#define I3WM_IPC_SEND_TICK 10
+
+/* events are read ahead of input and drawing, so the model stays current */
+#define I3WM_IPC_PRIORITY G_PRIORITY_HIGH
+
+/* the socket is read in chunks of this size, up to the limit per wakeup */
+#define I3WM_IPC_READ_SIZE 16384
+#define I3WM_IPC_MAX_BATCH_SIZE (64 * I3WM_IPC_READ_SIZE)
+
+typedef struct _i3wmIpc i3wmIpc;
+
+/* type is the event type without the event bit, payload is not terminated */
+typedef void (*i3wmIpcEventCallback) (guint32 type, const gchar *payload, gsize length, gpointer data);
+typedef void (*i3wmIpcBatchCallback) (guint events, gpointer data);
+typedef void (*i3wmIpcClosedCallback) (gpointer data);
+
+gchar *
+i3wm_ipc_get_socket_path(Display *display, GError **err);
+
+i3wmIpc *
+i3wm_ipc_new(const gchar *socket_path, const gchar *events, GError **err);
+
+void
+i3wm_ipc_free(i3wmIpc *ipc);
+
+void
+i3wm_ipc_set_event_callback(i3wmIpc *ipc, i3wmIpcEventCallback callback, gpointer data);
+
+void
+i3wm_ipc_set_batch_callback(i3wmIpc *ipc, i3wmIpcBatchCallback callback, gpointer data);
+
+void
+i3wm_ipc_set_closed_callback(i3wmIpc *ipc, i3wmIpcClosedCallback callback, gpointer data);
+
+gboolean
+i3wm_ipc_send(i3wmIpc *ipc, guint32 type, const gchar *payload, GError **err);
+
+#endif /* !__I3WM_IPC_H__ */
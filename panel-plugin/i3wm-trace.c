@@ -0,0 +1,218 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <gio/gio.h>
+
+#include "i3wm-trace.h"
+
+#define TRACE_MAGIC "I3TR"
+#define TRACE_VERSION 1
+
+struct _i3wmTrace
+{
+    FILE *file;
+    gint64 start;
+};
+
+struct _i3wmTraceReader
+{
+    GMappedFile *mapped;
+    const gchar *data;
+    gsize length;
+    gsize offset;
+};
+
+/*
+ * Prototypes
+ */
+static void
+write_uint32(FILE *file, guint32 value);
+static gboolean
+read_uint32(i3wmTraceReader *reader, guint32 *value);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3wm_trace_new:
+ * @path: the trace file, truncated if it exists
+ * @err: the error object
+ *
+ * Start a trace.
+ *
+ * Returns: the trace or NULL
+ */
+i3wmTrace *
+i3wm_trace_new(const gchar *path, GError **err)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        g_set_error(err, G_FILE_ERROR, g_file_error_from_errno(errno),
+                "Cannot open %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+
+    fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), file);
+    write_uint32(file, TRACE_VERSION);
+
+    i3wmTrace *trace = g_new0(i3wmTrace, 1);
+    trace->file = file;
+    trace->start = g_get_monotonic_time();
+
+    return trace;
+}
+
+/**
+ * i3wm_trace_record:
+ * @trace: the trace
+ * @type: the message type, with the event bit for events
+ * @payload: the payload
+ * @length: the length of the payload
+ *
+ * Append a message to the trace. Every message is flushed, so the trace
+ * survives a panel which is killed in the middle of a stall.
+ */
+void
+i3wm_trace_record(i3wmTrace *trace, guint32 type, const gchar *payload, gsize length)
+{
+    guint64 time = GUINT64_TO_LE(g_get_monotonic_time() - trace->start);
+
+    fwrite(&time, sizeof(time), 1, trace->file);
+    write_uint32(trace->file, type);
+    write_uint32(trace->file, length);
+    fwrite(payload, 1, length, trace->file);
+    fflush(trace->file);
+}
+
+/**
+ * i3wm_trace_free:
+ * @trace: the trace
+ *
+ * Close the trace file.
+ */
+void
+i3wm_trace_free(i3wmTrace *trace)
+{
+    fclose(trace->file);
+    g_free(trace);
+}
+
+/**
+ * i3wm_trace_reader_new:
+ * @path: the trace file
+ * @err: the error object
+ *
+ * Open a trace for reading.
+ *
+ * Returns: the reader or NULL
+ */
+i3wmTraceReader *
+i3wm_trace_reader_new(const gchar *path, GError **err)
+{
+    GMappedFile *mapped = g_mapped_file_new(path, FALSE, err);
+    if (!mapped)
+        return NULL;
+
+    i3wmTraceReader *reader = g_new0(i3wmTraceReader, 1);
+    reader->mapped = mapped;
+    reader->data = g_mapped_file_get_contents(mapped);
+    reader->length = g_mapped_file_get_length(mapped);
+    reader->offset = strlen(TRACE_MAGIC);
+
+    guint32 version;
+    if (reader->length < reader->offset ||
+            memcmp(reader->data, TRACE_MAGIC, reader->offset) != 0 ||
+            !read_uint32(reader, &version) || version != TRACE_VERSION)
+    {
+        g_set_error(err, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "%s is not a trace of a supported version", path);
+        i3wm_trace_reader_free(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+/**
+ * i3wm_trace_reader_next:
+ * @reader: the reader
+ * @record: the record to fill, the payload points into the mapped file
+ *
+ * Read the next message. A truncated last message is ignored.
+ *
+ * Returns: FALSE at the end of the trace
+ */
+gboolean
+i3wm_trace_reader_next(i3wmTraceReader *reader, i3wmTraceRecord *record)
+{
+    guint32 time_low, time_high, length;
+
+    if (!read_uint32(reader, &time_low) || !read_uint32(reader, &time_high) ||
+            !read_uint32(reader, &record->type) || !read_uint32(reader, &length) ||
+            reader->length - reader->offset < length)
+        return FALSE;
+
+    record->time = ((guint64) time_high << 32) | time_low;
+    record->payload = reader->data + reader->offset;
+    record->length = length;
+    reader->offset += length;
+
+    return TRUE;
+}
+
+/**
+ * i3wm_trace_reader_free:
+ * @reader: the reader
+ *
+ * Close the reader, invalidating the payloads it returned.
+ */
+void
+i3wm_trace_reader_free(i3wmTraceReader *reader)
+{
+    g_mapped_file_unref(reader->mapped);
+    g_free(reader);
+}
+
+/*
+ * Implementations of private functions
+ */
+
+static void
+write_uint32(FILE *file, guint32 value)
+{
+    value = GUINT32_TO_LE(value);
+    fwrite(&value, sizeof(value), 1, file);
+}
+
+static gboolean
+read_uint32(i3wmTraceReader *reader, guint32 *value)
+{
+    if (reader->length - reader->offset < sizeof(*value))
+        return FALSE;
+
+    memcpy(value, reader->data + reader->offset, sizeof(*value));
+    *value = GUINT32_FROM_LE(*value);
+    reader->offset += sizeof(*value);
+
+    return TRUE;
+}
@@ -0,0 +1,67 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3WM_TRACE_H__
+#define __I3WM_TRACE_H__
+
+#include <glib.h>
+
+/*
+ * A trace of the IPC messages the delegate received: the events and the
+ * GET_WORKSPACES replies, with the time they arrived. Written when the
+ * I3_WORKSPACES_TRACE environment variable names a file, read back by the
+ * replay tool.
+ *
+ * File layout, all integers little endian:
+ *
+ *   "I3TR" | guint32 version
+ *   per message: guint64 time in microseconds since the start
+ *                | guint32 type, with the event bit for events
+ *                | guint32 len | payload
+ */
+
+typedef struct _i3wmTrace i3wmTrace;
+typedef struct _i3wmTraceReader i3wmTraceReader;
+
+typedef struct _i3wmTraceRecord
+{
+    guint64 time;
+    guint32 type;
+    const gchar *payload;
+    gsize length;
+} i3wmTraceRecord;
+
+i3wmTrace *
+i3wm_trace_new(const gchar *path, GError **err);
+
+void
+i3wm_trace_record(i3wmTrace *trace, guint32 type, const gchar *payload, gsize length);
+
+void
+i3wm_trace_free(i3wmTrace *trace);
+
+i3wmTraceReader *
+i3wm_trace_reader_new(const gchar *path, GError **err);
+
+gboolean
+i3wm_trace_reader_next(i3wmTraceReader *reader, i3wmTraceRecord *record);
+
+void
+i3wm_trace_reader_free(i3wmTraceReader *reader);
+
+#endif /* !__I3WM_TRACE_H__ */
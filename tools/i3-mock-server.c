@@ -0,0 +1,205 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs the mock i3 IPC server driven by a script, one command per line:
+ *
+ *   output NAME X Y WIDTH HEIGHT
+ *   workspace NAME OUTPUT
+ *   remove NAME
+ *   focus NAME
+ *   urgent NAME 0|1
+ *   rename OLD NEW
+ *   move NAME OUTPUT
+ *   mode NAME [markup]
+ *   output-changed
+ *   window NAME [WORKSPACE]   (open on the focused workspace by default)
+ *   close-window NAME
+ *   move-window NAME WORKSPACE
+ *   delay MESSAGE_TYPE MS
+ *   sleep MS
+ *   rate HZ            (pause between the following state changes)
+ *   wait-client        (block until a client subscribed to events)
+ *   shutdown           (drop all client connections)
+ *
+ * Lines starting with '#' are comments. Point the plugin at the server by
+ * starting the panel with I3SOCK set to the printed socket path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "mock-i3.h"
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void
+on_signal(int signum);
+static gboolean
+run_command(MockI3 *mock, gchar **argv, guint *pause_us);
+
+int
+main(int argc, char *argv[])
+{
+    gchar *socket_path = NULL;
+    gchar *script = NULL;
+    GError *err = NULL;
+
+    GOptionEntry entries[] =
+    {
+        { "socket", 's', 0, G_OPTION_ARG_FILENAME, &socket_path,
+            "Listen on PATH", "PATH" },
+        { "script", 'f', 0, G_OPTION_ARG_FILENAME, &script,
+            "Read the commands from FILE instead of stdin", "FILE" },
+        { NULL }
+    };
+
+    GOptionContext *context = g_option_context_new("- mock i3 IPC server");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &err))
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    FILE *input = script ? fopen(script, "r") : stdin;
+    if (!input)
+    {
+        fprintf(stderr, "Cannot open %s\n", script);
+        return 1;
+    }
+
+    MockI3 *mock = mock_i3_new(socket_path, &err);
+    if (!mock)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    printf("%s\n", mock_i3_get_socket_path(mock));
+    fflush(stdout);
+
+    gchar line[1024];
+    guint lineno = 0, pause_us = 0;
+    while (!interrupted && fgets(line, sizeof(line), input))
+    {
+        lineno++;
+        g_strstrip(line);
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        gchar **cmd = g_strsplit_set(line, " \t", -1);
+        if (!run_command(mock, cmd, &pause_us))
+            fprintf(stderr, "line %u: cannot parse '%s'\n", lineno, line);
+        g_strfreev(cmd);
+    }
+
+    if (input != stdin)
+        fclose(input);
+
+    while (!interrupted)
+        g_usleep(100 * 1000);
+
+    mock_i3_free(mock);
+    g_free(socket_path);
+    g_free(script);
+
+    return 0;
+}
+
+static void
+on_signal(int signum)
+{
+    interrupted = 1;
+}
+
+/*
+ * Returns: FALSE if the command is not understood
+ */
+static gboolean
+run_command(MockI3 *mock, gchar **argv, guint *pause_us)
+{
+    guint argc = g_strv_length(argv);
+    const gchar *cmd = argv[0];
+    gboolean state_change = TRUE;
+
+    if (g_strcmp0(cmd, "output") == 0 && argc == 6)
+        mock_i3_add_output(mock, argv[1], atoi(argv[2]), atoi(argv[3]),
+                atoi(argv[4]), atoi(argv[5]));
+    else if (g_strcmp0(cmd, "workspace") == 0 && argc == 3)
+        mock_i3_add_workspace(mock, argv[1], argv[2]);
+    else if (g_strcmp0(cmd, "remove") == 0 && argc == 2)
+        mock_i3_remove_workspace(mock, argv[1]);
+    else if (g_strcmp0(cmd, "focus") == 0 && argc == 2)
+        mock_i3_focus_workspace(mock, argv[1]);
+    else if (g_strcmp0(cmd, "urgent") == 0 && argc == 3)
+        mock_i3_set_urgent(mock, argv[1], atoi(argv[2]) != 0);
+    else if (g_strcmp0(cmd, "rename") == 0 && argc == 3)
+        mock_i3_rename_workspace(mock, argv[1], argv[2]);
+    else if (g_strcmp0(cmd, "move") == 0 && argc == 3)
+        mock_i3_move_workspace(mock, argv[1], argv[2]);
+    else if (g_strcmp0(cmd, "mode") == 0 && (argc == 2 || argc == 3))
+        mock_i3_set_mode(mock, argv[1], argc == 3 && g_strcmp0(argv[2], "markup") == 0);
+    else if (g_strcmp0(cmd, "output-changed") == 0 && argc == 1)
+        mock_i3_output_changed(mock);
+    else if (g_strcmp0(cmd, "window") == 0 && (argc == 2 || argc == 3))
+        mock_i3_open_window(mock, argv[1], argc == 3 ? argv[2] : NULL);
+    else if (g_strcmp0(cmd, "close-window") == 0 && argc == 2)
+        mock_i3_close_window(mock, argv[1]);
+    else if (g_strcmp0(cmd, "move-window") == 0 && argc == 3)
+        mock_i3_move_window(mock, argv[1], argv[2]);
+    else if (g_strcmp0(cmd, "shutdown") == 0 && argc == 1)
+        mock_i3_disconnect_clients(mock);
+    else
+    {
+        state_change = FALSE;
+
+        if (g_strcmp0(cmd, "delay") == 0 && argc == 3)
+        {
+            gint type = mock_i3_message_type_from_string(argv[1]);
+            if (type < 0)
+                return FALSE;
+            mock_i3_set_reply_delay(mock, type, atoi(argv[2]));
+        }
+        else if (g_strcmp0(cmd, "sleep") == 0 && argc == 2)
+            g_usleep(atoi(argv[1]) * 1000);
+        else if (g_strcmp0(cmd, "rate") == 0 && argc == 2)
+        {
+            gint hz = atoi(argv[1]);
+            *pause_us = hz > 0 ? G_USEC_PER_SEC / hz : 0;
+        }
+        else if (g_strcmp0(cmd, "wait-client") == 0 && argc == 1)
+        {
+            while (!interrupted && mock_i3_get_subscriber_count(mock) == 0)
+                g_usleep(10 * 1000);
+        }
+        else
+            return FALSE;
+    }
+
+    if (state_change && *pause_us)
+        g_usleep(*pause_us);
+
+    return TRUE;
+}
@@ -0,0 +1,277 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays a trace recorded with I3_WORKSPACES_TRACE through the mock i3
+ * server. Every event is pushed again and the GET_WORKSPACES request it
+ * caused is answered with the recorded reply, so the delegate sees exactly
+ * what it saw when the trace was recorded.
+ *
+ * By default the trace is fed into a delegate running in this process and
+ * the time it took is reported. With --serve the tool only serves the trace;
+ * start a panel with I3SOCK set to the printed socket path to replay it
+ * into the plugin.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mock-i3.h"
+#include "i3wm-delegate.h"
+#include "i3wm-trace.h"
+
+/* how long to wait for the delegate to fetch the workspaces after an event */
+#define FETCH_TIMEOUT_US (G_USEC_PER_SEC)
+
+typedef struct
+{
+    MockI3 *mock;
+    GArray *records;
+    gboolean fast;
+    gdouble speed;
+
+    GMainLoop *loop;
+    guint events;
+    gint64 elapsed;
+} Replay;
+
+typedef struct
+{
+    guint callbacks;
+    guint changes;
+} DelegateStats;
+
+static gpointer
+run_replay(gpointer data);
+static gboolean
+quit_loop(gpointer data);
+static const i3wmTraceRecord *
+next_reply(GArray *records, guint index);
+static void
+on_workspaces_changed(GArray *changes, guint64 generation, gpointer data);
+static void
+on_mode_changed(gchar *mode, gboolean pango_markup, gpointer data);
+
+int
+main(int argc, char *argv[])
+{
+    gboolean fast = FALSE, serve = FALSE;
+    gdouble speed = 1.0;
+    GError *err = NULL;
+
+    GOptionEntry entries[] =
+    {
+        { "fast", 'f', 0, G_OPTION_ARG_NONE, &fast,
+            "Replay as fast as the delegate consumes the events", NULL },
+        { "speed", 's', 0, G_OPTION_ARG_DOUBLE, &speed,
+            "Scale the original timing by FACTOR", "FACTOR" },
+        { "serve", 0, 0, G_OPTION_ARG_NONE, &serve,
+            "Only serve the trace to an external client", NULL },
+        { NULL }
+    };
+
+    GOptionContext *context = g_option_context_new("TRACE - replay an i3 event trace");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &err) || argc != 2)
+    {
+        fprintf(stderr, "%s\n", err ? err->message : "Expected a trace file");
+        return 1;
+    }
+    g_option_context_free(context);
+
+    i3wmTraceReader *reader = i3wm_trace_reader_new(argv[1], &err);
+    if (!reader)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    Replay replay = { 0 };
+    replay.records = g_array_new(FALSE, FALSE, sizeof(i3wmTraceRecord));
+    replay.fast = fast;
+    replay.speed = speed > 0 ? speed : 1.0;
+
+    i3wmTraceRecord record;
+    while (i3wm_trace_reader_next(reader, &record))
+        g_array_append_val(replay.records, record);
+
+    replay.mock = mock_i3_new(NULL, &err);
+    if (!replay.mock)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    // the reply to the initial fetch of the recorded connection
+    const i3wmTraceRecord *reply = next_reply(replay.records, 0);
+    if (reply)
+        mock_i3_set_reply(replay.mock, MOCK_I3_GET_WORKSPACES, reply->payload, reply->length);
+
+    DelegateStats stats = { 0 };
+    i3windowManager *i3wm = NULL;
+
+    replay.loop = g_main_loop_new(NULL, FALSE);
+
+    if (serve)
+    {
+        printf("%s\n", mock_i3_get_socket_path(replay.mock));
+        fflush(stdout);
+    }
+    else
+    {
+        g_setenv("I3SOCK", mock_i3_get_socket_path(replay.mock), TRUE);
+        g_unsetenv("I3_WORKSPACES_TRACE");
+
+        i3wm = i3wm_new();
+        i3wm_set_on_workspaces_changed(i3wm, on_workspaces_changed, &stats);
+        i3wm_set_on_mode_changed(i3wm, on_mode_changed, NULL);
+        if (!i3wm_connect(i3wm, &err))
+        {
+            fprintf(stderr, "%s\n", err->message);
+            return 1;
+        }
+    }
+
+    GThread *thread = g_thread_new("replay", run_replay, &replay);
+    g_main_loop_run(replay.loop);
+    g_thread_join(thread);
+
+    printf("events: %u\n", replay.events);
+    printf("workspace fetches: %" G_GUINT64_FORMAT "\n",
+            mock_i3_get_message_count(replay.mock, MOCK_I3_GET_WORKSPACES));
+    printf("elapsed: %.3f ms\n", replay.elapsed / 1000.0);
+    if (replay.elapsed > 0)
+        printf("rate: %.0f events/s\n", replay.events * (gdouble) G_USEC_PER_SEC / replay.elapsed);
+    if (i3wm)
+    {
+        printf("change callbacks: %u\n", stats.callbacks);
+        printf("changes: %u\n", stats.changes);
+        i3wm_destruct(i3wm);
+    }
+
+    mock_i3_free(replay.mock);
+    g_main_loop_unref(replay.loop);
+    g_array_free(replay.records, TRUE);
+    i3wm_trace_reader_free(reader);
+
+    return 0;
+}
+
+/*
+ * Push the recorded events in the replay thread while the main loop runs
+ * the delegate.
+ */
+static gpointer
+run_replay(gpointer data)
+{
+    Replay *replay = (Replay *) data;
+    guint64 first = 0;
+    gint64 start = 0;
+    guint i;
+
+    while (mock_i3_get_subscriber_count(replay->mock) == 0)
+        g_usleep(1000);
+
+    for (i = 0; i < replay->records->len; i++)
+    {
+        const i3wmTraceRecord *record = &g_array_index(replay->records, i3wmTraceRecord, i);
+        if (!(record->type & MOCK_I3_EVENT_BIT))
+            continue;
+
+        if (replay->events == 0)
+        {
+            first = record->time;
+            start = g_get_monotonic_time();
+        }
+        else if (!replay->fast)
+        {
+            gint64 due = start + (gint64) ((record->time - first) / replay->speed);
+            gint64 now = g_get_monotonic_time();
+            if (due > now)
+                g_usleep(due - now);
+        }
+
+        // a reply recorded before the next event was fetched because of
+        // this one
+        const i3wmTraceRecord *reply = next_reply(replay->records, i + 1);
+        guint64 fetched = mock_i3_get_message_count(replay->mock, MOCK_I3_GET_WORKSPACES);
+        if (reply)
+            mock_i3_set_reply(replay->mock, MOCK_I3_GET_WORKSPACES, reply->payload, reply->length);
+
+        gchar *payload = g_strndup(record->payload, record->length);
+        mock_i3_send_event(replay->mock, record->type & ~MOCK_I3_EVENT_BIT, payload);
+        g_free(payload);
+        replay->events++;
+
+        // keep the fixed reply until it was fetched
+        if (reply)
+        {
+            gint64 timeout = g_get_monotonic_time() + FETCH_TIMEOUT_US;
+            while (mock_i3_get_message_count(replay->mock, MOCK_I3_GET_WORKSPACES) == fetched &&
+                    g_get_monotonic_time() < timeout)
+                g_usleep(50);
+        }
+    }
+
+    replay->elapsed = replay->events ? g_get_monotonic_time() - start : 0;
+
+    g_idle_add(quit_loop, replay->loop);
+
+    return NULL;
+}
+
+static gboolean
+quit_loop(gpointer data)
+{
+    g_main_loop_quit((GMainLoop *) data);
+    return FALSE;
+}
+
+/*
+ * Returns: the first reply at or after index which precedes the next event,
+ * or NULL
+ */
+static const i3wmTraceRecord *
+next_reply(GArray *records, guint index)
+{
+    guint i;
+    for (i = index; i < records->len; i++)
+    {
+        const i3wmTraceRecord *record = &g_array_index(records, i3wmTraceRecord, i);
+        if (record->type & MOCK_I3_EVENT_BIT)
+            return NULL;
+        if (record->type == MOCK_I3_GET_WORKSPACES)
+            return record;
+    }
+
+    return NULL;
+}
+
+static void
+on_workspaces_changed(GArray *changes, guint64 generation, gpointer data)
+{
+    DelegateStats *stats = (DelegateStats *) data;
+
+    stats->callbacks++;
+    stats->changes += changes->len;
+}
+
+static void
+on_mode_changed(gchar *mode, gboolean pango_markup, gpointer data)
+{
+}
@@ -0,0 +1,361 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of the workspace model hot paths, at 10 to 10000
+ * workspaces with numbered, named and mixed names. Reports the time and the
+ * heap allocations per operation.
+ *
+ * The delegate is compiled into this file, so its private functions can be
+ * measured directly. Allocations are counted by wrapping malloc, only in the
+ * thread running the benchmark.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../panel-plugin/i3wm-delegate.c"
+#include "i3w-labels.h"
+#include "i3w-multi-monitor-utils.h"
+#include "mock-i3.h"
+
+#define BENCH_TIME_US (200 * 1000)
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static __thread guint64 allocations = 0;
+
+void *
+malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size)
+{
+    allocations++;
+    return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+typedef enum
+{
+    NAMES_NUMBERED,
+    NAMES_NAMED,
+    NAMES_MIXED
+} NameKind;
+
+static const gchar *name_kinds[] = { "numbered", "named", "mixed" };
+
+typedef struct
+{
+    guint count;
+    NameKind kind;
+    GPtrArray *workspaces;
+    GSList *list;
+
+    i3WorkspacesConfig config;
+    i3_workspaces_outputs_t outputs;
+
+    i3windowManager *i3wm;
+    gchar *reply;
+} Bench;
+
+typedef void (*BenchFunc) (Bench *bench);
+
+static void
+run_bench(const gchar *name, Bench *bench, guint ops_per_call, BenchFunc func);
+static gchar *
+make_name(NameKind kind, guint i);
+static void
+setup(Bench *bench, MockI3 *mock);
+static void
+teardown(Bench *bench);
+
+static void
+bench_parse(Bench *bench);
+static void
+bench_sync_cold(Bench *bench);
+static void
+bench_sync_warm(Bench *bench);
+static void
+bench_sort(Bench *bench);
+static void
+bench_strip(Bench *bench);
+static void
+bench_label(Bench *bench);
+static void
+bench_monitor(Bench *bench);
+
+int
+main(int argc, char *argv[])
+{
+    static const guint counts[] = { 10, 100, 1000, 10000 };
+    guint c, k;
+
+    // count the GLib allocations too
+    g_setenv("G_SLICE", "always-malloc", TRUE);
+
+    printf("%-14s %-9s %6s %14s %12s\n", "benchmark", "names", "count", "ns/op", "allocs/op");
+
+    for (c = 0; c < G_N_ELEMENTS(counts); c++)
+    {
+        for (k = NAMES_NUMBERED; k <= NAMES_MIXED; k++)
+        {
+            GError *err = NULL;
+            MockI3 *mock = mock_i3_new(NULL, &err);
+            if (!mock)
+            {
+                fprintf(stderr, "%s\n", err->message);
+                return 1;
+            }
+
+            Bench bench = { 0 };
+            bench.count = counts[c];
+            bench.kind = k;
+            setup(&bench, mock);
+
+            run_bench("parse", &bench, 1, bench_parse);
+            run_bench("sync-cold", &bench, 1, bench_sync_cold);
+            run_bench("sync-warm", &bench, 1, bench_sync_warm);
+            run_bench("sort", &bench, 1, bench_sort);
+            run_bench("strip-number", &bench, bench.count, bench_strip);
+            run_bench("label-markup", &bench, bench.count, bench_label);
+            run_bench("monitor-at", &bench, bench.count, bench_monitor);
+
+            teardown(&bench);
+            mock_i3_free(mock);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Call func until BENCH_TIME_US passed and report the averages per
+ * operation.
+ */
+static void
+run_bench(const gchar *name, Bench *bench, guint ops_per_call, BenchFunc func)
+{
+    guint64 iterations = 0;
+
+    func(bench);
+
+    guint64 allocations_start = allocations;
+    gint64 start = g_get_monotonic_time();
+    gint64 elapsed;
+    do
+    {
+        func(bench);
+        iterations++;
+        elapsed = g_get_monotonic_time() - start;
+    }
+    while (elapsed < BENCH_TIME_US);
+
+    gdouble ops = (gdouble) iterations * ops_per_call;
+    printf("%-14s %-9s %6u %14.1f %12.2f\n", name, name_kinds[bench->kind], bench->count,
+            elapsed * 1000.0 / ops, (allocations - allocations_start) / ops);
+}
+
+static gchar *
+make_name(NameKind kind, guint i)
+{
+    static const gchar *words[] = { "web", "mail", "term", "chat", "music", "code" };
+    const gchar *word = words[i % G_N_ELEMENTS(words)];
+
+    switch (kind)
+    {
+        case NAMES_NUMBERED:
+            return g_strdup_printf("%u", i + 1);
+        case NAMES_NAMED:
+            return g_strdup_printf("%s-%u", word, i + 1);
+        default:
+            return i % 3 == 0 ?
+                g_strdup_printf("%s-%u", word, i + 1) :
+                g_strdup_printf("%u:%s", i + 1, word);
+    }
+}
+
+static void
+setup(Bench *bench, MockI3 *mock)
+{
+    guint i;
+
+    mock_i3_add_output(mock, "DP-1", 0, 0, 1920, 1080);
+    bench->workspaces = g_ptr_array_new();
+    for (i = 0; i < bench->count; i++)
+    {
+        gchar *name = make_name(bench->kind, i);
+        mock_i3_add_workspace(mock, name, "DP-1");
+
+        i3workspace *workspace = g_new0(i3workspace, 1);
+        workspace->name = name;
+        workspace->num = ws_name_to_number(name);
+        workspace->output = g_strdup("DP-1");
+        workspace->focused = i == 0;
+        workspace->visible = i == 0;
+        workspace->urgent = i % 7 == 3;
+        workspace->windows = -1;
+        g_ptr_array_add(bench->workspaces, workspace);
+        bench->list = g_slist_prepend(bench->list, workspace);
+    }
+
+    // a fixed shuffle, so every sort starts from the same order
+    GRand *rand = g_rand_new_with_seed(42);
+    for (i = bench->count; i > 1; i--)
+    {
+        guint j = g_rand_int_range(rand, 0, i);
+        gpointer tmp = bench->workspaces->pdata[i - 1];
+        bench->workspaces->pdata[i - 1] = bench->workspaces->pdata[j];
+        bench->workspaces->pdata[j] = tmp;
+    }
+    g_rand_free(rand);
+
+    bench->config.normal_color = 0xffffff;
+    bench->config.focused_color = 0x00ff00;
+    bench->config.visible_color = 0xaaaaaa;
+    bench->config.urgent_color = 0xff0000;
+    bench->config.strip_workspace_numbers = TRUE;
+
+    // a row of monitors, one per workspace
+    bench->outputs.num_outputs = bench->count;
+    bench->outputs.outputs = g_new0(i3_workspaces_output_t, bench->count);
+    for (i = 0; i < bench->count; i++)
+    {
+        bench->outputs.outputs[i].x = i * 1920;
+        bench->outputs.outputs[i].width = 1920;
+        bench->outputs.outputs[i].height = 1080;
+        bench->outputs.outputs[i].name = g_strdup_printf("DP-%u", i + 1);
+    }
+
+    // a delegate with only the request connection, syncing on demand
+    GError *err = NULL;
+    bench->i3wm = i3wm_new();
+    bench->i3wm->connection = i3ipc_connection_new(mock_i3_get_socket_path(mock), &err);
+    if (err)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        exit(1);
+    }
+    bench->reply = i3ipc_connection_message(bench->i3wm->connection,
+            I3IPC_MESSAGE_TYPE_GET_WORKSPACES, "", NULL);
+}
+
+static void
+teardown(Bench *bench)
+{
+    guint i;
+
+    i3wm_destruct(bench->i3wm);
+    g_free(bench->reply);
+
+    g_slist_free(bench->list);
+    g_ptr_array_foreach(bench->workspaces, (GFunc) destroy_workspace, NULL);
+    g_ptr_array_free(bench->workspaces, TRUE);
+
+    for (i = 0; i < bench->outputs.num_outputs; i++)
+        g_free(bench->outputs.outputs[i].name);
+    g_free(bench->outputs.outputs);
+}
+
+/* parse a GET_WORKSPACES reply */
+static void
+bench_parse(Bench *bench)
+{
+    GSList *wlist = parse_workspaces(bench->reply, strlen(bench->reply), NULL);
+    g_slist_free_full(wlist, (GDestroyNotify) destroy_workspace);
+}
+
+/* fetch the workspaces into an empty model, every workspace is added */
+static void
+bench_sync_cold(Bench *bench)
+{
+    g_slist_free_full(bench->i3wm->wlist, (GDestroyNotify) destroy_workspace);
+    bench->i3wm->wlist = NULL;
+    sync_workspaces(bench->i3wm, FALSE, NULL);
+}
+
+/* fetch the workspaces again, nothing changed */
+static void
+bench_sync_warm(Bench *bench)
+{
+    sync_workspaces(bench->i3wm, TRUE, NULL);
+}
+
+/* sort the workspaces, starting from the same shuffled order every time */
+static void
+bench_sort(Bench *bench)
+{
+    GSList *item;
+    guint i;
+
+    for (item = bench->list, i = 0; item != NULL; item = item->next, i++)
+        item->data = bench->workspaces->pdata[i];
+
+    bench->list = g_slist_sort(bench->list, (GCompareFunc) i3wm_workspace_cmp);
+}
+
+static void
+bench_strip(Bench *bench)
+{
+    guint i;
+    for (i = 0; i < bench->count; i++)
+    {
+        i3workspace *workspace = (i3workspace *) bench->workspaces->pdata[i];
+        g_free(i3_workspaces_strip_number(workspace->name, workspace->num));
+    }
+}
+
+static void
+bench_label(Bench *bench)
+{
+    guint i;
+    for (i = 0; i < bench->count; i++)
+    {
+        i3workspace *workspace = (i3workspace *) bench->workspaces->pdata[i];
+        gchar *name = i3_workspaces_label_name(workspace, &bench->config);
+        g_free(i3_workspaces_label_markup(workspace, name, &bench->config, TRUE));
+        g_free(name);
+    }
+}
+
+/* look up points spread over all monitors */
+static void
+bench_monitor(Bench *bench)
+{
+    guint i;
+    for (i = 0; i < bench->count; i++)
+    {
+        const char *name = get_monitor_name_at(bench->outputs,
+                (i * 7919 % bench->count) * 1920 + 10, 10);
+        if (name == NULL)
+            abort();
+    }
+}
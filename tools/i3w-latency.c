@@ -0,0 +1,451 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * End-to-end latency of the plugin: loads the built plugin module, shows it
+ * in a window and feeds it focus, rename and output events from the mock i3
+ * server at increasing rates. For every event it measures the time from
+ * writing the event to the socket until a plugin widget is drawn showing its
+ * effect, and reports p50, p99 and max, and the widgets created and
+ * destroyed per event.
+ *
+ * Needs an X server, run it under Xvfb:
+ *
+ *   xvfb-run tools/i3w-latency
+ *
+ * An event whose effect is replaced by a later event before it was drawn is
+ * counted as coalesced, not measured.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+
+#include "mock-i3.h"
+#include "plugin-host.h"
+
+#define PLUGIN_ID 1
+#define WORKSPACES 10
+#define HIDDEN_OUTPUT "HIDDEN-1"
+#define STARTUP_TIMEOUT_US (5 * G_USEC_PER_SEC)
+
+typedef enum
+{
+    SCENARIO_FOCUS,
+    SCENARIO_RENAME,
+    SCENARIO_OUTPUT
+} Scenario;
+
+static const gchar *scenario_names[] = { "focus", "rename", "output" };
+
+typedef struct
+{
+    gint64 injected;
+    Scenario scenario;
+    guint index;
+    gchar *name;
+    gboolean shown;
+} PendingEvent;
+
+typedef struct
+{
+    MockI3 *mock;
+    GtkWidget *plugin;
+    gchar *output;
+
+    gchar *names[WORKSPACES];
+    gboolean shown[WORKSPACES];
+    guint renames;
+
+    /* the running phase */
+    Scenario scenario;
+    guint rate;
+    guint events;
+    guint injected;
+    gint64 start;
+    GQueue *pending;
+    GArray *latencies;
+    guint coalesced;
+    guint created;
+    guint destroyed;
+    GMainLoop *loop;
+} Latency;
+
+static void
+run_phase(Latency *latency, Scenario scenario, guint rate);
+static gboolean
+inject_due_events(gpointer data);
+static void
+inject_event(Latency *latency);
+static gboolean
+finish_phase(gpointer data);
+static void
+report_phase(Latency *latency);
+
+static gboolean
+is_effect_drawn(Latency *latency, PendingEvent *event);
+static void
+free_pending_event(PendingEvent *event);
+
+static gboolean
+on_expose_hook(GSignalInvocationHint *hint, guint n_params,
+        const GValue *params, gpointer data);
+static gboolean
+on_parent_set_hook(GSignalInvocationHint *hint, guint n_params,
+        const GValue *params, gpointer data);
+static gboolean
+on_destroy_hook(GSignalInvocationHint *hint, guint n_params,
+        const GValue *params, gpointer data);
+
+static gint
+compare_doubles(gconstpointer a, gconstpointer b);
+
+int
+main(int argc, char *argv[])
+{
+    gchar *plugin_path = NULL;
+    gint events = 200;
+    GError *err = NULL;
+    guint i;
+
+    GOptionEntry entries[] =
+    {
+        { "plugin", 'p', 0, G_OPTION_ARG_FILENAME, &plugin_path,
+            "Load the plugin module from PATH", "PATH" },
+        { "events", 'n', 0, G_OPTION_ARG_INT, &events,
+            "Inject N events per scenario and rate", "N" },
+        { NULL }
+    };
+
+    // keep the plugin's configuration away from the user's
+    PluginHost *host = plugin_host_new(&err);
+    if (!host)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    if (!gtk_init_with_args(&argc, &argv, "- plugin event latency", entries, NULL, &err))
+    {
+        fprintf(stderr, "%s, run under xvfb-run\n", err ? err->message : "Cannot open the display");
+        return 1;
+    }
+
+    // name the mock output like the X output the plugin is on
+    Latency latency = { 0 };
+    latency.output = plugin_host_get_output_name();
+
+    latency.mock = mock_i3_new(NULL, &err);
+    if (!latency.mock)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    mock_i3_add_output(latency.mock, latency.output, 0, 0,
+            gdk_screen_width(), gdk_screen_height());
+    mock_i3_add_output(latency.mock, HIDDEN_OUTPUT, gdk_screen_width(), 0, 1920, 1080);
+    for (i = 0; i < WORKSPACES; i++)
+    {
+        latency.names[i] = g_strdup_printf("%u", i + 1);
+        latency.shown[i] = TRUE;
+        mock_i3_add_workspace(latency.mock, latency.names[i], latency.output);
+    }
+    g_setenv("I3SOCK", mock_i3_get_socket_path(latency.mock), TRUE);
+
+    if (!plugin_host_load(host, plugin_path, &err))
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    // show only the output the mock workspaces are on, so moves are visible
+    gchar *rc = g_strdup_printf("output=%s\n", latency.output);
+    latency.plugin = plugin_host_add(host, PLUGIN_ID, rc);
+    g_free(rc);
+
+    gint64 timeout = g_get_monotonic_time() + STARTUP_TIMEOUT_US;
+    while (mock_i3_get_subscriber_count(latency.mock) == 0 ||
+            !gtk_widget_get_mapped(latency.plugin))
+    {
+        if (g_get_monotonic_time() > timeout)
+        {
+            fprintf(stderr, "The plugin did not connect to the mock server\n");
+            return 1;
+        }
+        g_main_context_iteration(NULL, FALSE);
+        g_usleep(1000);
+    }
+    while (gtk_events_pending())
+        gtk_main_iteration();
+
+    g_signal_add_emission_hook(g_signal_lookup("expose-event", GTK_TYPE_WIDGET), 0,
+            on_expose_hook, &latency, NULL);
+    g_signal_add_emission_hook(g_signal_lookup("parent-set", GTK_TYPE_WIDGET), 0,
+            on_parent_set_hook, &latency, NULL);
+    g_signal_add_emission_hook(g_signal_lookup("destroy", GTK_TYPE_OBJECT), 0,
+            on_destroy_hook, &latency, NULL);
+
+    latency.events = MAX(events, 1);
+    latency.pending = g_queue_new();
+    latency.latencies = g_array_new(FALSE, FALSE, sizeof(gdouble));
+
+    static const guint rates[] = { 10, 100, 1000, 10000 };
+    Scenario scenario;
+    printf("%-7s %6s %7s %9s %10s %10s %10s %9s %9s\n", "event", "rate", "painted",
+            "coalesced", "p50 us", "p99 us", "max us", "created", "destroyed");
+    for (scenario = SCENARIO_FOCUS; scenario <= SCENARIO_OUTPUT; scenario++)
+    {
+        for (i = 0; i < G_N_ELEMENTS(rates); i++)
+            run_phase(&latency, scenario, rates[i]);
+    }
+
+    g_queue_free(latency.pending);
+    g_array_free(latency.latencies, TRUE);
+    plugin_host_free(host);
+    mock_i3_free(latency.mock);
+    g_free(plugin_path);
+
+    return 0;
+}
+
+/*
+ * Inject the events of a scenario at the rate and wait until the plugin
+ * settled.
+ */
+static void
+run_phase(Latency *latency, Scenario scenario, guint rate)
+{
+    latency->scenario = scenario;
+    latency->rate = rate;
+    latency->injected = 0;
+    latency->coalesced = 0;
+    latency->created = 0;
+    latency->destroyed = 0;
+    g_array_set_size(latency->latencies, 0);
+    latency->loop = g_main_loop_new(NULL, FALSE);
+
+    latency->start = g_get_monotonic_time();
+    g_timeout_add(MAX(1, 1000 / rate), inject_due_events, latency);
+    g_main_loop_run(latency->loop);
+
+    report_phase(latency);
+
+    g_queue_foreach(latency->pending, (GFunc) free_pending_event, NULL);
+    g_queue_clear(latency->pending);
+    g_main_loop_unref(latency->loop);
+}
+
+static gboolean
+inject_due_events(gpointer data)
+{
+    Latency *latency = (Latency *) data;
+
+    guint64 due = (g_get_monotonic_time() - latency->start) * latency->rate / G_USEC_PER_SEC + 1;
+    while (latency->injected < MIN(due, latency->events))
+        inject_event(latency);
+
+    if (latency->injected < latency->events)
+        return TRUE;
+
+    // everything the plugin does for the last event runs before this
+    g_idle_add_full(G_PRIORITY_LOW, finish_phase, latency, NULL);
+    return FALSE;
+}
+
+/*
+ * Change the mock state, which pushes the event, and remember what the
+ * plugin has to show for it. Earlier events with the same effect are
+ * coalesced.
+ */
+static void
+inject_event(Latency *latency)
+{
+    PendingEvent *event = g_new0(PendingEvent, 1);
+    guint n = latency->injected++;
+    GList *item, *next;
+
+    event->scenario = latency->scenario;
+    event->index = n % WORKSPACES;
+
+    for (item = latency->pending->head; item != NULL; item = next)
+    {
+        PendingEvent *other = (PendingEvent *) item->data;
+        next = item->next;
+        if (other->scenario == SCENARIO_FOCUS || other->index == event->index)
+        {
+            latency->coalesced++;
+            free_pending_event(other);
+            g_queue_delete_link(latency->pending, item);
+        }
+    }
+
+    event->injected = g_get_monotonic_time();
+
+    switch (latency->scenario)
+    {
+        case SCENARIO_FOCUS:
+            event->index = (n + 1) % WORKSPACES;
+            event->name = g_strdup(latency->names[event->index]);
+            mock_i3_focus_workspace(latency->mock, event->name);
+            break;
+        case SCENARIO_RENAME:
+            // keep the number, so the order does not change
+            event->name = g_strdup_printf("%u:r%u", event->index + 1, ++latency->renames);
+            mock_i3_rename_workspace(latency->mock, latency->names[event->index], event->name);
+            g_free(latency->names[event->index]);
+            latency->names[event->index] = g_strdup(event->name);
+            break;
+        case SCENARIO_OUTPUT:
+            event->name = g_strdup(latency->names[event->index]);
+            event->shown = latency->shown[event->index] = !latency->shown[event->index];
+            mock_i3_move_workspace(latency->mock, event->name,
+                    event->shown ? latency->output : HIDDEN_OUTPUT);
+            mock_i3_output_changed(latency->mock);
+            break;
+    }
+
+    g_queue_push_tail(latency->pending, event);
+}
+
+static gboolean
+finish_phase(gpointer data)
+{
+    Latency *latency = (Latency *) data;
+    g_main_loop_quit(latency->loop);
+    return FALSE;
+}
+
+static void
+report_phase(Latency *latency)
+{
+    GArray *values = latency->latencies;
+    gdouble p50 = 0, p99 = 0, max = 0;
+
+    if (values->len > 0)
+    {
+        g_array_sort(values, compare_doubles);
+        p50 = g_array_index(values, gdouble, (values->len - 1) / 2);
+        p99 = g_array_index(values, gdouble, MIN(values->len - 1, (guint) (values->len * 0.99)));
+        max = g_array_index(values, gdouble, values->len - 1);
+    }
+
+    printf("%-7s %6u %7u %9u %10.0f %10.0f %10.0f %9.2f %9.2f\n",
+            scenario_names[latency->scenario], latency->rate, values->len,
+            latency->coalesced, p50, p99, max,
+            (gdouble) latency->created / latency->injected,
+            (gdouble) latency->destroyed / latency->injected);
+
+    if (!g_queue_is_empty(latency->pending))
+        printf("        %u events were never drawn\n", g_queue_get_length(latency->pending));
+}
+
+static gboolean
+is_effect_drawn(Latency *latency, PendingEvent *event)
+{
+    GtkWidget *button = plugin_host_find_button(latency->plugin, event->name);
+
+    switch (event->scenario)
+    {
+        case SCENARIO_FOCUS:
+        {
+            if (button == NULL)
+                return FALSE;
+            GtkWidget *label = g_object_get_data(G_OBJECT(button), "i3w-label");
+            return strstr(gtk_label_get_label(GTK_LABEL(label)), "weight=\"bold\"") != NULL;
+        }
+        case SCENARIO_RENAME:
+            return button != NULL;
+        case SCENARIO_OUTPUT:
+            return (button != NULL) == event->shown;
+    }
+
+    return FALSE;
+}
+
+static void
+free_pending_event(PendingEvent *event)
+{
+    g_free(event->name);
+    g_free(event);
+}
+
+/*
+ * Every expose of a plugin widget may be the one drawing a pending event.
+ */
+static gboolean
+on_expose_hook(GSignalInvocationHint *hint, guint n_params,
+        const GValue *params, gpointer data)
+{
+    Latency *latency = (Latency *) data;
+    GtkWidget *widget = GTK_WIDGET(g_value_get_object(&params[0]));
+
+    if (g_queue_is_empty(latency->pending) ||
+            (widget != latency->plugin && !gtk_widget_is_ancestor(widget, latency->plugin)))
+        return TRUE;
+
+    gint64 now = g_get_monotonic_time();
+    GList *item, *next;
+    for (item = latency->pending->head; item != NULL; item = next)
+    {
+        PendingEvent *event = (PendingEvent *) item->data;
+        next = item->next;
+        if (is_effect_drawn(latency, event))
+        {
+            gdouble us = now - event->injected;
+            g_array_append_val(latency->latencies, us);
+            free_pending_event(event);
+            g_queue_delete_link(latency->pending, item);
+        }
+    }
+
+    return TRUE;
+}
+
+/* a widget packed for the first time, as good as created */
+static gboolean
+on_parent_set_hook(GSignalInvocationHint *hint, guint n_params,
+        const GValue *params, gpointer data)
+{
+    Latency *latency = (Latency *) data;
+
+    if (n_params > 1 && g_value_get_object(&params[1]) == NULL)
+        latency->created++;
+
+    return TRUE;
+}
+
+static gboolean
+on_destroy_hook(GSignalInvocationHint *hint, guint n_params,
+        const GValue *params, gpointer data)
+{
+    Latency *latency = (Latency *) data;
+
+    if (GTK_IS_WIDGET(g_value_get_object(&params[0])))
+        latency->destroyed++;
+
+    return TRUE;
+}
+
+static gint
+compare_doubles(gconstpointer a, gconstpointer b)
+{
+    gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+    return x < y ? -1 : x > y;
+}
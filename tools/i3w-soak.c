@@ -0,0 +1,455 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Allocation soak run of the plugin: loads the built plugin module, shows it
+ * on the output of the mock i3 server and drives it through a long mix of
+ * focus, rename, urgency, mode, output, add and remove events, button clicks
+ * and scrolls. After a warmup, the live heap allocations and the heap in use
+ * must stay flat; growth beyond the limits fails the run, so leaks on the
+ * event paths show up as a non-zero exit status.
+ *
+ * Needs an X server, run it under Xvfb:
+ *
+ *   xvfb-run tools/i3w-soak
+ *
+ * "make check" runs a short one, --warmup=1000 --ops=10000, through
+ * soak-check.sh, on its own Xvfb server.
+ *
+ * Allocations are counted by wrapping the malloc family, in every thread.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <gtk/gtk.h>
+
+#include "mock-i3.h"
+#include "plugin-host.h"
+
+#define PLUGIN_ID 1
+#define WORKSPACES 10
+#define HIDDEN_OUTPUT "HIDDEN-1"
+#define EXTRA_WORKSPACE "soak"
+#define STARTUP_TIMEOUT_US (5 * G_USEC_PER_SEC)
+#define SETTLE_TIMEOUT_US (G_USEC_PER_SEC)
+#define REPORT_INTERVAL 10000
+#define SKIP_STATUS 77
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static gint64 live_allocations = 0;
+
+void *
+malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+    if (ptr)
+        __atomic_add_fetch(&live_allocations, 1, __ATOMIC_RELAXED);
+    return ptr;
+}
+
+void *
+calloc(size_t n, size_t size)
+{
+    void *ptr = __libc_calloc(n, size);
+    if (ptr)
+        __atomic_add_fetch(&live_allocations, 1, __ATOMIC_RELAXED);
+    return ptr;
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    void *new_ptr = __libc_realloc(ptr, size);
+    if (ptr == NULL && new_ptr != NULL)
+        __atomic_add_fetch(&live_allocations, 1, __ATOMIC_RELAXED);
+    else if (ptr != NULL && size == 0)
+        __atomic_sub_fetch(&live_allocations, 1, __ATOMIC_RELAXED);
+    return new_ptr;
+}
+
+void *
+memalign(size_t alignment, size_t size)
+{
+    void *ptr = __libc_memalign(alignment, size);
+    if (ptr)
+        __atomic_add_fetch(&live_allocations, 1, __ATOMIC_RELAXED);
+    return ptr;
+}
+
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int
+posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    *ptr = memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+void
+free(void *ptr)
+{
+    if (ptr)
+        __atomic_sub_fetch(&live_allocations, 1, __ATOMIC_RELAXED);
+    __libc_free(ptr);
+}
+
+typedef struct
+{
+    MockI3 *mock;
+    GtkWidget *plugin;
+    gchar *output;
+
+    gchar *names[WORKSPACES];
+    gboolean shown[WORKSPACES];
+    guint focused;
+    gboolean extra;
+    guint renames;
+    GRand *rand;
+} Soak;
+
+typedef gboolean (*SoakOp) (Soak *soak, guint n);
+
+static gboolean
+run_op(Soak *soak, guint n);
+static gboolean
+settle(Soak *soak, guint64 fetched);
+static gint64
+get_heap_in_use(void);
+
+static gboolean
+op_focus(Soak *soak, guint n);
+static gboolean
+op_rename(Soak *soak, guint n);
+static gboolean
+op_urgent(Soak *soak, guint n);
+static gboolean
+op_mode(Soak *soak, guint n);
+static gboolean
+op_output(Soak *soak, guint n);
+static gboolean
+op_add_remove(Soak *soak, guint n);
+static gboolean
+op_click(Soak *soak, guint n);
+static gboolean
+op_scroll(Soak *soak, guint n);
+
+static const SoakOp ops[] =
+{
+    op_focus, op_rename, op_urgent, op_mode,
+    op_output, op_add_remove, op_click, op_scroll
+};
+
+int
+main(int argc, char *argv[])
+{
+    gchar *plugin_path = NULL;
+    gint count = 100000, warmup = 10000;
+    gint max_allocations = 256, max_heap_kib = 256;
+    GError *err = NULL;
+    guint i;
+
+    GOptionEntry entries[] =
+    {
+        { "plugin", 'p', 0, G_OPTION_ARG_FILENAME, &plugin_path,
+            "Load the plugin module from PATH", "PATH" },
+        { "ops", 'n', 0, G_OPTION_ARG_INT, &count,
+            "Run N measured operations", "N" },
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &warmup,
+            "Run N operations before measuring", "N" },
+        { "max-allocations", 0, 0, G_OPTION_ARG_INT, &max_allocations,
+            "Fail if the live allocations grow by more than N", "N" },
+        { "max-heap", 0, 0, G_OPTION_ARG_INT, &max_heap_kib,
+            "Fail if the heap in use grows by more than KIB", "KIB" },
+        { NULL }
+    };
+
+    // count the GLib allocations too
+    g_setenv("G_SLICE", "always-malloc", TRUE);
+
+    PluginHost *host = plugin_host_new(&err);
+    if (!host)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    if (!gtk_init_with_args(&argc, &argv, "- plugin allocation soak run", entries, NULL, &err))
+    {
+        fprintf(stderr, "%s, run under xvfb-run\n", err ? err->message : "Cannot open the display");
+        if (err)
+            return 1;
+
+        // skipped by make check
+        plugin_host_free(host);
+        return SKIP_STATUS;
+    }
+
+    Soak soak = { 0 };
+    soak.output = plugin_host_get_output_name();
+    soak.rand = g_rand_new_with_seed(42);
+
+    soak.mock = mock_i3_new(NULL, &err);
+    if (!soak.mock)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    mock_i3_add_output(soak.mock, soak.output, 0, 0,
+            gdk_screen_width(), gdk_screen_height());
+    mock_i3_add_output(soak.mock, HIDDEN_OUTPUT, gdk_screen_width(), 0, 1920, 1080);
+    for (i = 0; i < WORKSPACES; i++)
+    {
+        soak.names[i] = g_strdup_printf("%u", i + 1);
+        soak.shown[i] = TRUE;
+        mock_i3_add_workspace(soak.mock, soak.names[i], soak.output);
+    }
+    g_setenv("I3SOCK", mock_i3_get_socket_path(soak.mock), TRUE);
+
+    if (!plugin_host_load(host, plugin_path, &err))
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    // detect the output, so the output events go through the XRandR lookup
+    gchar *rc = g_strdup_printf("output=%s\nauto_detect_outputs=true\n", soak.output);
+    soak.plugin = plugin_host_add(host, PLUGIN_ID, rc);
+    g_free(rc);
+
+    gint64 timeout = g_get_monotonic_time() + STARTUP_TIMEOUT_US;
+    while (mock_i3_get_subscriber_count(soak.mock) == 0 ||
+            !gtk_widget_get_mapped(soak.plugin))
+    {
+        if (g_get_monotonic_time() > timeout)
+        {
+            fprintf(stderr, "The plugin did not connect to the mock server\n");
+            return 1;
+        }
+        g_main_context_iteration(NULL, FALSE);
+        g_usleep(1000);
+    }
+
+    guint n = 0;
+    for (i = 0; i < (guint) MAX(warmup, 0); i++, n++)
+    {
+        if (!run_op(&soak, n))
+            return 1;
+    }
+
+    gint64 allocations_start = __atomic_load_n(&live_allocations, __ATOMIC_RELAXED);
+    gint64 heap_start = get_heap_in_use();
+    gint64 allocations_growth = 0, heap_growth = 0;
+
+    printf("%9s %14s %14s\n", "ops", "allocations", "heap KiB");
+    for (i = 0; i < (guint) MAX(count, 0); i++, n++)
+    {
+        if (!run_op(&soak, n))
+            return 1;
+
+        if ((i + 1) % REPORT_INTERVAL == 0 || i + 1 == (guint) count)
+        {
+            allocations_growth = __atomic_load_n(&live_allocations, __ATOMIC_RELAXED) -
+                allocations_start;
+            heap_growth = get_heap_in_use() - heap_start;
+            printf("%9u %+14" G_GINT64_FORMAT " %+14.1f\n", i + 1,
+                    allocations_growth, heap_growth / 1024.0);
+            fflush(stdout);
+        }
+    }
+
+    plugin_host_free(host);
+    mock_i3_free(soak.mock);
+    for (i = 0; i < WORKSPACES; i++)
+        g_free(soak.names[i]);
+    g_free(soak.output);
+    g_rand_free(soak.rand);
+    g_free(plugin_path);
+
+    if (allocations_growth > max_allocations || heap_growth > max_heap_kib * 1024)
+    {
+        fprintf(stderr, "Leak: %+" G_GINT64_FORMAT " allocations, %+.1f KiB over %d operations\n",
+                allocations_growth, heap_growth / 1024.0, count);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Run one operation of the mix and wait until the plugin handled it.
+ *
+ * Returns: FALSE if the plugin did not react in time
+ */
+static gboolean
+run_op(Soak *soak, guint n)
+{
+    guint64 fetched = mock_i3_get_message_count(soak->mock, MOCK_I3_GET_WORKSPACES);
+
+    if (!ops[n % G_N_ELEMENTS(ops)](soak, n / G_N_ELEMENTS(ops)))
+        return TRUE;
+
+    if (!settle(soak, fetched))
+    {
+        fprintf(stderr, "The plugin did not fetch the workspaces after operation %u\n", n);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Every operation ends with an event making the plugin fetch the workspaces.
+ * The events are handled in order, so once the fetch count moved and the
+ * main loop is idle, the plugin is done with all of them.
+ */
+static gboolean
+settle(Soak *soak, guint64 fetched)
+{
+    gint64 timeout = g_get_monotonic_time() + SETTLE_TIMEOUT_US;
+
+    while (mock_i3_get_message_count(soak->mock, MOCK_I3_GET_WORKSPACES) == fetched)
+    {
+        if (g_get_monotonic_time() > timeout)
+            return FALSE;
+        if (!g_main_context_iteration(NULL, FALSE))
+            g_usleep(20);
+    }
+
+    while (g_main_context_iteration(NULL, FALSE))
+        ;
+
+    return TRUE;
+}
+
+static gint64
+get_heap_in_use(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    return (gint64) info.uordblks;
+}
+
+static gboolean
+op_focus(Soak *soak, guint n)
+{
+    soak->focused = g_rand_int_range(soak->rand, 0, WORKSPACES);
+    mock_i3_focus_workspace(soak->mock, soak->names[soak->focused]);
+    return TRUE;
+}
+
+/* keep the number, so the order does not change */
+static gboolean
+op_rename(Soak *soak, guint n)
+{
+    guint index = g_rand_int_range(soak->rand, 0, WORKSPACES);
+    gchar *name = g_strdup_printf("%u:s%u", index + 1, ++soak->renames);
+
+    mock_i3_rename_workspace(soak->mock, soak->names[index], name);
+    g_free(soak->names[index]);
+    soak->names[index] = name;
+    return TRUE;
+}
+
+static gboolean
+op_urgent(Soak *soak, guint n)
+{
+    mock_i3_set_urgent(soak->mock, soak->names[n % WORKSPACES], n % 2 == 0);
+    return TRUE;
+}
+
+/* mode events do not fetch, follow them by a focus */
+static gboolean
+op_mode(Soak *soak, guint n)
+{
+    mock_i3_set_mode(soak->mock, n % 2 ? "default" : "resize", n % 4 == 0);
+    return op_focus(soak, n);
+}
+
+static gboolean
+op_output(Soak *soak, guint n)
+{
+    guint index = n % WORKSPACES;
+
+    soak->shown[index] = !soak->shown[index];
+    mock_i3_move_workspace(soak->mock, soak->names[index],
+            soak->shown[index] ? soak->output : HIDDEN_OUTPUT);
+    mock_i3_output_changed(soak->mock);
+    return TRUE;
+}
+
+static gboolean
+op_add_remove(Soak *soak, guint n)
+{
+    if (soak->extra)
+        mock_i3_remove_workspace(soak->mock, EXTRA_WORKSPACE);
+    else
+        mock_i3_add_workspace(soak->mock, EXTRA_WORKSPACE, soak->output);
+    soak->extra = !soak->extra;
+    return TRUE;
+}
+
+/* the button sends a command, the mock focuses and pushes the event */
+static gboolean
+op_click(Soak *soak, guint n)
+{
+    guint index = g_rand_int_range(soak->rand, 0, WORKSPACES);
+    GtkWidget *button = plugin_host_find_button(soak->plugin, soak->names[index]);
+
+    if (button == NULL)
+        return FALSE;
+
+    soak->focused = index;
+    gtk_button_clicked(GTK_BUTTON(button));
+    return TRUE;
+}
+
+/*
+ * Scroll on the plugin's event box. Scrolling past the first or last
+ * workspace does nothing, so only a command sent counts as an operation.
+ */
+static gboolean
+op_scroll(Soak *soak, guint n)
+{
+    GtkWidget *ebox = gtk_bin_get_child(GTK_BIN(soak->plugin));
+    guint64 commands = mock_i3_get_message_count(soak->mock, MOCK_I3_COMMAND);
+
+    GdkEvent *event = gdk_event_new(GDK_SCROLL);
+    event->scroll.window = g_object_ref(gtk_widget_get_window(ebox));
+    event->scroll.direction = n % 2 ? GDK_SCROLL_UP : GDK_SCROLL_DOWN;
+    event->scroll.time = GDK_CURRENT_TIME;
+    gtk_widget_event(ebox, event);
+    gdk_event_free(event);
+
+    return mock_i3_get_message_count(soak->mock, MOCK_I3_COMMAND) != commands;
+}
@@ -0,0 +1,338 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Startup time of the plugin: loads the built plugin module and constructs
+ * plugin instances again and again, with the mock i3 server answering at
+ * once, answering slowly, and with no i3 to connect to, each without and
+ * with a workspace snapshot from a previous run. Reports the medians of the
+ * time construct() spends loading the configuration and the snapshot,
+ * creating the widgets and detecting the output, of the i3 IPC handshake,
+ * and of the time from entering construct() until connected and until the
+ * first workspace button is painted.
+ *
+ * Needs an X server, run it under Xvfb:
+ *
+ *   xvfb-run tools/i3w-startup
+ *
+ * The phases are recorded by the plugin itself, see i3w-startup.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gtk/gtk.h>
+
+#include "mock-i3.h"
+#include "plugin-host.h"
+#include "i3w-startup.h"
+
+#define WORKSPACES 10
+#define SLOW_REPLY_MS 200
+#define RUN_TIMEOUT_US (5 * G_USEC_PER_SEC)
+/* how long to wait for a paint after the handshake, without a snapshot and
+ * without i3 nothing is ever painted */
+#define PAINT_GRACE_US (200 * 1000)
+
+typedef enum
+{
+    I3_AVAILABLE,
+    I3_SLOW,
+    I3_ABSENT
+} Scenario;
+
+static const gchar *scenario_names[] = { "available", "slow", "absent" };
+
+typedef enum
+{
+    PHASE_CONFIG,
+    PHASE_SNAPSHOT,
+    PHASE_WIDGETS,
+    PHASE_OUTPUTS,
+    PHASE_CONSTRUCT,
+    PHASE_HANDSHAKE,
+    PHASE_CONNECTED,
+    PHASE_PAINTED,
+    PHASES
+} Phase;
+
+static const gchar *phase_names[] =
+{
+    "config", "snapshot", "widgets", "outputs",
+    "construct", "ipc", "connected", "painted"
+};
+
+typedef struct
+{
+    PluginHost *host;
+    MockI3 *mock;
+    gchar *output;
+    gchar *absent_socket;
+    gint next_id;
+
+    /* the running construction */
+    GtkWidget *plugin;
+    gint64 painted;
+} Startup;
+
+static gboolean
+run_once(Startup *startup, gint unique_id, gdouble *phases);
+static void
+report(Scenario scenario, gboolean warm, GArray **samples);
+static void
+set_scenario(Startup *startup, Scenario scenario);
+
+static gboolean
+on_expose_hook(GSignalInvocationHint *hint, guint n_params,
+        const GValue *params, gpointer data);
+
+static gint
+compare_doubles(gconstpointer a, gconstpointer b);
+
+int
+main(int argc, char *argv[])
+{
+    gchar *plugin_path = NULL;
+    gint runs = 20;
+    GError *err = NULL;
+    guint i;
+
+    GOptionEntry entries[] =
+    {
+        { "plugin", 'p', 0, G_OPTION_ARG_FILENAME, &plugin_path,
+            "Load the plugin module from PATH", "PATH" },
+        { "runs", 'n', 0, G_OPTION_ARG_INT, &runs,
+            "Construct the plugin N times per scenario", "N" },
+        { NULL }
+    };
+
+    Startup startup = { 0 };
+    startup.host = plugin_host_new(&err);
+    if (!startup.host)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    if (!gtk_init_with_args(&argc, &argv, "- plugin startup time", entries, NULL, &err))
+    {
+        fprintf(stderr, "%s, run under xvfb-run\n", err ? err->message : "Cannot open the display");
+        return 1;
+    }
+
+    startup.output = plugin_host_get_output_name();
+    startup.absent_socket = g_strdup_printf("%s/i3w-startup-%d.sock",
+            g_get_tmp_dir(), (int) getpid());
+    startup.next_id = 1;
+
+    startup.mock = mock_i3_new(NULL, &err);
+    if (!startup.mock)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    mock_i3_add_output(startup.mock, startup.output, 0, 0,
+            gdk_screen_width(), gdk_screen_height());
+    for (i = 0; i < WORKSPACES; i++)
+    {
+        gchar *name = g_strdup_printf("%u", i + 1);
+        mock_i3_add_workspace(startup.mock, name, startup.output);
+        g_free(name);
+    }
+
+    if (!plugin_host_load(startup.host, plugin_path, &err))
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+
+    g_signal_add_emission_hook(g_signal_lookup("expose-event", GTK_TYPE_WIDGET), 0,
+            on_expose_hook, &startup, NULL);
+
+    printf("%-9s %-8s", "i3", "snapshot");
+    for (i = 0; i < PHASES; i++)
+        printf(" %10s", phase_names[i]);
+    printf("\n");
+
+    GArray *samples[PHASES];
+    for (i = 0; i < PHASES; i++)
+        samples[i] = g_array_new(FALSE, FALSE, sizeof(gdouble));
+
+    Scenario scenario;
+    gboolean warm;
+    for (scenario = I3_AVAILABLE; scenario <= I3_ABSENT; scenario++)
+    {
+        for (warm = FALSE; warm <= TRUE; warm++)
+        {
+            gdouble phases[PHASES];
+            gint unique_id = startup.next_id++;
+            gint run;
+
+            for (i = 0; i < PHASES; i++)
+                g_array_set_size(samples[i], 0);
+
+            // a snapshot written while i3 answered
+            if (warm)
+            {
+                set_scenario(&startup, I3_AVAILABLE);
+                if (!run_once(&startup, unique_id, phases))
+                    return 1;
+            }
+
+            set_scenario(&startup, scenario);
+            for (run = 0; run < MAX(runs, 1); run++)
+            {
+                if (!run_once(&startup, warm ? unique_id : startup.next_id++, phases))
+                    return 1;
+                for (i = 0; i < PHASES; i++)
+                    g_array_append_val(samples[i], phases[i]);
+            }
+
+            report(scenario, warm, samples);
+        }
+    }
+
+    for (i = 0; i < PHASES; i++)
+        g_array_free(samples[i], TRUE);
+
+    plugin_host_free(startup.host);
+    mock_i3_free(startup.mock);
+    g_free(startup.absent_socket);
+    g_free(startup.output);
+    g_free(plugin_path);
+
+    return 0;
+}
+
+/*
+ * Construct a plugin, wait until it tried to connect and painted its
+ * workspaces, and remove it again.
+ *
+ * Returns: FALSE if the plugin did not start
+ */
+static gboolean
+run_once(Startup *startup, gint unique_id, gdouble *phases)
+{
+    i3WorkspacesStartup *record = NULL;
+    gint64 timeout = g_get_monotonic_time() + RUN_TIMEOUT_US;
+    gint64 attempted = 0;
+
+    gchar *rc = g_strdup_printf("output=%s\n", startup->output);
+    startup->painted = 0;
+    startup->plugin = plugin_host_add(startup->host, unique_id, rc);
+    g_free(rc);
+
+    for (;;)
+    {
+        gint64 now = g_get_monotonic_time();
+
+        record = g_object_get_data(G_OBJECT(startup->plugin), I3W_STARTUP_KEY);
+        if (record && record->ipc_attempts > 0 && attempted == 0)
+            attempted = now;
+
+        if (attempted && (startup->painted || now - attempted > PAINT_GRACE_US))
+            break;
+
+        if (now > timeout)
+        {
+            fprintf(stderr, "The plugin did not start\n");
+            return FALSE;
+        }
+
+        if (!g_main_context_iteration(NULL, FALSE))
+            g_usleep(100);
+    }
+
+    phases[PHASE_CONFIG] = record->config_load / 1000.0;
+    phases[PHASE_SNAPSHOT] = record->snapshot_load / 1000.0;
+    phases[PHASE_WIDGETS] = record->widgets / 1000.0;
+    phases[PHASE_OUTPUTS] = record->output_detection / 1000.0;
+    phases[PHASE_CONSTRUCT] = record->constructed / 1000.0;
+    phases[PHASE_HANDSHAKE] = record->ipc_handshake / 1000.0;
+    phases[PHASE_CONNECTED] = record->connected ?
+        (record->connected - record->started) / 1000.0 : -1;
+    phases[PHASE_PAINTED] = startup->painted ?
+        (startup->painted - record->started) / 1000.0 : -1;
+
+    plugin_host_remove(startup->host, startup->plugin);
+    startup->plugin = NULL;
+    while (g_main_context_iteration(NULL, FALSE))
+        ;
+
+    return TRUE;
+}
+
+/*
+ * Print the median of every phase in milliseconds, "-" if it never
+ * happened in most runs.
+ */
+static void
+report(Scenario scenario, gboolean warm, GArray **samples)
+{
+    guint i;
+
+    printf("%-9s %-8s", scenario_names[scenario], warm ? "yes" : "no");
+    for (i = 0; i < PHASES; i++)
+    {
+        GArray *values = samples[i];
+        g_array_sort(values, compare_doubles);
+        gdouble median = g_array_index(values, gdouble, (values->len - 1) / 2);
+        if (median < 0)
+            printf(" %10s", "-");
+        else
+            printf(" %10.2f", median);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void
+set_scenario(Startup *startup, Scenario scenario)
+{
+    guint delay = scenario == I3_SLOW ? SLOW_REPLY_MS : 0;
+
+    mock_i3_set_reply_delay(startup->mock, MOCK_I3_GET_WORKSPACES, delay);
+    mock_i3_set_reply_delay(startup->mock, MOCK_I3_SUBSCRIBE, delay);
+
+    g_setenv("I3SOCK", scenario == I3_ABSENT ?
+            startup->absent_socket : mock_i3_get_socket_path(startup->mock), TRUE);
+}
+
+/* the first workspace button drawn paints the strip */
+static gboolean
+on_expose_hook(GSignalInvocationHint *hint, guint n_params,
+        const GValue *params, gpointer data)
+{
+    Startup *startup = (Startup *) data;
+    GtkWidget *widget = GTK_WIDGET(g_value_get_object(&params[0]));
+
+    if (startup->plugin && !startup->painted && GTK_IS_BUTTON(widget) &&
+            gtk_widget_is_ancestor(widget, startup->plugin))
+        startup->painted = g_get_monotonic_time();
+
+    return TRUE;
+}
+
+static gint
+compare_doubles(gconstpointer a, gconstpointer b)
+{
+    gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+    return x < y ? -1 : x > y;
+}
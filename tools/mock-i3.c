@@ -0,0 +1,1340 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <json-glib/json-glib.h>
+
+#include "mock-i3.h"
+
+#define I3_IPC_MAGIC "i3-ipc"
+#define I3_IPC_HEADER_SIZE (6 + 2 * sizeof(guint32))
+
+typedef struct
+{
+    gchar *name;
+    gint x, y, width, height;
+} MockI3Output;
+
+typedef struct
+{
+    guint64 id;
+    gint num;
+    gchar *name;
+    gchar *output;
+    gboolean focused;
+    gboolean urgent;
+    gboolean visible;
+} MockI3Workspace;
+
+typedef struct
+{
+    guint64 id;
+    gchar *name;
+    guint64 workspace;
+} MockI3Window;
+
+typedef struct
+{
+    MockI3 *mock;
+    GSocket *socket;
+    GSource *source;
+    GByteArray *buffer;
+    guint32 events;
+} MockI3Client;
+
+struct _MockI3
+{
+    gchar *socket_path;
+    GSocket *listener;
+    GMainContext *context;
+    GMainLoop *loop;
+    GThread *thread;
+
+    /* protects everything below and serializes the writes to the clients */
+    GMutex lock;
+    GList *clients;
+    GList *outputs;
+    GList *workspaces;
+    GList *windows;
+    guint64 next_id;
+
+    guint delays[MOCK_I3_MESSAGE_TYPES];
+    guint64 messages[MOCK_I3_MESSAGE_TYPES];
+    gchar *replies[MOCK_I3_MESSAGE_TYPES];
+
+    MockI3CommandFunc command_func;
+    gpointer command_data;
+};
+
+static const gchar *message_type_names[MOCK_I3_MESSAGE_TYPES] =
+{
+    "command", "get_workspaces", "subscribe", "get_outputs", "get_tree",
+    "get_marks", "get_bar_config", "get_version", "get_binding_modes",
+    "get_config", "send_tick", "sync"
+};
+
+static const gchar *event_names[] =
+{
+    "workspace", "output", "mode", "window", "barconfig_update", "binding",
+    "shutdown", "tick"
+};
+
+static gpointer
+run_server(gpointer data);
+static gboolean
+on_accept(GSocket *listener, GIOCondition condition, gpointer data);
+static gboolean
+on_client_data(GSocket *socket, GIOCondition condition, gpointer data);
+static gboolean
+disconnect_clients(gpointer data);
+static void
+free_client(MockI3Client *client);
+
+static void
+handle_message(MockI3Client *client, guint32 type, const gchar *payload);
+static void
+default_command(MockI3 *mock, const gchar *command, gpointer data);
+static guint32
+parse_subscription(const gchar *payload, gboolean *success);
+
+static void
+send_frame(GSocket *socket, guint32 type, const gchar *payload);
+static void
+push_event(MockI3 *mock, guint32 type, const gchar *payload);
+static void
+push_workspace_event(MockI3 *mock, const gchar *change,
+        MockI3Workspace *current, MockI3Workspace *old);
+static void
+push_window_event(MockI3 *mock, const gchar *change, MockI3Window *window);
+
+static void
+append_json_string(GString *json, const gchar *str);
+static void
+append_rect(GString *json, const gchar *name, MockI3Output *output);
+static void
+append_workspace_con(GString *json, MockI3 *mock, MockI3Workspace *workspace);
+static gchar *
+workspaces_json(MockI3 *mock);
+static gchar *
+outputs_json(MockI3 *mock);
+static void
+append_window_con(GString *json, MockI3Window *window);
+static gchar *
+tree_json(MockI3 *mock);
+
+static MockI3Output *
+find_output(MockI3 *mock, const gchar *name);
+static MockI3Workspace *
+find_workspace(MockI3 *mock, const gchar *name);
+static MockI3Workspace *
+find_focused_workspace(MockI3 *mock);
+static MockI3Window *
+find_window(MockI3 *mock, const gchar *name);
+static void
+free_window(MockI3Window *window);
+static gint
+workspace_number(const gchar *name);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * mock_i3_new:
+ * @socket_path: the socket to listen on, NULL for a unique one in the
+ * user's runtime directory
+ * @err: the error object
+ *
+ * Create the mock server and start serving in its own thread.
+ *
+ * Returns: the mock server or NULL
+ */
+MockI3 *
+mock_i3_new(const gchar *socket_path, GError **err)
+{
+    MockI3 *mock = g_new0(MockI3, 1);
+    GError *tmp_err = NULL;
+
+    g_mutex_init(&mock->lock);
+    mock->next_id = 1;
+    mock->socket_path = socket_path ?
+        g_strdup(socket_path) :
+        g_strdup_printf("%s/i3-mock.%d.%p.sock", g_get_user_runtime_dir(),
+                (int) getpid(), (void *) mock);
+
+    g_unlink(mock->socket_path);
+
+    mock->listener = g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM,
+            G_SOCKET_PROTOCOL_DEFAULT, &tmp_err);
+    if (tmp_err == NULL)
+    {
+        GSocketAddress *address = g_unix_socket_address_new(mock->socket_path);
+        if (g_socket_bind(mock->listener, address, TRUE, &tmp_err))
+            g_socket_listen(mock->listener, &tmp_err);
+        g_object_unref(address);
+    }
+
+    if (tmp_err != NULL)
+    {
+        g_propagate_error(err, tmp_err);
+        if (mock->listener)
+            g_object_unref(mock->listener);
+        g_mutex_clear(&mock->lock);
+        g_free(mock->socket_path);
+        g_free(mock);
+        return NULL;
+    }
+
+    mock->context = g_main_context_new();
+    mock->loop = g_main_loop_new(mock->context, FALSE);
+
+    GSource *source = g_socket_create_source(mock->listener, G_IO_IN, NULL);
+    g_source_set_callback(source, (GSourceFunc) on_accept, mock, NULL);
+    g_source_attach(source, mock->context);
+    g_source_unref(source);
+
+    mock->thread = g_thread_new("mock-i3", run_server, mock);
+
+    return mock;
+}
+
+/**
+ * mock_i3_free:
+ * @mock: the mock server
+ *
+ * Stop the server, close all connections and remove the socket.
+ */
+void
+mock_i3_free(MockI3 *mock)
+{
+    g_main_loop_quit(mock->loop);
+    g_thread_join(mock->thread);
+
+    disconnect_clients(mock);
+
+    g_socket_close(mock->listener, NULL);
+    g_object_unref(mock->listener);
+    g_unlink(mock->socket_path);
+
+    g_main_loop_unref(mock->loop);
+    g_main_context_unref(mock->context);
+
+    GList *item;
+    for (item = mock->outputs; item != NULL; item = item->next)
+    {
+        MockI3Output *output = (MockI3Output *) item->data;
+        g_free(output->name);
+        g_free(output);
+    }
+    g_list_free(mock->outputs);
+
+    for (item = mock->workspaces; item != NULL; item = item->next)
+    {
+        MockI3Workspace *workspace = (MockI3Workspace *) item->data;
+        g_free(workspace->name);
+        g_free(workspace->output);
+        g_free(workspace);
+    }
+    g_list_free(mock->workspaces);
+
+    g_list_free_full(mock->windows, (GDestroyNotify) free_window);
+
+    guint type;
+    for (type = 0; type < MOCK_I3_MESSAGE_TYPES; type++)
+        g_free(mock->replies[type]);
+
+    g_mutex_clear(&mock->lock);
+    g_free(mock->socket_path);
+    g_free(mock);
+}
+
+/**
+ * mock_i3_get_socket_path:
+ * @mock: the mock server
+ *
+ * Returns: the path of the socket the server listens on
+ */
+const gchar *
+mock_i3_get_socket_path(MockI3 *mock)
+{
+    return mock->socket_path;
+}
+
+/**
+ * mock_i3_get_subscriber_count:
+ * @mock: the mock server
+ *
+ * Returns: the number of connected clients subscribed to any event
+ */
+guint
+mock_i3_get_subscriber_count(MockI3 *mock)
+{
+    guint count = 0;
+
+    g_mutex_lock(&mock->lock);
+    GList *item;
+    for (item = mock->clients; item != NULL; item = item->next)
+    {
+        if (((MockI3Client *) item->data)->events)
+            count++;
+    }
+    g_mutex_unlock(&mock->lock);
+
+    return count;
+}
+
+/**
+ * mock_i3_get_message_count:
+ * @mock: the mock server
+ * @type: the message type
+ *
+ * Returns: the number of messages of the type answered so far
+ */
+guint64
+mock_i3_get_message_count(MockI3 *mock, guint32 type)
+{
+    guint64 count = 0;
+
+    g_mutex_lock(&mock->lock);
+    if (type < MOCK_I3_MESSAGE_TYPES)
+        count = mock->messages[type];
+    g_mutex_unlock(&mock->lock);
+
+    return count;
+}
+
+/**
+ * mock_i3_set_reply_delay:
+ * @mock: the mock server
+ * @type: the message type
+ * @delay_ms: the time to wait before the reply is sent
+ *
+ * Delay the replies to the messages of the type, like a busy i3 would.
+ */
+void
+mock_i3_set_reply_delay(MockI3 *mock, guint32 type, guint delay_ms)
+{
+    g_return_if_fail(type < MOCK_I3_MESSAGE_TYPES);
+
+    g_mutex_lock(&mock->lock);
+    mock->delays[type] = delay_ms;
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_set_command_func:
+ * @mock: the mock server
+ * @func: the command handler, NULL for the default
+ * @data: the data passed to the handler
+ *
+ * Set the handler of COMMAND messages. The default handler understands
+ * "workspace <name>" and focuses the workspace.
+ */
+void
+mock_i3_set_command_func(MockI3 *mock, MockI3CommandFunc func, gpointer data)
+{
+    g_mutex_lock(&mock->lock);
+    mock->command_func = func;
+    mock->command_data = data;
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_set_reply:
+ * @mock: the mock server
+ * @type: the message type
+ * @payload: the reply, NULL to generate it from the state again
+ * @length: the length of the reply
+ *
+ * Answer the messages of the type with a fixed reply, e.g. a recorded one.
+ */
+void
+mock_i3_set_reply(MockI3 *mock, guint32 type, const gchar *payload, gsize length)
+{
+    g_return_if_fail(type < MOCK_I3_MESSAGE_TYPES);
+
+    g_mutex_lock(&mock->lock);
+    g_free(mock->replies[type]);
+    mock->replies[type] = payload ? g_strndup(payload, length) : NULL;
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_add_output:
+ * @mock: the mock server
+ * @name: the output name
+ * @x, @y, @width, @height: the output geometry
+ *
+ * Add an output. Workspaces can only be created on known outputs.
+ */
+void
+mock_i3_add_output(MockI3 *mock, const gchar *name,
+        gint x, gint y, gint width, gint height)
+{
+    MockI3Output *output = g_new0(MockI3Output, 1);
+    output->name = g_strdup(name);
+    output->x = x;
+    output->y = y;
+    output->width = width;
+    output->height = height;
+
+    g_mutex_lock(&mock->lock);
+    mock->outputs = g_list_append(mock->outputs, output);
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_add_workspace:
+ * @mock: the mock server
+ * @name: the workspace name
+ * @output: the output of the workspace
+ *
+ * Create a workspace and push the "init" event. The first workspace of an
+ * output is visible, the first workspace overall is focused.
+ */
+void
+mock_i3_add_workspace(MockI3 *mock, const gchar *name, const gchar *output)
+{
+    g_mutex_lock(&mock->lock);
+
+    if (find_workspace(mock, name) == NULL)
+    {
+        MockI3Workspace *workspace = g_new0(MockI3Workspace, 1);
+        workspace->id = mock->next_id++;
+        workspace->num = workspace_number(name);
+        workspace->name = g_strdup(name);
+        workspace->output = g_strdup(output);
+        workspace->focused = find_focused_workspace(mock) == NULL;
+        workspace->visible = TRUE;
+
+        GList *item;
+        for (item = mock->workspaces; item != NULL; item = item->next)
+        {
+            MockI3Workspace *other = (MockI3Workspace *) item->data;
+            if (other->visible && g_strcmp0(other->output, output) == 0)
+                workspace->visible = FALSE;
+        }
+
+        mock->workspaces = g_list_append(mock->workspaces, workspace);
+        push_workspace_event(mock, "init", workspace, NULL);
+    }
+
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_remove_workspace:
+ * @mock: the mock server
+ * @name: the workspace name
+ *
+ * Remove a workspace and push the "empty" event.
+ */
+void
+mock_i3_remove_workspace(MockI3 *mock, const gchar *name)
+{
+    g_mutex_lock(&mock->lock);
+
+    MockI3Workspace *workspace = find_workspace(mock, name);
+    if (workspace)
+    {
+        push_workspace_event(mock, "empty", workspace, NULL);
+
+        mock->workspaces = g_list_remove(mock->workspaces, workspace);
+        g_free(workspace->name);
+        g_free(workspace->output);
+        g_free(workspace);
+    }
+
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_focus_workspace:
+ * @mock: the mock server
+ * @name: the workspace name
+ *
+ * Focus a workspace, making it the visible one of its output, and push the
+ * "focus" event.
+ */
+void
+mock_i3_focus_workspace(MockI3 *mock, const gchar *name)
+{
+    g_mutex_lock(&mock->lock);
+
+    MockI3Workspace *workspace = find_workspace(mock, name);
+    if (workspace)
+    {
+        MockI3Workspace *old = find_focused_workspace(mock);
+
+        GList *item;
+        for (item = mock->workspaces; item != NULL; item = item->next)
+        {
+            MockI3Workspace *other = (MockI3Workspace *) item->data;
+            other->focused = FALSE;
+            if (g_strcmp0(other->output, workspace->output) == 0)
+                other->visible = FALSE;
+        }
+
+        workspace->focused = TRUE;
+        workspace->visible = TRUE;
+
+        push_workspace_event(mock, "focus", workspace, old);
+    }
+
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_set_urgent:
+ * @mock: the mock server
+ * @name: the workspace name
+ * @urgent: the urgency
+ *
+ * Set the urgency of a workspace and push the "urgent" event.
+ */
+void
+mock_i3_set_urgent(MockI3 *mock, const gchar *name, gboolean urgent)
+{
+    g_mutex_lock(&mock->lock);
+
+    MockI3Workspace *workspace = find_workspace(mock, name);
+    if (workspace)
+    {
+        workspace->urgent = urgent;
+        push_workspace_event(mock, "urgent", workspace, NULL);
+    }
+
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_rename_workspace:
+ * @mock: the mock server
+ * @name: the workspace name
+ * @new_name: the new workspace name
+ *
+ * Rename a workspace and push the "rename" event.
+ */
+void
+mock_i3_rename_workspace(MockI3 *mock, const gchar *name, const gchar *new_name)
+{
+    g_mutex_lock(&mock->lock);
+
+    MockI3Workspace *workspace = find_workspace(mock, name);
+    if (workspace && find_workspace(mock, new_name) == NULL)
+    {
+        g_free(workspace->name);
+        workspace->name = g_strdup(new_name);
+        workspace->num = workspace_number(new_name);
+        push_workspace_event(mock, "rename", workspace, NULL);
+    }
+
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_move_workspace:
+ * @mock: the mock server
+ * @name: the workspace name
+ * @output: the new output
+ *
+ * Move a workspace to another output and push the "move" event.
+ */
+void
+mock_i3_move_workspace(MockI3 *mock, const gchar *name, const gchar *output)
+{
+    g_mutex_lock(&mock->lock);
+
+    MockI3Workspace *workspace = find_workspace(mock, name);
+    if (workspace)
+    {
+        g_free(workspace->output);
+        workspace->output = g_strdup(output);
+        push_workspace_event(mock, "move", workspace, NULL);
+    }
+
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_set_mode:
+ * @mock: the mock server
+ * @mode: the binding mode
+ * @pango_markup: whether the mode name is pango markup
+ *
+ * Push a "mode" event.
+ */
+void
+mock_i3_set_mode(MockI3 *mock, const gchar *mode, gboolean pango_markup)
+{
+    GString *json = g_string_new("{\"change\":");
+    append_json_string(json, mode);
+    g_string_append_printf(json, ",\"pango_markup\":%s}",
+            pango_markup ? "true" : "false");
+
+    g_mutex_lock(&mock->lock);
+    push_event(mock, MOCK_I3_EVENT_MODE, json->str);
+    g_mutex_unlock(&mock->lock);
+
+    g_string_free(json, TRUE);
+}
+
+/**
+ * mock_i3_output_changed:
+ * @mock: the mock server
+ *
+ * Push an "output" event.
+ */
+void
+mock_i3_output_changed(MockI3 *mock)
+{
+    g_mutex_lock(&mock->lock);
+    push_event(mock, MOCK_I3_EVENT_OUTPUT, "{\"change\":\"unspecified\"}");
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_open_window:
+ * @mock: the mock server
+ * @name: the window name
+ * @workspace: the workspace name, NULL for the focused one
+ *
+ * Open a window on a workspace and push the "new" window event.
+ */
+void
+mock_i3_open_window(MockI3 *mock, const gchar *name, const gchar *workspace)
+{
+    g_mutex_lock(&mock->lock);
+
+    MockI3Workspace *target = workspace ?
+        find_workspace(mock, workspace) : find_focused_workspace(mock);
+    if (target && find_window(mock, name) == NULL)
+    {
+        MockI3Window *window = g_new0(MockI3Window, 1);
+        window->id = mock->next_id++;
+        window->name = g_strdup(name);
+        window->workspace = target->id;
+
+        mock->windows = g_list_append(mock->windows, window);
+        push_window_event(mock, "new", window);
+    }
+
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_close_window:
+ * @mock: the mock server
+ * @name: the window name
+ *
+ * Close a window and push the "close" window event.
+ */
+void
+mock_i3_close_window(MockI3 *mock, const gchar *name)
+{
+    g_mutex_lock(&mock->lock);
+
+    MockI3Window *window = find_window(mock, name);
+    if (window)
+    {
+        push_window_event(mock, "close", window);
+
+        mock->windows = g_list_remove(mock->windows, window);
+        free_window(window);
+    }
+
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_move_window:
+ * @mock: the mock server
+ * @name: the window name
+ * @workspace: the workspace name
+ *
+ * Move a window to another workspace and push the "move" window event,
+ * which like i3's does not tell the destination.
+ */
+void
+mock_i3_move_window(MockI3 *mock, const gchar *name, const gchar *workspace)
+{
+    g_mutex_lock(&mock->lock);
+
+    MockI3Window *window = find_window(mock, name);
+    MockI3Workspace *target = find_workspace(mock, workspace);
+    if (window && target)
+    {
+        window->workspace = target->id;
+        push_window_event(mock, "move", window);
+    }
+
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_send_event:
+ * @mock: the mock server
+ * @type: the event type, without the event bit
+ * @payload: the JSON payload
+ *
+ * Push an arbitrary event to the clients subscribed to it.
+ */
+void
+mock_i3_send_event(MockI3 *mock, guint32 type, const gchar *payload)
+{
+    g_mutex_lock(&mock->lock);
+    push_event(mock, type, payload);
+    g_mutex_unlock(&mock->lock);
+}
+
+/**
+ * mock_i3_disconnect_clients:
+ * @mock: the mock server
+ *
+ * Close all client connections from the server thread.
+ */
+void
+mock_i3_disconnect_clients(MockI3 *mock)
+{
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, disconnect_clients, mock, NULL);
+    g_source_attach(source, mock->context);
+    g_source_unref(source);
+}
+
+/**
+ * mock_i3_message_type_from_string:
+ * @str: a message type name like "get_workspaces", or its number
+ *
+ * Returns: the message type or -1
+ */
+gint
+mock_i3_message_type_from_string(const gchar *str)
+{
+    gint type;
+    for (type = 0; type < MOCK_I3_MESSAGE_TYPES; type++)
+    {
+        if (g_ascii_strcasecmp(str, message_type_names[type]) == 0)
+            return type;
+    }
+
+    gchar *end = NULL;
+    type = (gint) strtol(str, &end, 10);
+    if (end == str || *end != '\0' || type < 0 || type >= MOCK_I3_MESSAGE_TYPES)
+        return -1;
+
+    return type;
+}
+
+/*
+ * Implementations of private functions
+ */
+
+static gpointer
+run_server(gpointer data)
+{
+    MockI3 *mock = (MockI3 *) data;
+
+    g_main_context_push_thread_default(mock->context);
+    g_main_loop_run(mock->loop);
+    g_main_context_pop_thread_default(mock->context);
+
+    return NULL;
+}
+
+static gboolean
+on_accept(GSocket *listener, GIOCondition condition, gpointer data)
+{
+    MockI3 *mock = (MockI3 *) data;
+
+    GSocket *socket = g_socket_accept(listener, NULL, NULL);
+    if (!socket)
+        return TRUE;
+
+    MockI3Client *client = g_new0(MockI3Client, 1);
+    client->mock = mock;
+    client->socket = socket;
+    client->buffer = g_byte_array_new();
+
+    client->source = g_socket_create_source(socket, G_IO_IN | G_IO_HUP | G_IO_ERR, NULL);
+    g_source_set_callback(client->source, (GSourceFunc) on_client_data, client, NULL);
+    g_source_attach(client->source, mock->context);
+
+    g_mutex_lock(&mock->lock);
+    mock->clients = g_list_prepend(mock->clients, client);
+    g_mutex_unlock(&mock->lock);
+
+    return TRUE;
+}
+
+static gboolean
+on_client_data(GSocket *socket, GIOCondition condition, gpointer data)
+{
+    MockI3Client *client = (MockI3Client *) data;
+    MockI3 *mock = client->mock;
+    gchar chunk[4096];
+
+    gssize n = g_socket_receive(socket, chunk, sizeof(chunk), NULL, NULL);
+    if (n <= 0)
+    {
+        g_mutex_lock(&mock->lock);
+        mock->clients = g_list_remove(mock->clients, client);
+        g_mutex_unlock(&mock->lock);
+
+        free_client(client);
+        return FALSE;
+    }
+
+    g_byte_array_append(client->buffer, (const guint8 *) chunk, n);
+
+    while (client->buffer->len >= I3_IPC_HEADER_SIZE)
+    {
+        guint32 length, type;
+        const guint8 *frame = client->buffer->data;
+
+        if (memcmp(frame, I3_IPC_MAGIC, strlen(I3_IPC_MAGIC)) != 0)
+        {
+            g_printerr("mock-i3: dropping client sending garbage\n");
+            g_byte_array_set_size(client->buffer, 0);
+            break;
+        }
+
+        memcpy(&length, frame + 6, sizeof(length));
+        memcpy(&type, frame + 6 + sizeof(length), sizeof(type));
+        if (client->buffer->len < I3_IPC_HEADER_SIZE + length)
+            break;
+
+        gchar *payload = g_strndup((const gchar *) frame + I3_IPC_HEADER_SIZE, length);
+        g_byte_array_remove_range(client->buffer, 0, I3_IPC_HEADER_SIZE + length);
+
+        handle_message(client, type, payload);
+        g_free(payload);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+disconnect_clients(gpointer data)
+{
+    MockI3 *mock = (MockI3 *) data;
+
+    g_mutex_lock(&mock->lock);
+    GList *clients = mock->clients;
+    mock->clients = NULL;
+    g_mutex_unlock(&mock->lock);
+
+    GList *item;
+    for (item = clients; item != NULL; item = item->next)
+    {
+        MockI3Client *client = (MockI3Client *) item->data;
+        g_source_destroy(client->source);
+        free_client(client);
+    }
+    g_list_free(clients);
+
+    return FALSE;
+}
+
+static void
+free_client(MockI3Client *client)
+{
+    g_socket_close(client->socket, NULL);
+    g_object_unref(client->socket);
+    g_source_unref(client->source);
+    g_byte_array_free(client->buffer, TRUE);
+    g_free(client);
+}
+
+static void
+handle_message(MockI3Client *client, guint32 type, const gchar *payload)
+{
+    MockI3 *mock = client->mock;
+    MockI3CommandFunc command_func;
+    gpointer command_data;
+    gchar *reply = NULL;
+    guint delay = 0;
+
+    g_mutex_lock(&mock->lock);
+    if (type < MOCK_I3_MESSAGE_TYPES)
+        delay = mock->delays[type];
+    command_func = mock->command_func ? mock->command_func : default_command;
+    command_data = mock->command_data;
+    g_mutex_unlock(&mock->lock);
+
+    if (delay)
+        g_usleep(delay * 1000);
+
+    // the command runs unlocked, it may change the state
+    if (type == MOCK_I3_COMMAND)
+        command_func(mock, payload, command_data);
+
+    g_mutex_lock(&mock->lock);
+
+    switch (type)
+    {
+        case MOCK_I3_COMMAND:
+            reply = g_strdup("[{\"success\":true}]");
+            break;
+        case MOCK_I3_GET_WORKSPACES:
+            reply = workspaces_json(mock);
+            break;
+        case MOCK_I3_SUBSCRIBE:
+        {
+            gboolean success;
+            client->events |= parse_subscription(payload, &success);
+            reply = g_strdup(success ? "{\"success\":true}" : "{\"success\":false}");
+            break;
+        }
+        case MOCK_I3_GET_OUTPUTS:
+            reply = outputs_json(mock);
+            break;
+        case MOCK_I3_GET_TREE:
+            reply = tree_json(mock);
+            break;
+        default:
+            reply = g_strdup("{\"success\":false,\"error\":\"not supported by the mock\"}");
+            break;
+    }
+
+    if (type < MOCK_I3_MESSAGE_TYPES)
+    {
+        if (mock->replies[type])
+        {
+            g_free(reply);
+            reply = g_strdup(mock->replies[type]);
+        }
+
+        // counted once answered, so a changed fixed reply can't race it
+        mock->messages[type]++;
+    }
+
+    send_frame(client->socket, type, reply);
+
+    g_mutex_unlock(&mock->lock);
+
+    g_free(reply);
+}
+
+static void
+default_command(MockI3 *mock, const gchar *command, gpointer data)
+{
+    if (g_str_has_prefix(command, "workspace "))
+        mock_i3_focus_workspace(mock, command + strlen("workspace "));
+}
+
+static guint32
+parse_subscription(const gchar *payload, gboolean *success)
+{
+    JsonParser *parser = json_parser_new();
+    guint32 events = 0;
+
+    *success = json_parser_load_from_data(parser, payload, -1, NULL) &&
+        JSON_NODE_HOLDS_ARRAY(json_parser_get_root(parser));
+
+    if (*success)
+    {
+        JsonArray *array = json_node_get_array(json_parser_get_root(parser));
+        guint i, e;
+        for (i = 0; i < json_array_get_length(array); i++)
+        {
+            const gchar *name = json_array_get_string_element(array, i);
+            for (e = 0; e < G_N_ELEMENTS(event_names); e++)
+            {
+                if (g_strcmp0(name, event_names[e]) == 0)
+                    events |= 1 << e;
+            }
+        }
+    }
+
+    g_object_unref(parser);
+
+    return events;
+}
+
+/* called with the lock held, so frames of different threads never mix */
+static void
+send_frame(GSocket *socket, guint32 type, const gchar *payload)
+{
+    guint32 length = strlen(payload);
+    GByteArray *frame = g_byte_array_sized_new(I3_IPC_HEADER_SIZE + length);
+
+    g_byte_array_append(frame, (const guint8 *) I3_IPC_MAGIC, strlen(I3_IPC_MAGIC));
+    g_byte_array_append(frame, (const guint8 *) &length, sizeof(length));
+    g_byte_array_append(frame, (const guint8 *) &type, sizeof(type));
+    g_byte_array_append(frame, (const guint8 *) payload, length);
+
+    gsize sent = 0;
+    while (sent < frame->len)
+    {
+        gssize n = g_socket_send(socket, (const gchar *) frame->data + sent,
+                frame->len - sent, NULL, NULL);
+        if (n <= 0)
+            break;
+        sent += n;
+    }
+
+    g_byte_array_free(frame, TRUE);
+}
+
+/* called with the lock held */
+static void
+push_event(MockI3 *mock, guint32 type, const gchar *payload)
+{
+    GList *item;
+    for (item = mock->clients; item != NULL; item = item->next)
+    {
+        MockI3Client *client = (MockI3Client *) item->data;
+        if (client->events & (1 << type))
+            send_frame(client->socket, MOCK_I3_EVENT_BIT | type, payload);
+    }
+}
+
+/* called with the lock held */
+static void
+push_workspace_event(MockI3 *mock, const gchar *change,
+        MockI3Workspace *current, MockI3Workspace *old)
+{
+    GString *json = g_string_new("{\"change\":");
+    append_json_string(json, change);
+
+    g_string_append(json, ",\"current\":");
+    append_workspace_con(json, mock, current);
+
+    g_string_append(json, ",\"old\":");
+    if (old)
+        append_workspace_con(json, mock, old);
+    else
+        g_string_append(json, "null");
+
+    g_string_append_c(json, '}');
+
+    push_event(mock, MOCK_I3_EVENT_WORKSPACE, json->str);
+    g_string_free(json, TRUE);
+}
+
+/* called with the lock held */
+static void
+push_window_event(MockI3 *mock, const gchar *change, MockI3Window *window)
+{
+    GString *json = g_string_new("{\"change\":");
+    append_json_string(json, change);
+
+    g_string_append(json, ",\"container\":");
+    append_window_con(json, window);
+    g_string_append_c(json, '}');
+
+    push_event(mock, MOCK_I3_EVENT_WINDOW, json->str);
+    g_string_free(json, TRUE);
+}
+
+static void
+append_json_string(GString *json, const gchar *str)
+{
+    const gchar *c;
+
+    g_string_append_c(json, '"');
+    for (c = str; *c; c++)
+    {
+        switch (*c)
+        {
+            case '"': g_string_append(json, "\\\""); break;
+            case '\\': g_string_append(json, "\\\\"); break;
+            case '\n': g_string_append(json, "\\n"); break;
+            case '\t': g_string_append(json, "\\t"); break;
+            default:
+                if ((guchar) *c < 0x20)
+                    g_string_append_printf(json, "\\u%04x", (guint) *c);
+                else
+                    g_string_append_c(json, *c);
+                break;
+        }
+    }
+    g_string_append_c(json, '"');
+}
+
+static void
+append_rect(GString *json, const gchar *name, MockI3Output *output)
+{
+    g_string_append_printf(json, "\"%s\":{\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d}",
+            name,
+            output ? output->x : 0, output ? output->y : 0,
+            output ? output->width : 0, output ? output->height : 0);
+}
+
+/* a workspace container as it appears in workspace events */
+static void
+append_workspace_con(GString *json, MockI3 *mock, MockI3Workspace *workspace)
+{
+    MockI3Output *output = find_output(mock, workspace->output);
+
+    g_string_append_printf(json, "{\"id\":%" G_GUINT64_FORMAT ",\"type\":\"workspace\",\"name\":",
+            workspace->id);
+    append_json_string(json, workspace->name);
+    g_string_append_printf(json,
+            ",\"num\":%d,\"border\":\"normal\",\"current_border_width\":-1"
+            ",\"layout\":\"splith\",\"orientation\":\"horizontal\",\"percent\":null"
+            ",\"window\":null,\"urgent\":%s,\"focused\":%s,\"fullscreen_mode\":0"
+            ",\"floating\":\"auto_off\",\"scratchpad_state\":\"none\",\"sticky\":false"
+            ",\"output\":",
+            workspace->num,
+            workspace->urgent ? "true" : "false",
+            workspace->focused ? "true" : "false");
+    append_json_string(json, workspace->output);
+    g_string_append_c(json, ',');
+    append_rect(json, "rect", output);
+    g_string_append_c(json, ',');
+    append_rect(json, "window_rect", NULL);
+    g_string_append_c(json, ',');
+    append_rect(json, "deco_rect", NULL);
+    g_string_append_c(json, ',');
+    append_rect(json, "geometry", NULL);
+    g_string_append(json, ",\"nodes\":[],\"floating_nodes\":[],\"focus\":[],\"marks\":[]}");
+}
+
+/* called with the lock held */
+static gchar *
+workspaces_json(MockI3 *mock)
+{
+    GString *json = g_string_new("[");
+
+    GList *item;
+    for (item = mock->workspaces; item != NULL; item = item->next)
+    {
+        MockI3Workspace *workspace = (MockI3Workspace *) item->data;
+
+        if (item != mock->workspaces)
+            g_string_append_c(json, ',');
+
+        g_string_append_printf(json, "{\"id\":%" G_GUINT64_FORMAT ",\"num\":%d,\"name\":",
+                workspace->id, workspace->num);
+        append_json_string(json, workspace->name);
+        g_string_append_printf(json, ",\"visible\":%s,\"focused\":%s,\"urgent\":%s,",
+                workspace->visible ? "true" : "false",
+                workspace->focused ? "true" : "false",
+                workspace->urgent ? "true" : "false");
+        append_rect(json, "rect", find_output(mock, workspace->output));
+        g_string_append(json, ",\"output\":");
+        append_json_string(json, workspace->output);
+        g_string_append_c(json, '}');
+    }
+
+    g_string_append_c(json, ']');
+
+    return g_string_free(json, FALSE);
+}
+
+/* called with the lock held */
+static gchar *
+outputs_json(MockI3 *mock)
+{
+    GString *json = g_string_new("[");
+
+    GList *item;
+    for (item = mock->outputs; item != NULL; item = item->next)
+    {
+        MockI3Output *output = (MockI3Output *) item->data;
+        MockI3Workspace *current = NULL;
+
+        GList *witem;
+        for (witem = mock->workspaces; witem != NULL; witem = witem->next)
+        {
+            MockI3Workspace *workspace = (MockI3Workspace *) witem->data;
+            if (workspace->visible && g_strcmp0(workspace->output, output->name) == 0)
+                current = workspace;
+        }
+
+        if (item != mock->outputs)
+            g_string_append_c(json, ',');
+
+        g_string_append(json, "{\"name\":");
+        append_json_string(json, output->name);
+        g_string_append_printf(json, ",\"active\":true,\"primary\":%s,\"current_workspace\":",
+                item == mock->outputs ? "true" : "false");
+        if (current)
+            append_json_string(json, current->name);
+        else
+            g_string_append(json, "null");
+        g_string_append_c(json, ',');
+        append_rect(json, "rect", output);
+        g_string_append_c(json, '}');
+    }
+
+    g_string_append_c(json, ']');
+
+    return g_string_free(json, FALSE);
+}
+
+/* a window container as it appears in the tree and in window events */
+static void
+append_window_con(GString *json, MockI3Window *window)
+{
+    g_string_append_printf(json, "{\"id\":%" G_GUINT64_FORMAT ",\"type\":\"con\""
+            ",\"window\":%" G_GUINT64_FORMAT ",\"name\":",
+            window->id, 0x400000 + window->id);
+    append_json_string(json, window->name);
+    // the name doubles as the class, so "window firefox" shows its icon
+    g_string_append(json, ",\"window_properties\":{\"class\":");
+    append_json_string(json, window->name);
+    g_string_append(json, "},\"nodes\":[],\"floating_nodes\":[]}");
+}
+
+/*
+ * The tree down to the windows, without the details the plugin does not
+ * read: root, outputs, their workspaces and the windows of each workspace.
+ * Called with the lock held.
+ */
+static gchar *
+tree_json(MockI3 *mock)
+{
+    GString *json = g_string_new("{\"id\":0,\"type\":\"root\",\"name\":\"root\",\"nodes\":[");
+
+    GList *oitem, *witem, *item;
+    for (oitem = mock->outputs; oitem != NULL; oitem = oitem->next)
+    {
+        MockI3Output *output = (MockI3Output *) oitem->data;
+        gboolean first_workspace = TRUE;
+
+        if (oitem != mock->outputs)
+            g_string_append_c(json, ',');
+
+        g_string_append(json, "{\"type\":\"output\",\"name\":");
+        append_json_string(json, output->name);
+        g_string_append(json, ",\"nodes\":[");
+
+        for (witem = mock->workspaces; witem != NULL; witem = witem->next)
+        {
+            MockI3Workspace *workspace = (MockI3Workspace *) witem->data;
+            gboolean first_window = TRUE;
+
+            if (g_strcmp0(workspace->output, output->name) != 0)
+                continue;
+
+            if (!first_workspace)
+                g_string_append_c(json, ',');
+            first_workspace = FALSE;
+
+            g_string_append_printf(json, "{\"id\":%" G_GUINT64_FORMAT
+                    ",\"type\":\"workspace\",\"name\":", workspace->id);
+            append_json_string(json, workspace->name);
+            g_string_append(json, ",\"floating_nodes\":[],\"nodes\":[");
+
+            for (item = mock->windows; item != NULL; item = item->next)
+            {
+                MockI3Window *window = (MockI3Window *) item->data;
+                if (window->workspace != workspace->id)
+                    continue;
+
+                if (!first_window)
+                    g_string_append_c(json, ',');
+                first_window = FALSE;
+
+                append_window_con(json, window);
+            }
+
+            g_string_append(json, "]}");
+        }
+
+        g_string_append(json, "]}");
+    }
+
+    g_string_append(json, "]}");
+
+    return g_string_free(json, FALSE);
+}
+
+static MockI3Output *
+find_output(MockI3 *mock, const gchar *name)
+{
+    GList *item;
+    for (item = mock->outputs; item != NULL; item = item->next)
+    {
+        MockI3Output *output = (MockI3Output *) item->data;
+        if (g_strcmp0(output->name, name) == 0)
+            return output;
+    }
+
+    return NULL;
+}
+
+static MockI3Workspace *
+find_workspace(MockI3 *mock, const gchar *name)
+{
+    GList *item;
+    for (item = mock->workspaces; item != NULL; item = item->next)
+    {
+        MockI3Workspace *workspace = (MockI3Workspace *) item->data;
+        if (g_strcmp0(workspace->name, name) == 0)
+            return workspace;
+    }
+
+    return NULL;
+}
+
+static MockI3Workspace *
+find_focused_workspace(MockI3 *mock)
+{
+    GList *item;
+    for (item = mock->workspaces; item != NULL; item = item->next)
+    {
+        MockI3Workspace *workspace = (MockI3Workspace *) item->data;
+        if (workspace->focused)
+            return workspace;
+    }
+
+    return NULL;
+}
+
+static MockI3Window *
+find_window(MockI3 *mock, const gchar *name)
+{
+    GList *item;
+    for (item = mock->windows; item != NULL; item = item->next)
+    {
+        MockI3Window *window = (MockI3Window *) item->data;
+        if (g_strcmp0(window->name, name) == 0)
+            return window;
+    }
+
+    return NULL;
+}
+
+static void
+free_window(MockI3Window *window)
+{
+    g_free(window->name);
+    g_free(window);
+}
+
+/* the workspace number the way i3 derives it from the name, -1 if named */
+static gint
+workspace_number(const gchar *name)
+{
+    gchar *end = NULL;
+    glong num = strtol(name, &end, 10);
+
+    if (end == name || num < 0 || num >= G_MAXINT)
+        return -1;
+
+    return (gint) num;
+}
@@ -0,0 +1,112 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MOCK_I3_H__
+#define __MOCK_I3_H__
+
+#include <glib.h>
+
+/*
+ * A stand-in for the i3 IPC server: it speaks the i3 IPC framing on a unix
+ * socket and keeps a scriptable workspace state. The server runs in its own
+ * thread, so it can answer clients which block on a reply in the calling
+ * thread. All functions may be called from any thread.
+ */
+
+/* i3 IPC message types */
+#define MOCK_I3_COMMAND 0
+#define MOCK_I3_GET_WORKSPACES 1
+#define MOCK_I3_SUBSCRIBE 2
+#define MOCK_I3_GET_OUTPUTS 3
+#define MOCK_I3_GET_TREE 4
+#define MOCK_I3_MESSAGE_TYPES 12
+
+/* i3 IPC event types, without the event bit */
+#define MOCK_I3_EVENT_BIT 0x80000000
+#define MOCK_I3_EVENT_WORKSPACE 0
+#define MOCK_I3_EVENT_OUTPUT 1
+#define MOCK_I3_EVENT_MODE 2
+#define MOCK_I3_EVENT_WINDOW 3
+#define MOCK_I3_EVENT_SHUTDOWN 6
+#define MOCK_I3_EVENT_TICK 7
+
+typedef struct _MockI3 MockI3;
+
+/* called in the server thread for every COMMAND message */
+typedef void (*MockI3CommandFunc) (MockI3 *mock, const gchar *command, gpointer data);
+
+MockI3 *
+mock_i3_new(const gchar *socket_path, GError **err);
+void
+mock_i3_free(MockI3 *mock);
+
+const gchar *
+mock_i3_get_socket_path(MockI3 *mock);
+guint
+mock_i3_get_subscriber_count(MockI3 *mock);
+guint64
+mock_i3_get_message_count(MockI3 *mock, guint32 type);
+
+void
+mock_i3_set_reply_delay(MockI3 *mock, guint32 type, guint delay_ms);
+void
+mock_i3_set_command_func(MockI3 *mock, MockI3CommandFunc func, gpointer data);
+
+/* answer the message type with a fixed payload, NULL for the generated one */
+void
+mock_i3_set_reply(MockI3 *mock, guint32 type, const gchar *payload, gsize length);
+
+/* state changes, each pushes the matching event to the subscribers */
+void
+mock_i3_add_output(MockI3 *mock, const gchar *name,
+        gint x, gint y, gint width, gint height);
+void
+mock_i3_add_workspace(MockI3 *mock, const gchar *name, const gchar *output);
+void
+mock_i3_remove_workspace(MockI3 *mock, const gchar *name);
+void
+mock_i3_focus_workspace(MockI3 *mock, const gchar *name);
+void
+mock_i3_set_urgent(MockI3 *mock, const gchar *name, gboolean urgent);
+void
+mock_i3_rename_workspace(MockI3 *mock, const gchar *name, const gchar *new_name);
+void
+mock_i3_move_workspace(MockI3 *mock, const gchar *name, const gchar *output);
+void
+mock_i3_set_mode(MockI3 *mock, const gchar *mode, gboolean pango_markup);
+void
+mock_i3_output_changed(MockI3 *mock);
+void
+mock_i3_open_window(MockI3 *mock, const gchar *name, const gchar *workspace);
+void
+mock_i3_close_window(MockI3 *mock, const gchar *name);
+void
+mock_i3_move_window(MockI3 *mock, const gchar *name, const gchar *workspace);
+
+/* push a raw event, type without the event bit */
+void
+mock_i3_send_event(MockI3 *mock, guint32 type, const gchar *payload);
+
+/* close all client connections, like i3 exiting or restarting */
+void
+mock_i3_disconnect_clients(MockI3 *mock);
+
+gint
+mock_i3_message_type_from_string(const gchar *str);
+
+#endif /* !__MOCK_I3_H__ */
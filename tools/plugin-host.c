@@ -0,0 +1,236 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gmodule.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "plugin-host.h"
+#include "i3w-multi-monitor-utils.h"
+
+#define PLUGIN_NAME "i3-workspaces"
+
+typedef XfcePanelPlugin *(*ModuleConstructFunc) (const gchar *name, gint unique_id,
+        const gchar *display_name, const gchar *comment, gchar **arguments,
+        GdkScreen *screen);
+
+struct _PluginHost
+{
+    gchar *config_home;
+    GModule *module;
+    ModuleConstructFunc construct;
+    GList *windows;
+};
+
+static void
+remove_tree(const gchar *path);
+
+/**
+ * plugin_host_new:
+ * @err: the error object
+ *
+ * Create the host and its configuration directory.
+ *
+ * Returns: the host or NULL
+ */
+PluginHost *
+plugin_host_new(GError **err)
+{
+    gchar *config_home = g_dir_make_tmp("i3w-host-XXXXXX", err);
+    if (!config_home)
+        return NULL;
+
+    g_setenv("XDG_CONFIG_HOME", config_home, TRUE);
+
+    PluginHost *host = g_new0(PluginHost, 1);
+    host->config_home = config_home;
+
+    return host;
+}
+
+/**
+ * plugin_host_free:
+ * @host: the host
+ *
+ * Destroy the plugins and remove their configuration.
+ */
+void
+plugin_host_free(PluginHost *host)
+{
+    g_list_free_full(host->windows, (GDestroyNotify) gtk_widget_destroy);
+
+    if (host->module)
+        g_module_close(host->module);
+
+    remove_tree(host->config_home);
+    g_free(host->config_home);
+    g_free(host);
+}
+
+/**
+ * plugin_host_load:
+ * @host: the host
+ * @module_path: the plugin module, NULL for the one in the build tree
+ * @err: the error object
+ *
+ * Load the plugin module.
+ *
+ * Returns: TRUE if loaded
+ */
+gboolean
+plugin_host_load(PluginHost *host, const gchar *module_path, GError **err)
+{
+    if (host->module)
+        return TRUE;
+
+    host->module = g_module_open(module_path ? module_path : I3W_PLUGIN_PATH,
+            G_MODULE_BIND_LOCAL);
+    if (!host->module ||
+            !g_module_symbol(host->module, "xfce_panel_module_construct",
+                (gpointer *) &host->construct))
+    {
+        g_set_error(err, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Cannot load the plugin: %s", g_module_error());
+        if (host->module)
+            g_module_close(host->module);
+        host->module = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * plugin_host_add:
+ * @host: the host, with the module loaded
+ * @unique_id: the id of the plugin instance
+ * @rc: the contents of its rc file, or NULL
+ *
+ * Construct a plugin and show it in a window of its own.
+ *
+ * Returns: the plugin widget, owned by the host
+ */
+GtkWidget *
+plugin_host_add(PluginHost *host, gint unique_id, const gchar *rc)
+{
+    g_return_val_if_fail(host->construct != NULL, NULL);
+
+    if (rc)
+    {
+        gchar *rc_dir = g_build_filename(host->config_home, "xfce4", "panel", NULL);
+        gchar *rc_file = g_strdup_printf("%s/%s-%d.rc", rc_dir, PLUGIN_NAME, unique_id);
+        g_mkdir_with_parents(rc_dir, 0700);
+        g_file_set_contents(rc_file, rc, -1, NULL);
+        g_free(rc_file);
+        g_free(rc_dir);
+    }
+
+    GtkWidget *plugin = GTK_WIDGET(host->construct(PLUGIN_NAME, unique_id,
+                "i3 Workspaces", NULL, NULL, gdk_screen_get_default()));
+
+    GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_container_add(GTK_CONTAINER(window), plugin);
+    gtk_widget_show_all(window);
+    host->windows = g_list_prepend(host->windows, window);
+
+    return plugin;
+}
+
+/**
+ * plugin_host_remove:
+ * @host: the host
+ * @plugin: a plugin added to the host
+ *
+ * Destroy the plugin and its window, the plugin saves its state like when
+ * removed from a panel. The rc file is kept.
+ */
+void
+plugin_host_remove(PluginHost *host, GtkWidget *plugin)
+{
+    GtkWidget *window = gtk_widget_get_toplevel(plugin);
+    GList *item = g_list_find(host->windows, window);
+
+    g_return_if_fail(item != NULL);
+
+    host->windows = g_list_delete_link(host->windows, item);
+    gtk_widget_destroy(window);
+}
+
+/**
+ * plugin_host_find_button:
+ * @plugin: the plugin widget, or any widget in it
+ * @name: the workspace name as displayed
+ *
+ * Returns: the workspace button showing the workspace name, or NULL
+ */
+GtkWidget *
+plugin_host_find_button(GtkWidget *plugin, const gchar *name)
+{
+    if (GTK_IS_BUTTON(plugin) &&
+            g_strcmp0(g_object_get_data(G_OBJECT(plugin), "i3w-name"), name) == 0)
+        return plugin;
+
+    if (!GTK_IS_CONTAINER(plugin))
+        return NULL;
+
+    GList *children = gtk_container_get_children(GTK_CONTAINER(plugin));
+    GList *item;
+    GtkWidget *found = NULL;
+    for (item = children; item != NULL && found == NULL; item = item->next)
+        found = plugin_host_find_button(GTK_WIDGET(item->data), name);
+    g_list_free(children);
+
+    return found;
+}
+
+/**
+ * plugin_host_get_output_name:
+ *
+ * Returns: the name of the X output at the origin, where the plugin windows
+ * appear, or "screen"
+ */
+gchar *
+plugin_host_get_output_name(void)
+{
+    i3_workspaces_outputs_t outputs = get_outputs();
+    const char *output = get_monitor_name_at(outputs, 0, 0);
+    gchar *name = g_strdup(output ? output : "screen");
+    free_outputs(outputs);
+
+    return name;
+}
+
+static void
+remove_tree(const gchar *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    if (dir)
+    {
+        const gchar *name;
+        while ((name = g_dir_read_name(dir)) != NULL)
+        {
+            gchar *child = g_build_filename(path, name, NULL);
+            remove_tree(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+    }
+
+    g_remove(path);
+}
@@ -0,0 +1,55 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PLUGIN_HOST_H__
+#define __PLUGIN_HOST_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * Runs the built plugin module outside of a panel: the plugin is
+ * constructed through the module's xfce_panel_module_construct, like the
+ * panel does, and shown in a window of its own. The configuration lives in a
+ * temporary XDG_CONFIG_HOME, removed with the host.
+ */
+
+typedef struct _PluginHost PluginHost;
+
+/* call before gtk_init, which reads XDG_CONFIG_HOME */
+PluginHost *
+plugin_host_new(GError **err);
+
+void
+plugin_host_free(PluginHost *host);
+
+gboolean
+plugin_host_load(PluginHost *host, const gchar *module_path, GError **err);
+
+GtkWidget *
+plugin_host_add(PluginHost *host, gint unique_id, const gchar *rc);
+
+void
+plugin_host_remove(PluginHost *host, GtkWidget *plugin);
+
+GtkWidget *
+plugin_host_find_button(GtkWidget *plugin, const gchar *name);
+
+gchar *
+plugin_host_get_output_name(void);
+
+#endif /* !__PLUGIN_HOST_H__ */
@@ -0,0 +1,15 @@
+#!/bin/sh
+#
+# The short allocation soak run of "make check". It runs on its own Xvfb
+# server only, so no window is mapped on the display of the session; it is
+# skipped without xvfb-run. The long run is started by hand:
+#
+#   xvfb-run tools/i3w-soak
+#
+
+if ! command -v xvfb-run >/dev/null 2>&1; then
+	echo "xvfb-run not found, skipping the soak run"
+	exit 77
+fi
+
+exec xvfb-run -a ./i3w-soak --warmup=1000 --ops=10000